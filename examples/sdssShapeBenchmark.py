@@ -0,0 +1,108 @@
+#!/usr/bin/env python
+#
+# LSST Data Management System
+# Copyright 2008-2019 AURA/LSST.
+#
+# This product includes software developed by the
+# LSST Project (http://www.lsstcorp.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the LSST License Statement and
+# the GNU General Public License along with this program.  If not,
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+"""Compare the speed and results of the SdssShape moments kernels.
+
+For a range of object sizes, measure the adaptive moments of a noisy elliptical Gaussian with the scalar
+kernel (``SdssShapeControl.doVectorize = False``), the vectorized kernel (``doVectorize = True``), with
+and without compensated single-precision sums (``doCompensatedSums``), and the recurrence weight
+generator (``doWeightRecurrence = True``), and report the time per call and the largest relative
+difference between each result and the scalar one.
+"""
+import argparse
+import math
+import time
+
+import numpy as np
+
+import lsst.geom
+import lsst.afw.image as afwImage
+from lsst.meas.base import SdssShapeAlgorithm, SdssShapeControl
+
+
+def makeImage(sigma, noise=1.0, instFlux=1E5, seed=1):
+    """Make an image of an elliptical Gaussian with axis ratio 0.7, centred near the middle."""
+    half = int(math.ceil(6*sigma)) + 5
+    image = afwImage.MaskedImageF(lsst.geom.Extent2I(2*half + 1, 2*half + 1))
+    center = lsst.geom.Point2D(half + 0.3, half - 0.2)
+    y, x = np.mgrid[0:2*half + 1, 0:2*half + 1]
+    xx, yy, xy = sigma**2, (0.7*sigma)**2, 0.2*sigma**2
+    det = xx*yy - xy**2
+    dx, dy = x - center.getX(), y - center.getY()
+    expon = (yy*dx**2 - 2*xy*dx*dy + xx*dy**2)/det
+    rng = np.random.RandomState(seed)
+    array = instFlux/(2*math.pi*math.sqrt(det))*np.exp(-0.5*expon) + rng.normal(0.0, noise, x.shape)
+    image.getImage().getArray()[:, :] = array
+    image.getVariance().set(noise**2)
+    return image, center
+
+
+def timeMoments(image, center, ctrl, repeat):
+    """Return the result of computeAdaptiveMoments and the mean time per call in seconds."""
+    result = SdssShapeAlgorithm.computeAdaptiveMoments(image, center, ctrl=ctrl)
+    start = time.time()
+    for _ in range(repeat):
+        SdssShapeAlgorithm.computeAdaptiveMoments(image, center, ctrl=ctrl)
+    return result, (time.time() - start)/repeat
+
+
+def relativeDifference(a, b):
+    return abs(a - b)/max(abs(a), abs(b), 1E-300)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--sigma", type=float, nargs="+", default=[1.0, 2.0, 4.0, 8.0, 16.0, 32.0],
+                        help="Gaussian sigma(s) of the objects, in pixels")
+    parser.add_argument("--repeat", type=int, default=20, help="Number of timed calls per size")
+    args = parser.parse_args()
+
+    scalarCtrl = SdssShapeControl()
+    scalarCtrl.doVectorize = False
+    kernels = []
+    vectorCtrl = SdssShapeControl()
+    vectorCtrl.doVectorize = True
+    kernels.append(("vector", vectorCtrl))
+    compensatedCtrl = SdssShapeControl()
+    compensatedCtrl.doVectorize = True
+    compensatedCtrl.doCompensatedSums = True
+    kernels.append(("kahan", compensatedCtrl))
+    recurrenceCtrl = SdssShapeControl()
+    recurrenceCtrl.doWeightRecurrence = True
+    kernels.append(("recurrence", recurrenceCtrl))
+
+    print("%8s %-10s %12s %12s %8s %12s %12s" %
+          ("sigma", "kernel", "scalar [ms]", "time [ms]", "speedup", "max d(flux)", "max d(Ixx..)"))
+    for sigma in args.sigma:
+        image, center = makeImage(sigma)
+        scalar, scalarTime = timeMoments(image, center, scalarCtrl, args.repeat)
+        for name, ctrl in kernels:
+            result, resultTime = timeMoments(image, center, ctrl, args.repeat)
+            dFlux = relativeDifference(scalar.instFlux, result.instFlux)
+            dMoments = max(relativeDifference(scalar.xx, result.xx), relativeDifference(scalar.yy, result.yy),
+                           relativeDifference(scalar.xy, result.xy))
+            print("%8.1f %-10s %12.3f %12.3f %8.2f %12.2e %12.2e" %
+                  (sigma, name, 1E3*scalarTime, 1E3*resultTime, scalarTime/resultTime, dFlux, dMoments))
+
+
+if __name__ == "__main__":
+    main()
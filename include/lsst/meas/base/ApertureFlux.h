@@ -60,10 +60,111 @@ public:
     LSST_CONTROL_FIELD(
             shiftKernel, std::string,
             "Warping kernel used to shift Sinc photometry coefficients to different center positions");
+
+    LSST_CONTROL_FIELD(sincCacheTolerance, double,
+                       "Relative tolerance to which apertures are quantized when sharing sinc photometry "
+                       "coefficients between similar apertures in a least-recently-used cache; 0 to share "
+                       "them only between identical apertures, negative to never share them");
+
+    LSST_CONTROL_FIELD(sincCoeffsStore, std::string,
+                       "File of precomputed sinc photometry coefficients for the apertures (see "
+                       "SincCoeffsStore, and makeSincCoeffsStore.py to write one); empty to calculate them.  "
+                       "The store is shared by the process, so all the algorithms that set it must use the "
+                       "same file");
+
+    LSST_CONTROL_FIELD(sincFftwWisdom, std::string,
+                       "File of FFTW wisdom for the transforms that calculate sinc coefficients; if set, "
+                       "they are planned with FFTW_MEASURE and the wisdom saved there (suffixed by the "
+                       "precision) for later processes.  The planning is shared by the process, so all the "
+                       "algorithms that set it must use the same file");
 };
 
 struct ApertureFluxResult;
 
+/**
+ *  The sums along each row of the pixels (and variances) of an image, for measuring many apertures
+ *
+ *  Each row holds the sum of the pixels to the left of each column, so the sum over any span of a row is
+ *  the difference of two entries, and the naive instFlux within an aperture costs O(rows) rather than
+ *  O(area).  Building one takes a single pass over the image and a double for each pixel of each plane,
+ *  which pays off when many large apertures are measured on an image whose pixels don't change in
+ *  between; in particular, it must be rebuilt if sources are replaced with noise.
+ *
+ *  Sums of integer pixel values (up to 2^53) are exact, and so identical to those of computeNaiveFlux;
+ *  otherwise they agree to within the rounding of the sums.
+ */
+template <typename T>
+class PrefixSumImage {
+public:
+    /// Sum the rows of an image
+    explicit PrefixSumImage(afw::image::Image<T> const& image);
+
+    /// Sum the rows of the image and variance planes of a MaskedImage
+    explicit PrefixSumImage(afw::image::MaskedImage<T> const& image);
+
+    /// Return the bounding box of the summed image, in parent coordinates
+    geom::Box2I const& getBBox() const { return _bbox; }
+
+    /// Were the variances summed as well as the pixels?
+    bool hasVariance() const { return !_variance.empty(); }
+
+    /// Return the sum of the pixels in columns [beginX, endX) of row y, in parent coordinates
+    double sumImage(int y, int beginX, int endX) const { return _sum(_image, y, beginX, endX); }
+
+    /// Return the sum of the variances in columns [beginX, endX) of row y; requires hasVariance()
+    double sumVariance(int y, int beginX, int endX) const { return _sum(_variance, y, beginX, endX); }
+
+private:
+    double _sum(std::vector<double> const& sums, int y, int beginX, int endX) const {
+        std::size_t const row = static_cast<std::size_t>(y - _bbox.getMinY()) * (_bbox.getWidth() + 1);
+        return sums[row + (endX - _bbox.getMinX())] - sums[row + (beginX - _bbox.getMinX())];
+    }
+
+    geom::Box2I _bbox;
+    std::vector<double> _image;
+    std::vector<double> _variance;  // empty if only an Image was summed
+};
+
+/**
+ *  The sinc coefficients of several circular apertures, stacked to be applied to an image at once
+ *
+ *  The coefficient images of all the apertures share the bounding box of the largest, and are interleaved
+ *  so that the coefficients of every aperture at a pixel are adjacent (and zero for apertures that don't
+ *  cover it).  Measuring all the apertures is then a single pass over the pixels, multiplying each
+ *  by a vector of coefficients, rather than a pass over a cutout for each aperture.  A stack holds the
+ *  unshifted coefficients, so one serves every source measured with the same radii and control.
+ */
+template <typename T>
+class SincCoeffsStack {
+public:
+    /**
+     *  Stack the sinc coefficients of circular apertures
+     *
+     *  @param[in]   radii                 Radii of the apertures, in pixels, in any order.
+     *  @param[in]   ctrl                  Control object, which determines how coefficients are cached.
+     */
+    explicit SincCoeffsStack(std::vector<double> const& radii,
+                             ApertureFluxControl const& ctrl = ApertureFluxControl());
+
+    /// Return the radii of the apertures
+    std::vector<double> const& getRadii() const { return _radii; }
+
+    /// Return the bounding box of the stacked coefficients, relative to the center of the apertures
+    geom::Box2I const& getBBox() const { return _bbox; }
+
+    /// Return the bounding box of the coefficients of the i-th aperture
+    geom::Box2I const& getBBox(std::size_t i) const { return _bboxes[i]; }
+
+    /// Return the coefficients, ordered by row, then column, then aperture
+    T const* getCoeffs() const { return _coeffs.data(); }
+
+private:
+    std::vector<double> _radii;
+    std::vector<geom::Box2I> _bboxes;
+    geom::Box2I _bbox;
+    std::vector<T> _coeffs;
+};
+
 /**
  *  Base class for multiple-aperture photometry algorithms
  *
@@ -113,6 +214,34 @@ public:
                                   Control const& ctrl = Control());
     //@}
 
+    //@{
+    /**  Compute the instFluxes (and optionally, uncertainties) within concentric circular apertures
+     *   using Sinc photometry
+     *
+     *   The results are identical to those of computeSincFlux for each radius, but the pixels are read
+     *   in a single pass over the stacked coefficients of all the apertures, which are shifted to the
+     *   center on the fly.  Kernels other than Lanczos are applied to each aperture in turn.
+     *
+     *   @param[in]   image                 Image or MaskedImage to be measured.  If a MaskedImage is
+     *                                      provided, uncertainties will be returned as well as instFluxes.
+     *   @param[in]   center                Center of the apertures.
+     *   @param[in]   coeffs                Stacked coefficients of the apertures.
+     *   @param[in]   ctrl                  Control object; must match that used to stack the coefficients.
+     *
+     *   @returns one Result for each radius of the stack, in the same order.
+     */
+    template <typename T>
+    static std::vector<Result> computeSincFluxes(afw::image::Image<T> const& image,
+                                                 geom::Point2D const& center,
+                                                 SincCoeffsStack<T> const& coeffs,
+                                                 Control const& ctrl = Control());
+    template <typename T>
+    static std::vector<Result> computeSincFluxes(afw::image::MaskedImage<T> const& image,
+                                                 geom::Point2D const& center,
+                                                 SincCoeffsStack<T> const& coeffs,
+                                                 Control const& ctrl = Control());
+    //@}
+
     //@{
     /**  Compute the instFlux (and optionally, uncertanties) within an aperture using naive photometry
      *
@@ -133,6 +262,51 @@ public:
                                    Control const& ctrl = Control());
     //@}
 
+    //@{
+    /**  Compute the instFluxes (and optionally, uncertainties) within concentric circular apertures
+     *   using naive photometry
+     *
+     *   The results are those of computeNaiveFlux for each radius, but the pixels are read in a single
+     *   pass over the largest aperture that fits within the image, each being added to the sums of the
+     *   apertures it falls within.
+     *
+     *   @param[in]   image                 Image or MaskedImage to be measured.  If a MaskedImage is
+     *                                      provided, uncertainties will be returned as well as instFluxes.
+     *   @param[in]   center                Center of the apertures.
+     *   @param[in]   radii                 Radii of the apertures, in pixels, in any order.
+     *
+     *   @returns one Result for each radius, in the same order.
+     */
+    template <typename T>
+    static std::vector<Result> computeNaiveFluxes(afw::image::Image<T> const& image,
+                                                  geom::Point2D const& center,
+                                                  std::vector<double> const& radii);
+    template <typename T>
+    static std::vector<Result> computeNaiveFluxes(afw::image::MaskedImage<T> const& image,
+                                                  geom::Point2D const& center,
+                                                  std::vector<double> const& radii);
+    //@}
+
+    //@{
+    /**  Compute the instFlux (and, if variances were summed, uncertainty) within apertures using naive
+     *   photometry on the row sums of an image
+     *
+     *   The results are those of computeNaiveFlux and computeNaiveFluxes on the summed image, but each
+     *   aperture costs O(rows) rather than O(area).
+     *
+     *   @param[in]   sums                  Row sums of the image to be measured.
+     *   @param[in]   ellipse               Ellipse that defines the outer boundary of the aperture.
+     *   @param[in]   center                Center of the circular apertures.
+     *   @param[in]   radii                 Radii of the circular apertures, in pixels.
+     */
+    template <typename T>
+    static Result computeNaiveFlux(PrefixSumImage<T> const& sums, afw::geom::ellipses::Ellipse const& ellipse,
+                                   Control const& ctrl = Control());
+    template <typename T>
+    static std::vector<Result> computeNaiveFluxes(PrefixSumImage<T> const& sums, geom::Point2D const& center,
+                                                  std::vector<double> const& radii);
+    //@}
+
     //@{
     /**  Compute the instFlux (and optionally, uncertanties) within an aperture using the algorithm
      *   determined by its size and the maxSincRadius control parameter.
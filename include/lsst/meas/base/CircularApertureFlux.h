@@ -51,6 +51,10 @@ public:
      *  @param[in]     exposure    Image to be measured.
      */
     virtual void measure(afw::table::SourceRecord& record, afw::image::Exposure<float> const& exposure) const;
+
+private:
+    std::vector<std::size_t> _sincIndices;                       // indices of the radii measured with sinc
+    std::shared_ptr<SincCoeffsStack<float> const> _sincCoeffs;  // coefficients of those radii
 };
 
 }  // namespace base
@@ -30,6 +30,7 @@
 #include "lsst/meas/base/FluxUtilities.h"
 #include "lsst/meas/base/FlagHandler.h"
 #include "lsst/meas/base/InputUtilities.h"
+#include "lsst/meas/base/PsfCache.h"
 #include "lsst/meas/base/Transform.h"
 
 namespace lsst {
@@ -85,6 +86,7 @@ private:
     FlagHandler _flagHandler;
     SafeCentroidExtractor _centroidExtractor;
     afw::math::StatisticsControl _stats;
+    mutable std::shared_ptr<PsfCache> _psfCache;  // for the exposure most recently measured
 };
 
 class LocalBackgroundTransform : public FluxTransform {
@@ -31,6 +31,7 @@
 #include "lsst/meas/base/CentroidUtilities.h"
 #include "lsst/meas/base/FlagHandler.h"
 #include "lsst/meas/base/InputUtilities.h"
+#include "lsst/meas/base/PsfCache.h"
 #include "lsst/meas/base/Transform.h"
 
 namespace lsst {
@@ -60,8 +61,16 @@ class PeakLikelihoodFluxControl {
 public:
     LSST_CONTROL_FIELD(warpingKernelName, std::string,
                        "Name of warping kernel (e.g. \"lanczos4\") used to compute the peak");
+    LSST_CONTROL_FIELD(psfCacheSpacing, int,
+                       "Spacing in pixels of the grid on which the PSF model is evaluated and cached; 0 to "
+                       "evaluate it at each source");
+    LSST_CONTROL_FIELD(psfCacheTolerance, double,
+                       "Largest variation of the PSF model moments across a grid cell, relative to their "
+                       "trace, and of any pixel of its kernel images, relative to their peak, for which the "
+                       "cached PSF model is used rather than evaluating it at the source");
 
-    PeakLikelihoodFluxControl() : warpingKernelName("lanczos4") {}
+    PeakLikelihoodFluxControl()
+            : warpingKernelName("lanczos4"), psfCacheSpacing(0), psfCacheTolerance(1E-3) {}
 };
 
 /**
@@ -90,6 +99,7 @@ private:
     FluxResultKey _instFluxResultKey;
     FlagHandler _flagHandler;
     SafeCentroidExtractor _centroidExtractor;
+    mutable std::shared_ptr<PsfCache> _psfCache;  // for the exposure most recently measured
 };
 
 class PeakLikelihoodFluxTransform : public FluxTransform {
@@ -0,0 +1,187 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2019 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#ifndef LSST_MEAS_BASE_PsfCache_h_INCLUDED
+#define LSST_MEAS_BASE_PsfCache_h_INCLUDED
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "lsst/geom/Box.h"
+#include "lsst/geom/Point.h"
+#include "lsst/afw/detection/Psf.h"
+#include "lsst/afw/geom/ellipses/Quadrupole.h"
+#include "lsst/afw/math/Kernel.h"
+
+namespace lsst {
+namespace meas {
+namespace base {
+
+/**
+ *  A cache of a PSF model over an image, shared by the algorithms measuring that image
+ *
+ *  Evaluating a spatially varying PSF model (its moments, kernel image or local kernel) can cost as much
+ *  as measuring a source.  A PsfCache evaluates the model on a grid covering the image (lazily, on first
+ *  use of each grid cell).  Moments are interpolated bilinearly to the position of each source; kernel
+ *  images and local kernels are taken from the nearest grid node.  Where the moments at the corners of a
+ *  cell differ by more than a given tolerance (or, for kernel images and local kernels, the kernel images
+ *  at the corners differ by more than the tolerance in any pixel), or the position is off the image, the
+ *  model is evaluated exactly.  The differences between the corners bound the error of a lookup only
+ *  where the model varies monotonically across the cell; otherwise the results are an approximation,
+ *  whose accuracy is set by the grid spacing.
+ *
+ *  Algorithms should obtain the cache for an exposure with PsfCache::get, so that all algorithms
+ *  measuring the same exposure share it; it is released when the last of them lets go of it.
+ */
+class PsfCache {
+public:
+    typedef afw::geom::ellipses::Quadrupole Shape;
+    typedef afw::detection::Psf::Image Image;
+
+    /// Counts of the lookups made of a cache
+    struct Statistics {
+        Statistics() : hits(0), fallbacks(0), evaluations(0) {}
+
+        std::size_t hits;         ///< lookups answered from the grid
+        std::size_t fallbacks;    ///< lookups for which the PSF model was evaluated at the position
+        std::size_t evaluations;  ///< evaluations of the PSF model at grid nodes
+    };
+
+    /**
+     *  Return the cache for a PSF model on an image, creating it if no other algorithm holds one.
+     *
+     *  @param[in] psf   PSF model; may not be null.
+     *  @param[in] bbox  Bounding box (PARENT coordinates) of the image the PSF model describes.
+     */
+    static std::shared_ptr<PsfCache> get(std::shared_ptr<afw::detection::Psf const> const& psf,
+                                         geom::Box2I const& bbox);
+
+    /// Construct a new, unshared, cache.  @copydetails PsfCache::get
+    PsfCache(std::shared_ptr<afw::detection::Psf const> const& psf, geom::Box2I const& bbox);
+
+    PsfCache(PsfCache const&) = delete;
+    PsfCache& operator=(PsfCache const&) = delete;
+
+    /**
+     *  Return the moments of the PSF model at a position.
+     *
+     *  @param[in] position     Position (PARENT coordinates) at which to evaluate the PSF model.
+     *  @param[in] gridSpacing  Maximum spacing of the interpolation grid, in pixels; if <= 0 the moments
+     *                          are computed exactly (and not cached).
+     *  @param[in] tolerance    Maximum difference between the moments at the corners of a grid cell,
+     *                          relative to their mean trace, for which interpolation is used; otherwise
+     *                          the moments are computed exactly.
+     *
+     *  Exceptions thrown by Psf::computeShape propagate only when the moments are computed exactly; a
+     *  grid point at which the PSF model cannot be evaluated makes its cells fall back to exact moments.
+     */
+    Shape computeShape(geom::Point2D const& position, int gridSpacing, double tolerance) const;
+
+    /// Return the moments of the PSF model at its average position; the result is cached.
+    Shape computeShape() const;
+
+    /**
+     *  Return the image of the PSF model at a position, centered on the position as Psf::computeImage.
+     *
+     *  The kernel image at the nearest grid node is recentered with Psf::recenterKernelImage, as
+     *  Psf::computeImage does for image-based models.  The arguments and fallbacks are as for
+     *  computeShape, but the kernel images at the corners of the grid cell must also differ by no more
+     *  than `tolerance` times their largest pixel in every pixel (and have the same dimensions); the
+     *  result is a new image the caller may modify.
+     */
+    std::shared_ptr<Image> computeImage(geom::Point2D const& position, int gridSpacing,
+                                        double tolerance) const;
+
+    /**
+     *  Return the kernel image of the PSF model at a position (centered on the origin).
+     *
+     *  The arguments and fallbacks are as for computeImage; the result is shared, and must not be modified.
+     */
+    std::shared_ptr<Image const> computeKernelImage(geom::Point2D const& position, int gridSpacing,
+                                                    double tolerance) const;
+
+    /**
+     *  Return the kernel of the PSF model at a position.
+     *
+     *  The arguments and fallbacks are as for computeImage.
+     */
+    std::shared_ptr<afw::math::Kernel const> getLocalKernel(geom::Point2D const& position, int gridSpacing,
+                                                           double tolerance) const;
+
+    /// Return the counts of lookups made since the cache was created
+    Statistics getStatistics() const;
+
+    /// Return the PSF model
+    std::shared_ptr<afw::detection::Psf const> getPsf() const { return _psf; }
+
+    /// Return the bounding box of the image
+    geom::Box2I getBBox() const { return _bbox; }
+
+private:
+    struct Node {
+        Node() : computed(false), valid(false) {}
+
+        bool computed;  // has the PSF been evaluated here?
+        bool valid;     // could the PSF be evaluated here?
+        Shape shape;
+        geom::Point2D position;
+        std::shared_ptr<Image const> kernelImage;          // null until first requested
+        std::shared_ptr<afw::math::Kernel const> kernel;  // null until first requested
+    };
+
+    struct Grid {
+        int nx, ny;                        // number of nodes in x and y
+        double dx, dy;                     // node spacing
+        std::vector<Node> nodes;           // row-major
+        std::vector<double> imageSpreads;  // of each cell (row-major); negative until computed
+    };
+
+    Grid& _getGrid(int gridSpacing) const;
+    Node& _getNode(Grid& grid, int ix, int iy) const;
+    std::shared_ptr<Image const> _getKernelImage(Node& node) const;
+
+    // Return the largest difference between the kernel images at the corners of a cell, relative to
+    // their largest pixel; infinite if they can't be evaluated or differ in dimensions.  Requires _mutex.
+    double _getImageSpread(Grid& grid, int ix, int iy, Node* const corners[4]) const;
+
+    // Return the grid node nearest a position and interpolate the moments there, or return null if the
+    // PSF model must be evaluated at the position instead; with checkImages, the kernel images at the
+    // corners must also agree.  Counts the lookup.  Requires _mutex.
+    Node* _lookup(geom::Point2D const& position, int gridSpacing, double tolerance, bool checkImages,
+                  Shape* shape) const;
+
+    std::shared_ptr<afw::detection::Psf const> _psf;
+    geom::Box2I _bbox;
+    mutable std::mutex _mutex;                     // guards everything below, and calls to _psf
+    mutable std::map<int, Grid> _grids;            // keyed by requested gridSpacing
+    mutable std::unique_ptr<Shape> _averageShape;  // null until computed
+    mutable Statistics _statistics;
+};
+
+}  // namespace base
+}  // namespace meas
+}  // namespace lsst
+
+#endif  // !LSST_MEAS_BASE_PsfCache_h_INCLUDED
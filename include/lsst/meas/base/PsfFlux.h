@@ -24,11 +24,17 @@
 #ifndef LSST_MEAS_BASE_PsfFlux_h_INCLUDED
 #define LSST_MEAS_BASE_PsfFlux_h_INCLUDED
 
+#include <bitset>
+#include <limits>
+#include <vector>
+
 #include "lsst/pex/config.h"
+#include "lsst/afw/math/Kernel.h"
 #include "lsst/meas/base/Algorithm.h"
 #include "lsst/meas/base/FluxUtilities.h"
 #include "lsst/meas/base/FlagHandler.h"
 #include "lsst/meas/base/InputUtilities.h"
+#include "lsst/meas/base/PsfCache.h"
 #include "lsst/meas/base/Transform.h"
 
 namespace lsst {
@@ -49,15 +55,27 @@ class PsfFluxControl {
 public:
     LSST_CONTROL_FIELD(badMaskPlanes, std::vector<std::string>,
                        "Mask planes that indicate pixels that should be excluded from the fit");
+    LSST_CONTROL_FIELD(psfCacheSpacing, int,
+                       "Spacing in pixels of the grid on which the PSF model is evaluated and cached; 0 to "
+                       "evaluate it at each source");
+    LSST_CONTROL_FIELD(psfCacheTolerance, double,
+                       "Largest variation of the PSF model moments across a grid cell, relative to their "
+                       "trace, and of any pixel of its kernel images, relative to their peak, for which the "
+                       "cached PSF model is used rather than evaluating it at the source");
+    LSST_CONTROL_FIELD(doMeasureN, bool,
+                       "Whether to also fit the PSF models of all the sources of a blend family "
+                       "simultaneously (measureN), overriding their single-object measurements");
 
     /**
      *  @brief Default constructor
      *
      *  All control classes should define a default constructor that sets all fields to their default values.
      */
-    PsfFluxControl() {}
+    PsfFluxControl() : psfCacheSpacing(0), psfCacheTolerance(1E-3), doMeasureN(false) {}
 };
 
+struct PsfFluxResult;
+
 /**
  *  @brief A measurement algorithm that estimates instFlux using a linear least-squares fit with the Psf model
  *
@@ -73,17 +91,67 @@ public:
     static FlagDefinition const FAILURE;
     static FlagDefinition const NO_GOOD_PIXELS;
     static FlagDefinition const EDGE;
+    static unsigned int const N_FLAGS = 3;
 
     /// A typedef to the Control object for this algorithm, defined above.
     /// The control object contains the configuration parameters for this algorithm.
     typedef PsfFluxControl Control;
 
+    /// Result object returned by computeFluxes
+    typedef PsfFluxResult Result;
+
+    /**
+     *  Fit the PSF model at many fixed positions, as in forced photometry.
+     *
+     *  The fit at each position is the one measure() makes with a KernelPsf holding the kernel, but no
+     *  Psf image is rendered: the normalized kernel image is shifted to the position on the fly, with the
+     *  Lanczos kernel Psf::computeImage uses.  If the kernel is a LinearCombinationKernel its basis images
+     *  are computed once, and combined with the spatial coefficients at each position.  Positions are fit
+     *  in the order of the tiles of the image they fall in, for locality.
+     *
+     *  @param[in] image      Image to fit.
+     *  @param[in] kernel     Kernel of the PSF model.
+     *  @param[in] positions  Positions (PARENT coordinates) at which to fit the model.
+     *  @param[in] ctrl       Control object; only badMaskPlanes is used.
+     *
+     *  @return the result at each position, in the order of the positions
+     */
+    static std::vector<Result> computeFluxes(afw::image::MaskedImage<float> const& image,
+                                             afw::math::Kernel const& kernel,
+                                             std::vector<geom::Point2D> const& positions,
+                                             Control const& ctrl = Control());
+
     PsfFluxAlgorithm(Control const& ctrl, std::string const& name, afw::table::Schema& schema,
                      std::string const& logName = "");
 
     virtual void measure(afw::table::SourceRecord& measRecord,
                          afw::image::Exposure<float> const& exposure) const;
 
+    /**
+     *  Measure each source of a catalog as measure does.
+     *
+     *  The sources are grouped by the dimensions of their fit regions, and the pixels of up to eight
+     *  sources of a group are laid out side by side, pixel by pixel, so that the sums of the fits are
+     *  accumulated a source per vector lane.  Each lane sums its pixels in the same order as measure, so
+     *  the results are identical (unless the compiler fuses multiply-adds into FMA instructions
+     *  differently in the two loops, which changes them by rounding).  Errors are handled per source, as
+     *  the measurement framework handles those of measure.
+     */
+    void measureBatch(afw::table::SourceCatalog const& measCat,
+                      afw::image::Exposure<float> const& exposure) const;
+
+    /**
+     *  Fit the PSF models of a family of sources simultaneously.
+     *
+     *  The normal equations couple only the sources whose PSF model images overlap; each source's flux
+     *  error is the square root of the diagonal of the covariance of the fit, computed (like the
+     *  single-object fit) without per-pixel weights.  A source whose centroid or PSF model can't be
+     *  used or whose model has no good pixels is failed, and left out of the fit of the others; a
+     *  FatalAlgorithmError is propagated.  A family of one is left with its single-object measurement.
+     */
+    virtual void measureN(afw::table::SourceCatalog const& measCat,
+                          afw::image::Exposure<float> const& exposure) const;
+
     virtual void fail(afw::table::SourceRecord& measRecord, MeasurementError* error = nullptr) const;
 
 private:
@@ -92,6 +160,30 @@ private:
     afw::table::Key<float> _areaKey;
     FlagHandler _flagHandler;
     SafeCentroidExtractor _centroidExtractor;
+    mutable std::shared_ptr<PsfCache> _psfCache;  // for the exposure most recently measured
+};
+
+/**
+ *  A Result struct for fitting the PSF model at one of many positions.
+ *
+ *  This extends FluxResult with the effective area of the model and the flags of PsfFluxAlgorithm.
+ */
+struct PsfFluxResult : public FluxResult {
+    PsfFluxResult() : area(std::numeric_limits<float>::quiet_NaN()) {}
+
+    float area;  ///< effective area of the PSF model, sum(model)/sum(model^2)
+
+    /// Return the flag value associated with the given bit
+    bool getFlag(unsigned int index) const { return _flags[index]; }
+
+    /// Set the flag value associated with the given bit
+    void setFlag(unsigned int index, bool value = true) { _flags[index] = value; }
+
+    /// Clear (i.e. set to false) the flag associated with the given bit
+    void unsetFlag(unsigned int index) { _flags[index] = false; }
+
+private:
+    std::bitset<PsfFluxAlgorithm::N_FLAGS> _flags;
 };
 
 class PsfFluxTransform : public FluxTransform {
@@ -24,6 +24,9 @@
 #ifndef LSST_MEAS_BASE_ScaledApertureFlux_h_INCLUDED
 #define LSST_MEAS_BASE_ScaledApertureFlux_h_INCLUDED
 
+#include <array>
+
+#include "lsst/daf/base/PropertySet.h"
 #include "lsst/afw/table.h"
 #include "lsst/afw/image/Exposure.h"
 #include "lsst/meas/base/Algorithm.h"
@@ -31,6 +34,7 @@
 #include "lsst/meas/base/FluxUtilities.h"
 #include "lsst/meas/base/FlagHandler.h"
 #include "lsst/meas/base/InputUtilities.h"
+#include "lsst/meas/base/PsfCache.h"
 #include "lsst/pex/config.h"
 
 namespace lsst {
@@ -43,13 +47,28 @@ public:
             shiftKernel, std::string,
             "Warping kernel used to shift Sinc photometry coefficients to different center positions");
     LSST_CONTROL_FIELD(scale, double, "Scaling factor of PSF FWHM for aperture radius.");
+    LSST_CONTROL_FIELD(psfCacheSpacing, int,
+                       "Spacing in pixels of the grid on which the PSF model moments are computed and "
+                       "interpolated; 0 to compute them at each source");
+    LSST_CONTROL_FIELD(psfCacheTolerance, double,
+                       "Largest variation of the PSF model moments across a grid cell, relative to their "
+                       "trace, for which they're interpolated rather than computed at the source");
+    LSST_CONTROL_FIELD(sincCacheTolerance, double,
+                       "Relative tolerance to which apertures are quantized when sharing sinc photometry "
+                       "coefficients between similar apertures in a least-recently-used cache; 0 to share "
+                       "them only between identical apertures, negative to never share them");
 
     // The default scaling factor is chosen such that scaled aperture
     // magnitudes are expected to be equal to Kron magnitudes, based on
     // measurements performed by Stephen Gwyn on WIRCam. See:
     // http://www.cadc-ccda.hia-iha.nrc-cnrc.gc.ca/en/wirwolf/docs/proc.html#photcal
     // http://www.cfht.hawaii.edu/fr/news/UM2013/presentations/Session10-SGwyn.pdf
-    ScaledApertureFluxControl() : shiftKernel("lanczos5"), scale(3.14) {}
+    ScaledApertureFluxControl()
+            : shiftKernel("lanczos5"),
+              scale(3.14),
+              psfCacheSpacing(0),
+              psfCacheTolerance(1E-3),
+              sincCacheTolerance(1E-4) {}
 };
 
 /**
@@ -66,6 +85,18 @@ public:
 
     ScaledApertureFluxAlgorithm(Control const& control, std::string const& name, afw::table::Schema& schema);
 
+    /**
+     *  Construct an algorithm that reports the use of the sinc coefficient cache in metadata.
+     *
+     *  The metadata keys {name}_sincCacheHits, {name}_sincCacheMisses and {name}_sincCacheEvictions
+     *  (see SincCoeffs::LruStatistics; these count the lookups of all algorithms in the process), and
+     *  {name}_psfCacheHits, {name}_psfCacheFallbacks and {name}_psfCacheEvaluations (see
+     *  PsfCache::Statistics, for the exposure being measured) are updated after every measurement, when
+     *  they have changed; the metadata must therefore outlive the algorithm.
+     */
+    ScaledApertureFluxAlgorithm(Control const& control, std::string const& name, afw::table::Schema& schema,
+                                daf::base::PropertySet& metadata);
+
     /**
      *  Measure the scaled aperture instFlux on the given image.
      *
@@ -84,6 +115,11 @@ private:
     FluxResultKey _instFluxResultKey;
     FlagHandler _flagHandler;
     SafeCentroidExtractor _centroidExtractor;
+    std::string _name;
+    daf::base::PropertySet* _metadata;            // not owned; null if constructed without metadata
+    std::array<std::string, 6> _metadataKeys;     // the names of the cache statistics in _metadata
+    mutable std::array<long, 6> _reported;        // the statistics last set in _metadata
+    mutable std::shared_ptr<PsfCache> _psfCache;  // for the exposure most recently measured
 };
 
 class ScaledApertureFluxTransform : public FluxTransform {
@@ -36,6 +36,7 @@
 #include "lsst/meas/base/CentroidUtilities.h"
 #include "lsst/meas/base/FlagHandler.h"
 #include "lsst/meas/base/InputUtilities.h"
+#include "lsst/meas/base/PsfCache.h"
 
 namespace lsst {
 namespace meas {
@@ -53,6 +54,13 @@ public:
     LSST_CONTROL_FIELD(doFootprintCheck, bool, "Do check that the centroid is contained in footprint.");
     LSST_CONTROL_FIELD(maxDistToPeak, double,
                        "If set > 0, Centroid Check also checks distance from footprint peak.");
+    LSST_CONTROL_FIELD(psfCacheSpacing, int,
+                       "Spacing in pixels of the grid on which the PSF model is evaluated and cached; 0 to "
+                       "evaluate it at each source");
+    LSST_CONTROL_FIELD(psfCacheTolerance, double,
+                       "Largest variation of the PSF model moments across a grid cell, relative to their "
+                       "trace, and of any pixel of its kernel images, relative to their peak, for which the "
+                       "cached PSF model is used rather than evaluating it at the source");
     /**
      *  @brief Default constructor
      *
@@ -60,7 +68,13 @@ public:
      */
 
     SdssCentroidControl()
-            : binmax(16), peakMin(-1.0), wfac(1.5), doFootprintCheck(true), maxDistToPeak(-1.0) {}
+            : binmax(16),
+              peakMin(-1.0),
+              wfac(1.5),
+              doFootprintCheck(true),
+              maxDistToPeak(-1.0),
+              psfCacheSpacing(0),
+              psfCacheTolerance(1E-3) {}
 };
 
 /**
@@ -93,6 +107,7 @@ private:
     FlagHandler _flagHandler;
     SafeCentroidExtractor _centroidExtractor;
     CentroidChecker _centroidChecker;
+    mutable std::shared_ptr<PsfCache> _psfCache;  // for the exposure most recently measured
 };
 
 class SdssCentroidTransform : public CentroidTransform {
@@ -25,24 +25,30 @@
 #define LSST_MEAS_BASE_SdssShape_h_INCLUDED
 
 #include <bitset>
+#include <vector>
 
+#include "ndarray.h"
 #include "lsst/pex/config.h"
+#include "lsst/daf/base/PropertySet.h"
 #include "lsst/afw/geom/SkyWcs.h"
 #include "lsst/afw/image/PhotoCalib.h"
 #include "lsst/afw/image/Exposure.h"
 #include "lsst/afw/geom/ellipses/Quadrupole.h"
 #include "lsst/afw/table/aggregates.h"
+#include "lsst/afw/table/misc.h"
 #include "lsst/meas/base/FluxUtilities.h"
 #include "lsst/meas/base/CentroidUtilities.h"
 #include "lsst/meas/base/ShapeUtilities.h"
 #include "lsst/meas/base/InputUtilities.h"
 #include "lsst/meas/base/Algorithm.h"
+#include "lsst/meas/base/PsfCache.h"
 
 namespace lsst {
 namespace meas {
 namespace base {
 
 class SdssShapeResult;
+class SdssShapeBatchResult;
 
 /**
  *  @brief A C++ control class to handle SdssShapeAlgorithm's configuration
@@ -57,10 +63,59 @@ public:
     LSST_CONTROL_FIELD(tol1, float, "Convergence tolerance for e1,e2");
     LSST_CONTROL_FIELD(tol2, float, "Convergence tolerance for FWHM");
     LSST_CONTROL_FIELD(doMeasurePsf, bool, "Whether to also compute the shape of the PSF model");
+    LSST_CONTROL_FIELD(doVectorize, bool,
+                       "Use the SIMD moments kernel best suited to this CPU when not interpolating "
+                       "within pixels, rather than the original scalar loop (results agree to ~1e-6); "
+                       "GaussianFlux uses the default");
+    LSST_CONTROL_FIELD(doWeightRecurrence, bool,
+                       "Generate the Gaussian weights along each row by recurrence (one exp per 16 pixels) "
+                       "rather than with an exp per pixel, when not interpolating within pixels; "
+                       "overrides doVectorize");
+    LSST_CONTROL_FIELD(doCompensatedSums, bool,
+                       "With doVectorize, accumulate each row of pixels in single precision with Kahan "
+                       "compensation rather than in double precision (faster; results agree to ~1e-7)");
+    LSST_CONTROL_FIELD(initialGuess, std::string,
+                       "Starting point for the adaptive weight function: 'default' (a circular Gaussian "
+                       "with sigma^2 = 1.5 pixels^2), 'psf' (the moments of the PSF model at the source), "
+                       "or 'shape' (the shape slot of the reference record in forced mode, or of the "
+                       "record being measured otherwise, which must not be this algorithm's own shape: "
+                       "that is an error).  Falls back to 'default' if the requested shape is unavailable "
+                       "or invalid");
+    LSST_CONTROL_FIELD(doCompareColdStart, bool,
+                       "When starting from the PSF or a shape, also run from the default starting point "
+                       "to record the number of iterations saved in the task metadata (slow; for tuning)");
+    LSST_CONTROL_FIELD(doAccelerate, bool,
+                       "Extrapolate the weight function moments with Aitken's delta-squared method every "
+                       "three iterations, to speed up slowly-converging (e.g. non-Gaussian) sources");
+    LSST_CONTROL_FIELD(psfCacheSpacing, int,
+                       "Spacing in pixels of the grid on which the PSF model moments (for doMeasurePsf and "
+                       "initialGuess='psf') are computed and interpolated; 0 to compute them at each source");
+    LSST_CONTROL_FIELD(psfCacheTolerance, double,
+                       "Largest variation of the PSF model moments across a grid cell, relative to their "
+                       "trace, for which they're interpolated rather than computed at the source");
+    LSST_CONTROL_FIELD(pyramidMinSigma, double,
+                       "Sigma (pixels) of the weight function above which the iteration is first run to "
+                       "convergence on the object binned by 8, 4 and 2 (coarse to fine, as far as the "
+                       "binned sigma is >= 4 pixels), and only the final iterations at full resolution; "
+                       "0 to disable");
 
     /// @copydoc SdssShapeControl::SdssShapeControl
     SdssShapeControl()
-            : background(0.0), maxIter(100), maxShift(), tol1(1E-5), tol2(1E-4), doMeasurePsf(true) {}
+            : background(0.0),
+              maxIter(100),
+              maxShift(),
+              tol1(1E-5),
+              tol2(1E-4),
+              doMeasurePsf(true),
+              doVectorize(false),
+              doWeightRecurrence(false),
+              doCompensatedSums(false),
+              initialGuess("default"),
+              doCompareColdStart(false),
+              doAccelerate(false),
+              psfCacheSpacing(0),
+              psfCacheTolerance(1E-3),
+              pyramidMinSigma(0.0) {}
 };
 
 /**
@@ -133,6 +188,8 @@ private:
     afw::table::Key<ErrElement> _instFlux_xx_Cov;
     afw::table::Key<ErrElement> _instFlux_yy_Cov;
     afw::table::Key<ErrElement> _instFlux_xy_Cov;
+    afw::table::Key<int> _nIter;     // invalid if the schema predates it
+    afw::table::Key<int> _bboxArea;  // invalid if the schema predates it
     FlagHandler _flagHandler;
 };
 
@@ -170,6 +227,19 @@ public:
 
     SdssShapeAlgorithm(Control const& ctrl, std::string const& name, afw::table::Schema& schema);
 
+    /**
+     *  Construct an algorithm that reports iteration statistics in metadata.
+     *
+     *  The metadata keys {name}_nIter (total number of iterations), {name}_nIterHist (number of
+     *  sources by iteration count), {name}_bboxAreaHist (number of sources by floor(log2) of the area
+     *  of the final bounding box), {name}_nWarmStart (number of sources started from the PSF or a
+     *  shape, see SdssShapeControl::initialGuess) and, if SdssShapeControl::doCompareColdStart,
+     *  {name}_nIterSaved (iterations saved by those warm starts) are updated after every measurement;
+     *  the metadata must therefore outlive the algorithm.
+     */
+    SdssShapeAlgorithm(Control const& ctrl, std::string const& name, afw::table::Schema& schema,
+                       daf::base::PropertySet& metadata);
+
     /**
      *  Compute the adaptive Gaussian-weighted moments of an image.
      *
@@ -184,6 +254,44 @@ public:
     static Result computeAdaptiveMoments(ImageT const& image, geom::Point2D const& position,
                                          bool negative = false, Control const& ctrl = Control());
 
+    /**
+     *  Compute the adaptive Gaussian-weighted moments of an image, starting from a given shape.
+     *
+     *  This is the same as the other overload, except that the iteration starts with a weight function
+     *  with the moments of initialShape (e.g. the moments of the PSF model, for point sources); if
+     *  initialShape is not positive definite the usual starting point is used.  ctrl.initialGuess
+     *  is ignored.
+     */
+    template <typename ImageT>
+    static Result computeAdaptiveMoments(ImageT const& image, geom::Point2D const& position,
+                                         afw::geom::ellipses::Quadrupole const& initialShape,
+                                         bool negative = false, Control const& ctrl = Control());
+
+    /**
+     *  Compute the adaptive Gaussian-weighted moments of many objects in the same image.
+     *
+     *  This is equivalent to calling computeAdaptiveMoments for each position, but the objects are
+     *  distributed over a pool of threads and the results are returned as a struct of arrays.  If
+     *  ctrl.pyramidMinSigma is set, the binned images used for large objects are made once, for the
+     *  whole image, and shared by all objects.
+     *
+     *  @param[in] image      An Image or MaskedImage instance with int, float, or double pixels.
+     *  @param[in] positions  Center positions of the objects to be measured, in the image's PARENT
+     *                        coordinates.
+     *  @param[in] negative   Boolean, specify if the sources are in negative instFlux space
+     *  @param[in] ctrl       Control object specifying the details of how the objects are to be measured.
+     *  @param[in] nThreads   Number of threads to use; 0 to use one per hardware thread.
+     *
+     *  A pex::exceptions::Exception thrown while measuring an object sets that object's FAILURE flag;
+     *  any other exception is rethrown once all threads have finished.
+     */
+    template <typename ImageT>
+    static SdssShapeBatchResult computeAdaptiveMomentsBatch(ImageT const& image,
+                                                            std::vector<geom::Point2D> const& positions,
+                                                            bool negative = false,
+                                                            Control const& ctrl = Control(),
+                                                            int nThreads = 1);
+
     /**
      *  Compute the instFlux within a fixed Gaussian aperture.
      *
@@ -192,21 +300,59 @@ public:
      *                       fit will be a subset of this image determined automatically).
      *  @param[in] shape     Ellipse object specifying the 1-sigma contour of the Gaussian.
      *  @param[in] position  Center position of the object to be measured, in the image's PARENT coordinates.
+     *  @param[in] ctrl      Control object selecting the kernel used to compute the moments (only
+     *                       doVectorize, doWeightRecurrence and doCompensatedSums are used).
+     */
+    template <typename ImageT>
+    static FluxResult computeFixedMomentsFlux(ImageT const& image,
+                                              afw::geom::ellipses::Quadrupole const& shape,
+                                              geom::Point2D const& position, Control const& ctrl = Control());
+
+    /**
+     *  Compute the instFlux within a fixed Gaussian aperture, reusing the weighted sums of an adaptive
+     *  moments measurement of the same source if possible.
+     *
+     *  If the last source measured by an SdssShapeAlgorithm plugin on this thread was the record with
+     *  the given ID, in the same Image object (the image plane of a MaskedImage; plain Images are never
+     *  matched), and its final iteration used exactly the pixels, center, weights and kernel this would
+     *  use (as it does when the shape is the one it measured), its sums are used and no pixels are
+     *  visited; otherwise this is equivalent to the overload without an ID.  The sums are used at most
+     *  once: any call with an ID forgets them.  The pixels must not have been modified in place between
+     *  the shape measurement and this call, as they aren't while one record is measured by a task.
+     *
+     *  @param[in] id  ID of the record being measured.
      */
     template <typename ImageT>
     static FluxResult computeFixedMomentsFlux(ImageT const& image,
                                               afw::geom::ellipses::Quadrupole const& shape,
-                                              geom::Point2D const& position);
+                                              geom::Point2D const& position, afw::table::RecordId id,
+                                              Control const& ctrl = Control());
 
     virtual void measure(afw::table::SourceRecord& measRecord,
                          afw::image::Exposure<float> const& exposure) const;
 
+    virtual void measureForced(afw::table::SourceRecord& measRecord,
+                               afw::image::Exposure<float> const& exposure,
+                               afw::table::SourceRecord const& refRecord,
+                               afw::geom::SkyWcs const& refWcs) const;
+
     virtual void fail(afw::table::SourceRecord& measRecord, MeasurementError* error = nullptr) const;
 
 private:
+    void _measure(afw::table::SourceRecord& measRecord, afw::image::Exposure<float> const& exposure,
+                  afw::geom::ellipses::Quadrupole const* initialShape) const;
+
     Control _ctrl;
     ResultKey _resultKey;
     SafeCentroidExtractor _centroidExtractor;
+    std::string _name;
+    daf::base::PropertySet* _metadata;  // not owned; null if constructed without metadata
+    mutable long _nIter;
+    mutable long _nWarmStart;
+    mutable long _nIterSaved;
+    mutable std::vector<int> _nIterHist;     // number of sources by iteration count
+    mutable std::vector<int> _bboxAreaHist;  // number of sources by floor(log2(bboxArea))
+    mutable std::shared_ptr<PsfCache> _psfCache;  // for the exposure most recently measured
 };
 
 /**
@@ -226,6 +372,8 @@ public:
     ErrElement instFlux_xx_Cov;  ///< instFlux, xx term in the uncertainty covariance matrix
     ErrElement instFlux_yy_Cov;  ///< instFlux, yy term in the uncertainty covariance matrix
     ErrElement instFlux_xy_Cov;  ///< instFlux, xy term in the uncertainty covariance matrix
+    int nIter;                   ///< Number of adaptive moments iterations
+    int bboxArea;                ///< Number of pixels in the final adaptive moments bounding box
 
     std::bitset<SdssShapeAlgorithm::N_FLAGS> flags;  ///< Status flags (see SdssShapeAlgorithm).
 
@@ -237,7 +385,48 @@ public:
         return flags[SdssShapeAlgorithm::getFlagDefinitions().getDefinition(name).number];
     }
 
-    SdssShapeResult();  ///< Constructor; initializes everything to NaN
+    SdssShapeResult();  ///< Constructor; initializes everything to NaN (or zero for integers)
+};
+
+/**
+ *  The results of SdssShapeAlgorithm::computeAdaptiveMomentsBatch: one array per field of SdssShapeResult.
+ */
+class SdssShapeBatchResult {
+public:
+    /// Construct with all values NaN and all flags unset.
+    explicit SdssShapeBatchResult(std::size_t size);
+
+    /// Return the number of objects.
+    std::size_t size() const { return instFlux.getSize<0>(); }
+
+    /// Return the result for one object.
+    SdssShapeResult get(std::size_t i) const;
+
+    /// Set the result for one object.
+    void set(std::size_t i, SdssShapeResult const& result);
+
+    ndarray::Array<Flux, 1, 1> instFlux;
+    ndarray::Array<FluxErrElement, 1, 1> instFluxErr;
+    ndarray::Array<CentroidElement, 1, 1> x;
+    ndarray::Array<CentroidElement, 1, 1> y;
+    ndarray::Array<ErrElement, 1, 1> xErr;
+    ndarray::Array<ErrElement, 1, 1> yErr;
+    ndarray::Array<ErrElement, 1, 1> x_y_Cov;
+    ndarray::Array<ShapeElement, 1, 1> xx;
+    ndarray::Array<ShapeElement, 1, 1> yy;
+    ndarray::Array<ShapeElement, 1, 1> xy;
+    ndarray::Array<ErrElement, 1, 1> xxErr;
+    ndarray::Array<ErrElement, 1, 1> yyErr;
+    ndarray::Array<ErrElement, 1, 1> xyErr;
+    ndarray::Array<ErrElement, 1, 1> xx_yy_Cov;
+    ndarray::Array<ErrElement, 1, 1> xx_xy_Cov;
+    ndarray::Array<ErrElement, 1, 1> yy_xy_Cov;
+    ndarray::Array<ErrElement, 1, 1> instFlux_xx_Cov;
+    ndarray::Array<ErrElement, 1, 1> instFlux_yy_Cov;
+    ndarray::Array<ErrElement, 1, 1> instFlux_xy_Cov;
+    ndarray::Array<int, 1, 1> nIter;
+    ndarray::Array<int, 1, 1> bboxArea;
+    ndarray::Array<bool, 2, 2> flags;  ///< Status flags; shape (size, SdssShapeAlgorithm::N_FLAGS)
 };
 
 /**
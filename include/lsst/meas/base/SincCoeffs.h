@@ -24,10 +24,17 @@
 #ifndef LSST_MEAS_BASE_SincCoeffs_h_INCLUDED
 #define LSST_MEAS_BASE_SincCoeffs_h_INCLUDED
 
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <tuple>
 
 #include "lsst/afw/image/Image.h"
 #include "lsst/afw/geom/ellipses/Axes.h"
+#include "lsst/meas/base/SincCoeffsStore.h"
 
 namespace lsst {
 namespace meas {
@@ -36,16 +43,33 @@ namespace base {
 /**
  * A singleton to calculate and cache the coefficients for sinc photometry
  *
- * Caching is only performed for circular apertures (because elliptical
- * apertures are assumed to be generated dynamically, and hence not expected
- * to recur).  Caching must be explicitly requested for a particular circular
- * aperture (using the 'cache' method).
+ * Circular apertures may be cached permanently, which must be explicitly
+ * requested for a particular circular aperture (using the 'cache' method).
+ * Any other aperture (elliptical apertures, or circles whose size is only known
+ * at measurement time, such as those scaled to the PSF) may be looked up with a
+ * tolerance in a least-recently-used cache, whose total size is bounded (see
+ * 'setLruCapacity').  The coefficients of circular apertures are read from a
+ * SincCoeffsStore, if one is set and holds them, rather than calculated.
+ *
+ * All methods may be called concurrently from any number of threads.  Lookups
+ * only take a shared lock, and the coefficients of each cached aperture are
+ * calculated exactly once, by the first thread to need them (any other thread
+ * needing them at the same time waits for them).
  */
 template <typename PixelT>
 class SincCoeffs {
 public:
     typedef afw::image::Image<PixelT> CoeffT;
 
+    /// Cumulative counters of the least-recently-used cache, since the start of the process
+    struct LruStatistics {
+        std::size_t hits;       ///< Number of lookups that found coefficients in the cache
+        std::size_t misses;     ///< Number of lookups that had to calculate coefficients
+        std::size_t evictions;  ///< Number of coefficient images dropped to stay within the capacity
+        std::size_t size;       ///< Number of coefficient images currently cached
+        std::size_t bytes;      ///< Number of bytes of pixels currently cached
+    };
+
     /**
      * Cache the coefficients for a particular aperture
      *
@@ -61,6 +85,78 @@ public:
     static PTR(CoeffT const)
             get(afw::geom::ellipses::Axes const& outerEllipse, float const innerRadiusFactor = 0.0);
 
+    /**
+     * Get the coefficients for an aperture, sharing them with similar apertures
+     *
+     * Apertures not cached with the 'cache' method are looked up in the least-recently-used
+     * cache.  The aperture is first quantized: the axes on a logarithmic grid with a spacing of
+     * `tolerance`, the position angle on a grid with a spacing of `tolerance` radians (and set
+     * to zero for circles), and the inner radius factor on a grid with a spacing of `tolerance`,
+     * so the boundaries of the aperture actually used move by no more than about `tolerance/2`
+     * of its size.  The coefficients are calculated for the quantized aperture, so the result
+     * doesn't depend on the order of the lookups.  A `tolerance` of zero only shares the
+     * coefficients of identical apertures.
+     */
+    static PTR(CoeffT const) get(afw::geom::ellipses::Axes const& outerEllipse, float const innerRadiusFactor,
+                                 double const tolerance);
+
+    /**
+     * Set the largest number of bytes of pixels held by the least-recently-used cache
+     *
+     * The least recently used coefficients are evicted immediately if the cache is now too big;
+     * a capacity of zero disables it.
+     */
+    static void setLruCapacity(std::size_t bytes);
+
+    /// Return the largest number of bytes of pixels held by the least-recently-used cache
+    static std::size_t getLruCapacity();
+
+    /// Return the counters of the least-recently-used cache
+    static LruStatistics getLruStatistics();
+
+    /**
+     * Set the store consulted for the coefficients of circular apertures before calculating them
+     *
+     * Coefficients that are already cached are unaffected.  A null store stops consulting any.
+     */
+    static void setStore(std::shared_ptr<SincCoeffsStore const> store);
+
+    /**
+     * Set the store consulted for the coefficients of circular apertures, unless another is set
+     *
+     * The store is shared by the whole process, so algorithms configured with stores of different
+     * files can't coexist: if a store of another file is already set this throws
+     * pex::exceptions::InvalidParameterError rather than replacing it.  Stored coefficients are
+     * identical to calculated ones, so algorithms configured without a store may share it.
+     */
+    static void requireStore(std::shared_ptr<SincCoeffsStore const> store);
+
+    /// Return the store consulted for the coefficients of circular apertures (may be null)
+    static std::shared_ptr<SincCoeffsStore const> getStore();
+
+    /**
+     * Set how hard FFTW works to plan the transforms that calculate coefficients
+     *
+     * Plans are made once for each transform size and reused by all threads, so planning with
+     * FFTW_MEASURE, which is slow but yields faster transforms, pays off when many apertures are
+     * calculated.  Sizes that have already been planned are unaffected.
+     *
+     * @param[in] measure     Plan with FFTW_MEASURE rather than FFTW_ESTIMATE?
+     * @param[in] wisdomFile  File of FFTW wisdom to import now, and to export to whenever a plan
+     *                        is measured, so later processes needn't measure again; "" for none.
+     *                        Single- and double-precision wisdom have different formats, so the
+     *                        name is suffixed with "-float" or "-double".
+     */
+    static void setFftwPlanning(bool measure, std::string const& wisdomFile = "");
+
+    /**
+     * Plan the transforms with FFTW_MEASURE and a file of wisdom, unless another file is in use
+     *
+     * The planning is shared by the whole process, so if a different wisdom file has already been
+     * configured this throws pex::exceptions::InvalidParameterError rather than replacing it.
+     */
+    static void requireFftwPlanning(std::string const& wisdomFile);
+
     /// Calculate the coefficients for an aperture
     static PTR(CoeffT)
             calculate(afw::geom::ellipses::Axes const& outerEllipse, double const innerFactor = 0.0);
@@ -78,23 +174,59 @@ private:
         bool isEqual(T x, T y) const { return ::fabs(x - y) < std::numeric_limits<T>::epsilon(); }
     };
 
-    typedef std::map<float, PTR(CoeffT), FuzzyCompare<float> > CoeffMap;
+    // The coefficients for a cached aperture, calculated when first needed
+    struct CacheEntry {
+        std::once_flag calculated;
+        PTR(CoeffT const) coeff;
+    };
+
+    typedef std::map<float, std::shared_ptr<CacheEntry>, FuzzyCompare<float> > CoeffMap;
     typedef std::map<float, CoeffMap, FuzzyCompare<float> > CoeffMapMap;
-    SincCoeffs() : _cache(){};
+
+    // A quantized aperture in the least-recently-used cache: tolerance, a, b, theta, innerFactor
+    typedef std::tuple<double, double, double, double, double> LruKey;
+
+    // An aperture in the least-recently-used cache, with its position in the order of use
+    struct LruNode {
+        std::shared_ptr<CacheEntry> entry;
+        std::size_t bytes;  // zero until the coefficients have been calculated
+        typename std::list<LruKey>::iterator position;
+    };
+
+    typedef std::map<LruKey, LruNode> LruMap;
+
+    SincCoeffs() : _cache(), _lruCapacity(DEFAULT_LRU_CAPACITY), _lruStatistics(){};
     SincCoeffs(SincCoeffs const&);      // unimplemented: singleton
     void operator=(SincCoeffs const&);  // unimplemented: singleton
 
     static SincCoeffs& getInstance();
 
     /*
-     * Search the cache for coefficients for an aperture
+     * Search the cache for an aperture
      *
-     * If the coefficients are not cached, a null shared_ptr will be returned.
+     * If the aperture is not cached, a null shared_ptr will be returned.
      */
-    PTR(CoeffT const)
-    _lookup(afw::geom::ellipses::Axes const& outerEllipse, double const innerRadiusFactor = 0.0) const;
+    std::shared_ptr<CacheEntry> _lookup(afw::geom::ellipses::Axes const& outerEllipse,
+                                        double const innerRadiusFactor = 0.0) const;
+
+    /// Return the coefficients of a cache entry, calculating them if this is the first use
+    static PTR(CoeffT const) _getCoeff(CacheEntry& entry, afw::geom::ellipses::Axes const& outerEllipse,
+                                       double const innerRadiusFactor);
+
+    /// Evict the least recently used coefficients (but not those for `keep`) until within capacity
+    void _evictLru(LruKey const* keep);
+
+    static std::size_t const DEFAULT_LRU_CAPACITY = 256 << 20;
+
+    CoeffMapMap _cache;                             //< Cache of coefficients
+    std::shared_ptr<SincCoeffsStore const> _store;  //< Precomputed coefficients; may be null
+    mutable std::shared_timed_mutex _mutex;         //< Guards _store and the structure of _cache
 
-    CoeffMapMap _cache;  //< Cache of coefficients
+    LruMap _lru;                   //< Least-recently-used cache of coefficients
+    std::list<LruKey> _lruOrder;   //< Keys of _lru, most recently used first
+    std::size_t _lruCapacity;      //< Largest number of bytes of pixels in _lru
+    LruStatistics _lruStatistics;  //< Counters and size of _lru
+    mutable std::mutex _lruMutex;  //< Guards all of the _lru* members (not the entries)
 };
 
 }  // namespace base
@@ -0,0 +1,114 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2019  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#ifndef LSST_MEAS_BASE_SincCoeffsStore_h_INCLUDED
+#define LSST_MEAS_BASE_SincCoeffsStore_h_INCLUDED
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lsst/afw/image/Image.h"
+
+namespace lsst {
+namespace meas {
+namespace base {
+
+/**
+ *  A read-only file of precomputed sinc photometry coefficients for circular apertures
+ *
+ *  Calculating the coefficients of each configured aperture (see SincCoeffs::cache) is a noticeable part
+ *  of the startup time of a measurement process.  A store holds the coefficient images for a set of
+ *  (radius, inner radius factor, pixel type) in one binary file, which is mapped read-only into memory,
+ *  so the pages are shared by all the processes on a node that use it.  SincCoeffs consults the store
+ *  (see SincCoeffs::setStore) before calculating the coefficients of a circular aperture.
+ *
+ *  The file starts with a header holding a format version, a byte-order marker, the size of the file
+ *  and a checksum of everything that follows the header, all of which are verified when it is opened;
+ *  it is written to a temporary file that is then renamed, so readers never see a partial file.
+ */
+class SincCoeffsStore {
+public:
+    /// Version of the file format written by this code; other versions can't be read
+    static int const VERSION = 1;
+
+    /**
+     *  Return the store in a file, opening it if no other algorithm holds it.
+     *
+     *  A file that is replaced while a store holds it keeps being read from its old contents until
+     *  every holder lets go of it.
+     */
+    static std::shared_ptr<SincCoeffsStore const> get(std::string const& filename);
+
+    /**
+     *  Write a store holding the coefficients of circular apertures in float and double precision.
+     *
+     *  @param[in] filename  Name of the file to (over)write.
+     *  @param[in] rInner    Inner radius of each aperture, in pixels (0 for a disk).
+     *  @param[in] rOuter    Outer radius of each aperture, in pixels; same size as `rInner`.
+     */
+    static void write(std::string const& filename, std::vector<double> const& rInner,
+                      std::vector<double> const& rOuter);
+
+    /// Open and verify a store; throws pex::exceptions::IoError if the file can't be used
+    explicit SincCoeffsStore(std::string const& filename);
+
+    SincCoeffsStore(SincCoeffsStore const&) = delete;
+    SincCoeffsStore& operator=(SincCoeffsStore const&) = delete;
+
+    /**
+     *  Return the stored coefficients for a circular aperture, or null if they aren't stored.
+     *
+     *  The image shares the (read-only) memory of the file, which stays mapped while it exists.
+     *
+     *  @param[in] radius       Outer radius of the aperture, in pixels.
+     *  @param[in] innerFactor  Ratio of the inner radius to the outer radius.
+     */
+    template <typename PixelT>
+    std::shared_ptr<afw::image::Image<PixelT> const> getCoeffs(double radius, double innerFactor) const;
+
+    /// Return the number of coefficient images in the store
+    std::size_t size() const { return _entries.size(); }
+
+    /// Return the name of the file
+    std::string const& getFilename() const { return _filename; }
+
+private:
+    struct Entry {
+        float radius;
+        float innerFactor;
+        int pixelType;
+        int x0, y0, width, height;
+        std::size_t offset;  // of the pixels, from the start of the file
+    };
+
+    std::string _filename;
+    std::shared_ptr<char const> _data;  // the mapped file, unmapped when the last image lets go of it
+    std::vector<Entry> _entries;
+};
+
+}  // namespace base
+}  // namespace meas
+}  // namespace lsst
+
+#endif  // !LSST_MEAS_BASE_SincCoeffsStore_h_INCLUDED
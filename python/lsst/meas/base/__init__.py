@@ -39,10 +39,12 @@ from .localBackground import *
 from .naiveCentroid import *
 from .peakLikelihoodFlux import *
 from .pixelFlags import *
+from .psfCache import *
 from .psfFlux import *
 from .scaledApertureFlux import *
 from .sdssCentroid import *
 from .sdssShape import *
+from .sincCoeffsStore import *
 from .sincCoeffs import *
 from .transform import *
 
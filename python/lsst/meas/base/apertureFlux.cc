@@ -24,6 +24,7 @@
 #include "pybind11/stl.h"
 
 #include <memory>
+#include <string>
 
 #include "lsst/pex/config/python.h"
 #include "lsst/meas/base/python.h"
@@ -53,12 +54,31 @@ PyFluxControl declareFluxControl(py::module &mod) {
     LSST_DECLARE_CONTROL_FIELD(cls, ApertureFluxControl, radii);
     LSST_DECLARE_CONTROL_FIELD(cls, ApertureFluxControl, maxSincRadius);
     LSST_DECLARE_CONTROL_FIELD(cls, ApertureFluxControl, shiftKernel);
+    LSST_DECLARE_CONTROL_FIELD(cls, ApertureFluxControl, sincCacheTolerance);
+    LSST_DECLARE_CONTROL_FIELD(cls, ApertureFluxControl, sincCoeffsStore);
+    LSST_DECLARE_CONTROL_FIELD(cls, ApertureFluxControl, sincFftwWisdom);
 
     cls.def(py::init<>());
 
     return cls;
 }
 
+template <typename Image, class PyClass>
+void declareComputeNaiveFluxes(PyClass &cls) {
+    using Control = ApertureFluxAlgorithm::Control;
+    using Result = ApertureFluxAlgorithm::Result;
+
+    cls.def_static("computeNaiveFlux",
+                   (Result(*)(Image const &, afw::geom::ellipses::Ellipse const &, Control const &)) &
+                           ApertureFluxAlgorithm::computeNaiveFlux,
+                   "image"_a, "ellipse"_a, "ctrl"_a = Control());
+    cls.def_static("computeNaiveFluxes",
+                   (std::vector<Result>(*)(Image const &, geom::Point2D const &,
+                                           std::vector<double> const &)) &
+                           ApertureFluxAlgorithm::computeNaiveFluxes,
+                   "image"_a, "center"_a, "radii"_a);
+}
+
 template <typename Image, class PyClass>
 void declareComputeFluxes(PyClass &cls) {
     using Control = ApertureFluxAlgorithm::Control;
@@ -68,16 +88,55 @@ void declareComputeFluxes(PyClass &cls) {
                    (Result(*)(Image const &, afw::geom::ellipses::Ellipse const &, Control const &)) &
                            ApertureFluxAlgorithm::computeSincFlux,
                    "image"_a, "ellipse"_a, "ctrl"_a = Control());
-    cls.def_static("computeNaiveFlux",
-                   (Result(*)(Image const &, afw::geom::ellipses::Ellipse const &, Control const &)) &
-                           ApertureFluxAlgorithm::computeNaiveFlux,
-                   "image"_a, "ellipse"_a, "ctrl"_a = Control());
+    declareComputeNaiveFluxes<Image>(cls);
     cls.def_static("computeFlux",
                    (Result(*)(Image const &, afw::geom::ellipses::Ellipse const &, Control const &)) &
                            ApertureFluxAlgorithm::computeFlux,
                    "image"_a, "ellipse"_a, "ctrl"_a = Control());
 }
 
+template <typename T, class PyClass>
+void declareComputeSincFluxes(PyClass &cls) {
+    using Control = ApertureFluxAlgorithm::Control;
+    using Result = ApertureFluxAlgorithm::Result;
+
+    cls.def_static("computeSincFluxes",
+                   (std::vector<Result>(*)(afw::image::Image<T> const &, geom::Point2D const &,
+                                           SincCoeffsStack<T> const &, Control const &)) &
+                           ApertureFluxAlgorithm::computeSincFluxes,
+                   "image"_a, "center"_a, "coeffs"_a, "ctrl"_a = Control());
+    cls.def_static("computeSincFluxes",
+                   (std::vector<Result>(*)(afw::image::MaskedImage<T> const &, geom::Point2D const &,
+                                           SincCoeffsStack<T> const &, Control const &)) &
+                           ApertureFluxAlgorithm::computeSincFluxes,
+                   "image"_a, "center"_a, "coeffs"_a, "ctrl"_a = Control());
+}
+
+template <typename T>
+void declareSincCoeffsStack(py::module &mod, std::string const &suffix) {
+    using Class = SincCoeffsStack<T>;
+    py::class_<Class, std::shared_ptr<Class>> cls(mod, ("SincCoeffsStack" + suffix).c_str());
+
+    cls.def(py::init<std::vector<double> const &, ApertureFluxControl const &>(), "radii"_a,
+            "ctrl"_a = ApertureFluxControl());
+    cls.def("getRadii", &Class::getRadii);
+    cls.def("getBBox", (geom::Box2I const &(Class::*)() const) & Class::getBBox);
+    cls.def("getBBox", (geom::Box2I const &(Class::*)(std::size_t) const) & Class::getBBox, "i"_a);
+}
+
+template <typename T>
+void declarePrefixSumImage(py::module &mod, std::string const &suffix) {
+    using Class = PrefixSumImage<T>;
+    py::class_<Class, std::shared_ptr<Class>> cls(mod, ("PrefixSumImage" + suffix).c_str());
+
+    cls.def(py::init<afw::image::Image<T> const &>(), "image"_a);
+    cls.def(py::init<afw::image::MaskedImage<T> const &>(), "image"_a);
+    cls.def("getBBox", &Class::getBBox);
+    cls.def("hasVariance", &Class::hasVariance);
+    cls.def("sumImage", &Class::sumImage, "y"_a, "beginX"_a, "endX"_a);
+    cls.def("sumVariance", &Class::sumVariance, "y"_a, "beginX"_a, "endX"_a);
+}
+
 PyFluxAlgorithm declareFluxAlgorithm(py::module &mod) {
     PyFluxAlgorithm cls(mod, "ApertureFluxAlgorithm");
 
@@ -91,6 +150,10 @@ PyFluxAlgorithm declareFluxAlgorithm(py::module &mod) {
     declareComputeFluxes<afw::image::MaskedImage<double>>(cls);
     declareComputeFluxes<afw::image::Image<float>>(cls);
     declareComputeFluxes<afw::image::MaskedImage<float>>(cls);
+    declareComputeNaiveFluxes<PrefixSumImage<double>>(cls);
+    declareComputeNaiveFluxes<PrefixSumImage<float>>(cls);
+    declareComputeSincFluxes<double>(cls);
+    declareComputeSincFluxes<float>(cls);
 
     cls.def("measure", &ApertureFluxAlgorithm::measure, "measRecord"_a, "exposure"_a);
     cls.def("fail", &ApertureFluxAlgorithm::fail, "measRecord"_a, "error"_a = nullptr);
@@ -135,7 +198,11 @@ PYBIND11_MODULE(apertureFlux, mod) {
     py::module::import("lsst.meas.base.fluxUtilities");
     py::module::import("lsst.meas.base.transform");
 
+    declarePrefixSumImage<float>(mod, "F");
+    declarePrefixSumImage<double>(mod, "D");
     auto clsFluxControl = declareFluxControl(mod);
+    declareSincCoeffsStack<float>(mod, "F");
+    declareSincCoeffsStack<double>(mod, "D");
     auto clsFluxAlgorithm = declareFluxAlgorithm(mod);
     declareFluxResult(mod);
     auto clsFluxTransform = declareFluxTransform(mod);
@@ -0,0 +1,76 @@
+# This file is part of meas_base.
+#
+# Developed for the LSST Data Management System.
+# This product includes software developed by the LSST Project
+# (https://www.lsst.org).
+# See the COPYRIGHT file at the top-level directory of this distribution
+# for details of code ownership.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+"""Write a file of precomputed sinc photometry coefficients.
+
+The file can then be used by setting the ``sincCoeffsStore`` field of the
+configuration of ``base_CircularApertureFlux`` to its name.
+"""
+
+import argparse
+
+from .apertureFlux import ApertureFluxControl
+from .sincCoeffsStore import SincCoeffsStore
+
+__all__ = ("makeSincCoeffsStore", "main")
+
+
+def makeSincCoeffsStore(filename, radii=None, maxSincRadius=None):
+    """Write the coefficients of the circular apertures that
+    ``base_CircularApertureFlux`` measures with sinc photometry.
+
+    Parameters
+    ----------
+    filename : `str`
+        Name of the file to (over)write.
+    radii : iterable of `float`, optional
+        Radii of the apertures, in pixels; defaults to those of
+        `ApertureFluxControl`.
+    maxSincRadius : `float`, optional
+        Largest radius measured with sinc photometry; larger radii are
+        skipped.  Defaults to that of `ApertureFluxControl`.
+
+    Returns
+    -------
+    radii : `list` of `float`
+        The radii written.
+    """
+    ctrl = ApertureFluxControl()
+    if radii is None:
+        radii = ctrl.radii
+    if maxSincRadius is None:
+        maxSincRadius = ctrl.maxSincRadius
+    radii = [radius for radius in radii if radius <= maxSincRadius]
+    SincCoeffsStore.write(filename, [0.0]*len(radii), radii)
+    return radii
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("filename", help="name of the file to write")
+    parser.add_argument("--radii", type=float, nargs="+", default=None,
+                        help="aperture radii, in pixels (default: those of ApertureFluxConfig)")
+    parser.add_argument("--maxSincRadius", type=float, default=None,
+                        help="largest radius measured with sinc photometry (default: that of "
+                        "ApertureFluxConfig)")
+    args = parser.parse_args(argv)
+    radii = makeSincCoeffsStore(args.filename, radii=args.radii, maxSincRadius=args.maxSincRadius)
+    print("Wrote the coefficients of %d apertures to %s" % (len(radii), args.filename))
@@ -46,6 +46,8 @@ PyFluxControl declareFluxControl(py::module &mod) {
     PyFluxControl cls(mod, "PeakLikelihoodFluxControl");
 
     LSST_DECLARE_CONTROL_FIELD(cls, PeakLikelihoodFluxControl, warpingKernelName);
+    LSST_DECLARE_CONTROL_FIELD(cls, PeakLikelihoodFluxControl, psfCacheSpacing);
+    LSST_DECLARE_CONTROL_FIELD(cls, PeakLikelihoodFluxControl, psfCacheTolerance);
 
     return cls;
 }
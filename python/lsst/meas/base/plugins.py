@@ -85,9 +85,9 @@ wrapSimpleAlgorithm(SdssCentroidAlgorithm, Control=SdssCentroidControl,
                     TransformClass=SdssCentroidTransform, executionOrder=BasePlugin.CENTROID_ORDER)
 wrapSimpleAlgorithm(PixelFlagsAlgorithm, Control=PixelFlagsControl,
                     executionOrder=BasePlugin.FLUX_ORDER)
-wrapSimpleAlgorithm(SdssShapeAlgorithm, Control=SdssShapeControl,
+wrapSimpleAlgorithm(SdssShapeAlgorithm, needsMetadata=True, Control=SdssShapeControl,
                     TransformClass=SdssShapeTransform, executionOrder=BasePlugin.SHAPE_ORDER)
-wrapSimpleAlgorithm(ScaledApertureFluxAlgorithm, Control=ScaledApertureFluxControl,
+wrapSimpleAlgorithm(ScaledApertureFluxAlgorithm, needsMetadata=True, Control=ScaledApertureFluxControl,
                     TransformClass=ScaledApertureFluxTransform, executionOrder=BasePlugin.FLUX_ORDER)
 
 wrapSimpleAlgorithm(CircularApertureFluxAlgorithm, needsMetadata=True, Control=ApertureFluxControl,
@@ -0,0 +1,68 @@
+/*
+ * LSST Data Management System
+ * Copyright 2008-2019  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#include "pybind11/pybind11.h"
+
+#include <memory>
+
+#include "lsst/meas/base/PsfCache.h"
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+namespace lsst {
+namespace meas {
+namespace base {
+
+PYBIND11_MODULE(psfCache, mod) {
+    py::module::import("lsst.afw.detection");
+    py::module::import("lsst.afw.geom");
+    py::module::import("lsst.afw.image");
+    py::module::import("lsst.afw.math");
+
+    py::class_<PsfCache, std::shared_ptr<PsfCache>> cls(mod, "PsfCache");
+
+    py::class_<PsfCache::Statistics> clsStatistics(cls, "Statistics");
+    clsStatistics.def_readonly("hits", &PsfCache::Statistics::hits);
+    clsStatistics.def_readonly("fallbacks", &PsfCache::Statistics::fallbacks);
+    clsStatistics.def_readonly("evaluations", &PsfCache::Statistics::evaluations);
+
+    cls.def(py::init<std::shared_ptr<afw::detection::Psf const> const &, geom::Box2I const &>(), "psf"_a,
+            "bbox"_a);
+
+    cls.def_static("get", &PsfCache::get, "psf"_a, "bbox"_a);
+    cls.def("computeShape",
+            py::overload_cast<geom::Point2D const &, int, double>(&PsfCache::computeShape, py::const_),
+            "position"_a, "gridSpacing"_a, "tolerance"_a);
+    cls.def("computeShape", py::overload_cast<>(&PsfCache::computeShape, py::const_));
+    cls.def("computeImage", &PsfCache::computeImage, "position"_a, "gridSpacing"_a, "tolerance"_a);
+    cls.def("computeKernelImage", &PsfCache::computeKernelImage, "position"_a, "gridSpacing"_a,
+            "tolerance"_a);
+    cls.def("getLocalKernel", &PsfCache::getLocalKernel, "position"_a, "gridSpacing"_a, "tolerance"_a);
+    cls.def("getStatistics", &PsfCache::getStatistics);
+    cls.def("getPsf", &PsfCache::getPsf);
+    cls.def("getBBox", &PsfCache::getBBox);
+}
+
+}  // namespace base
+}  // namespace meas
+}  // namespace lsst
@@ -42,12 +42,16 @@ namespace {
 
 using PyFluxAlgorithm = py::class_<PsfFluxAlgorithm, std::shared_ptr<PsfFluxAlgorithm>, SimpleAlgorithm>;
 using PyFluxControl = py::class_<PsfFluxControl>;
+using PyFluxResult = py::class_<PsfFluxResult, std::shared_ptr<PsfFluxResult>, FluxResult>;
 using PyFluxTransform = py::class_<PsfFluxTransform, std::shared_ptr<PsfFluxTransform>, BaseTransform>;
 
 PyFluxControl declareFluxControl(py::module &mod) {
     PyFluxControl cls(mod, "PsfFluxControl");
 
     LSST_DECLARE_CONTROL_FIELD(cls, PsfFluxControl, badMaskPlanes);
+    LSST_DECLARE_CONTROL_FIELD(cls, PsfFluxControl, psfCacheSpacing);
+    LSST_DECLARE_CONTROL_FIELD(cls, PsfFluxControl, psfCacheTolerance);
+    LSST_DECLARE_CONTROL_FIELD(cls, PsfFluxControl, doMeasureN);
 
     cls.def(py::init<>());
 
@@ -67,9 +71,22 @@ PyFluxAlgorithm declareFluxAlgorithm(py::module &mod) {
     cls.def(py::init<PsfFluxAlgorithm::Control const &, std::string const &, afw::table::Schema &,
                      std::string const &>(),
             "ctrl"_a, "name"_a, "schema"_a, "logName"_a);
+
+    cls.def_static("computeFluxes", &PsfFluxAlgorithm::computeFluxes, "image"_a, "kernel"_a, "positions"_a,
+                   "ctrl"_a = PsfFluxControl());
+    cls.def("measureBatch", &PsfFluxAlgorithm::measureBatch, "measCat"_a, "exposure"_a);
     return cls;
 }
 
+void declareFluxResult(py::module &mod) {
+    PyFluxResult cls(mod, "PsfFluxResult");
+
+    cls.def_readwrite("area", &PsfFluxResult::area);
+    cls.def("getFlag", &PsfFluxResult::getFlag, "bit"_a);
+    cls.def("setFlag", &PsfFluxResult::setFlag, "index"_a, "value"_a);
+    cls.def("unsetFlag", &PsfFluxResult::unsetFlag, "index"_a);
+}
+
 PyFluxTransform declareFluxTransform(py::module &mod) {
     PyFluxTransform cls(mod, "PsfFluxTransform");
 
@@ -82,6 +99,8 @@ PyFluxTransform declareFluxTransform(py::module &mod) {
 }  // namespace
 
 PYBIND11_MODULE(psfFlux, mod) {
+    py::module::import("lsst.afw.image");
+    py::module::import("lsst.afw.math");
     py::module::import("lsst.afw.table");
     py::module::import("lsst.meas.base.algorithm");
     py::module::import("lsst.meas.base.flagHandler");
@@ -91,6 +110,7 @@ PYBIND11_MODULE(psfFlux, mod) {
     auto clsFluxControl = declareFluxControl(mod);
     auto clsFluxAlgorithm = declareFluxAlgorithm(mod);
     auto clsFluxTransform = declareFluxTransform(mod);
+    declareFluxResult(mod);
 
     clsFluxAlgorithm.attr("Control") = clsFluxControl;
     clsFluxTransform.attr("Control") = clsFluxControl;
@@ -48,6 +48,9 @@ PyFluxControl declareFluxControl(py::module &mod) {
     PyFluxControl cls(mod, "ScaledApertureFluxControl");
 
     LSST_DECLARE_CONTROL_FIELD(cls, ScaledApertureFluxControl, scale);
+    LSST_DECLARE_CONTROL_FIELD(cls, ScaledApertureFluxControl, psfCacheSpacing);
+    LSST_DECLARE_CONTROL_FIELD(cls, ScaledApertureFluxControl, psfCacheTolerance);
+    LSST_DECLARE_CONTROL_FIELD(cls, ScaledApertureFluxControl, sincCacheTolerance);
     LSST_DECLARE_CONTROL_FIELD(cls, ScaledApertureFluxControl, shiftKernel);
 
     cls.def(py::init<>());
@@ -61,6 +64,10 @@ PyFluxAlgorithm declareFluxAlgorithm(py::module &mod) {
     cls.def(py::init<ScaledApertureFluxAlgorithm::Control const &, std::string const &,
                      afw::table::Schema &>(),
             "ctrl"_a, "name"_a, "schema"_a);
+    // the algorithm keeps a pointer to the metadata
+    cls.def(py::init<ScaledApertureFluxAlgorithm::Control const &, std::string const &, afw::table::Schema &,
+                     daf::base::PropertySet &>(),
+            "ctrl"_a, "name"_a, "schema"_a, "metadata"_a, py::keep_alive<1, 5>());
 
     cls.def("measure", &ScaledApertureFluxAlgorithm::measure, "measRecord"_a, "exposure"_a);
     cls.def("fail", &ScaledApertureFluxAlgorithm::fail, "measRecord"_a, "error"_a = nullptr);
@@ -81,6 +88,7 @@ PyFluxTransform declareFluxTransform(py::module &mod) {
 }  // namespace
 
 PYBIND11_MODULE(scaledApertureFlux, mod) {
+    py::module::import("lsst.daf.base");
     py::module::import("lsst.afw.table");
     py::module::import("lsst.meas.base.algorithm");
     py::module::import("lsst.meas.base.fluxUtilities");
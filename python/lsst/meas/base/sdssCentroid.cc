@@ -52,6 +52,8 @@ PyCentroidControl declareCentroidControl(py::module &mod) {
     LSST_DECLARE_CONTROL_FIELD(cls, SdssCentroidControl, wfac);
     LSST_DECLARE_CONTROL_FIELD(cls, SdssCentroidControl, doFootprintCheck);
     LSST_DECLARE_CONTROL_FIELD(cls, SdssCentroidControl, maxDistToPeak);
+    LSST_DECLARE_CONTROL_FIELD(cls, SdssCentroidControl, psfCacheSpacing);
+    LSST_DECLARE_CONTROL_FIELD(cls, SdssCentroidControl, psfCacheTolerance);
 
     cls.def(py::init<>());
 
@@ -21,9 +21,12 @@
  */
 
 #include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
 
 #include <memory>
 
+#include "ndarray/pybind11.h"
+
 #include "lsst/pex/config/python.h"
 #include "lsst/meas/base/python.h"
 
@@ -46,6 +49,7 @@ using PyShapeControl = py::class_<SdssShapeControl>;
 using PyShapeResultKey = py::class_<SdssShapeResultKey, std::shared_ptr<SdssShapeResultKey>>;
 using PyShapeResult = py::class_<SdssShapeResult, std::shared_ptr<SdssShapeResult>, ShapeResult,
                                  CentroidResult, FluxResult>;
+using PyShapeBatchResult = py::class_<SdssShapeBatchResult, std::shared_ptr<SdssShapeBatchResult>>;
 using PyShapeAlgorithm = py::class_<SdssShapeAlgorithm, std::shared_ptr<SdssShapeAlgorithm>, SimpleAlgorithm>;
 using PyShapeTransform = py::class_<SdssShapeTransform, std::shared_ptr<SdssShapeTransform>, BaseTransform>;
 
@@ -58,6 +62,15 @@ PyShapeControl declareShapeControl(py::module &mod) {
     LSST_DECLARE_CONTROL_FIELD(cls, SdssShapeControl, tol1);
     LSST_DECLARE_CONTROL_FIELD(cls, SdssShapeControl, tol2);
     LSST_DECLARE_CONTROL_FIELD(cls, SdssShapeControl, doMeasurePsf);
+    LSST_DECLARE_CONTROL_FIELD(cls, SdssShapeControl, doVectorize);
+    LSST_DECLARE_CONTROL_FIELD(cls, SdssShapeControl, doWeightRecurrence);
+    LSST_DECLARE_CONTROL_FIELD(cls, SdssShapeControl, doCompensatedSums);
+    LSST_DECLARE_CONTROL_FIELD(cls, SdssShapeControl, initialGuess);
+    LSST_DECLARE_CONTROL_FIELD(cls, SdssShapeControl, doCompareColdStart);
+    LSST_DECLARE_CONTROL_FIELD(cls, SdssShapeControl, doAccelerate);
+    LSST_DECLARE_CONTROL_FIELD(cls, SdssShapeControl, psfCacheSpacing);
+    LSST_DECLARE_CONTROL_FIELD(cls, SdssShapeControl, psfCacheTolerance);
+    LSST_DECLARE_CONTROL_FIELD(cls, SdssShapeControl, pyramidMinSigma);
 
     cls.def(py::init<>());
 
@@ -90,11 +103,30 @@ static void declareComputeMethods(PyShapeAlgorithm &cls) {
             (SdssShapeResult(*)(ImageT const &, geom::Point2D const &, bool, SdssShapeControl const &)) &
                     SdssShapeAlgorithm::computeAdaptiveMoments,
             "image"_a, "position"_a, "negative"_a = false, "ctrl"_a = SdssShapeControl());
+    cls.def_static("computeAdaptiveMoments",
+                   (SdssShapeResult(*)(ImageT const &, geom::Point2D const &,
+                                       afw::geom::ellipses::Quadrupole const &, bool,
+                                       SdssShapeControl const &)) &
+                           SdssShapeAlgorithm::computeAdaptiveMoments,
+                   "image"_a, "position"_a, "initialShape"_a, "negative"_a = false,
+                   "ctrl"_a = SdssShapeControl());
+    cls.def_static("computeAdaptiveMomentsBatch",
+                   (SdssShapeBatchResult(*)(ImageT const &, std::vector<geom::Point2D> const &, bool,
+                                            SdssShapeControl const &, int)) &
+                           SdssShapeAlgorithm::computeAdaptiveMomentsBatch,
+                   "image"_a, "positions"_a, "negative"_a = false, "ctrl"_a = SdssShapeControl(),
+                   "nThreads"_a = 1, py::call_guard<py::gil_scoped_release>());
     cls.def_static(
             "computeFixedMomentsFlux",
-            (FluxResult(*)(ImageT const &, afw::geom::ellipses::Quadrupole const &, geom::Point2D const &)) &
+            (FluxResult(*)(ImageT const &, afw::geom::ellipses::Quadrupole const &, geom::Point2D const &,
+                           SdssShapeControl const &)) &
                     SdssShapeAlgorithm::computeFixedMomentsFlux,
-            "image"_a, "shape"_a, "position"_a);
+            "image"_a, "shape"_a, "position"_a, "ctrl"_a = SdssShapeControl());
+    cls.def_static("computeFixedMomentsFlux",
+                   (FluxResult(*)(ImageT const &, afw::geom::ellipses::Quadrupole const &,
+                                  geom::Point2D const &, afw::table::RecordId, SdssShapeControl const &)) &
+                           SdssShapeAlgorithm::computeFixedMomentsFlux,
+                   "image"_a, "shape"_a, "position"_a, "id"_a, "ctrl"_a = SdssShapeControl());
 }
 
 PyShapeAlgorithm declareShapeAlgorithm(py::module &mod) {
@@ -109,6 +141,10 @@ PyShapeAlgorithm declareShapeAlgorithm(py::module &mod) {
 
     cls.def(py::init<SdssShapeAlgorithm::Control const &, std::string const &, afw::table::Schema &>(),
             "ctrl"_a, "name"_a, "schema"_a);
+    // the algorithm keeps a pointer to the metadata
+    cls.def(py::init<SdssShapeAlgorithm::Control const &, std::string const &, afw::table::Schema &,
+                     daf::base::PropertySet &>(),
+            "ctrl"_a, "name"_a, "schema"_a, "metadata"_a, py::keep_alive<1, 5>());
 
     declareComputeMethods<afw::image::Image<int>>(cls);
     declareComputeMethods<afw::image::Image<float>>(cls);
@@ -131,6 +167,8 @@ void declareShapeResult(py::module &mod) {
     cls.def_readwrite("instFlux_xx_Cov", &SdssShapeResult::instFlux_xx_Cov);
     cls.def_readwrite("instFlux_yy_Cov", &SdssShapeResult::instFlux_yy_Cov);
     cls.def_readwrite("instFlux_xy_Cov", &SdssShapeResult::instFlux_xy_Cov);
+    cls.def_readwrite("nIter", &SdssShapeResult::nIter);
+    cls.def_readwrite("bboxArea", &SdssShapeResult::bboxArea);
     cls.def_readwrite("flags", &SdssShapeResult::flags);
 
     // TODO this method says it's a workaround for Swig which doesn't understand std::bitset
@@ -139,6 +177,39 @@ void declareShapeResult(py::module &mod) {
             "name"_a);
 }
 
+void declareShapeBatchResult(py::module &mod) {
+    PyShapeBatchResult cls(mod, "SdssShapeBatchResult");
+
+    cls.def(py::init<std::size_t>(), "size"_a);
+
+    cls.def("__len__", &SdssShapeBatchResult::size);
+    cls.def("get", &SdssShapeBatchResult::get, "i"_a);
+    cls.def("set", &SdssShapeBatchResult::set, "i"_a, "result"_a);
+
+    cls.def_readonly("instFlux", &SdssShapeBatchResult::instFlux);
+    cls.def_readonly("instFluxErr", &SdssShapeBatchResult::instFluxErr);
+    cls.def_readonly("x", &SdssShapeBatchResult::x);
+    cls.def_readonly("y", &SdssShapeBatchResult::y);
+    cls.def_readonly("xErr", &SdssShapeBatchResult::xErr);
+    cls.def_readonly("yErr", &SdssShapeBatchResult::yErr);
+    cls.def_readonly("x_y_Cov", &SdssShapeBatchResult::x_y_Cov);
+    cls.def_readonly("xx", &SdssShapeBatchResult::xx);
+    cls.def_readonly("yy", &SdssShapeBatchResult::yy);
+    cls.def_readonly("xy", &SdssShapeBatchResult::xy);
+    cls.def_readonly("xxErr", &SdssShapeBatchResult::xxErr);
+    cls.def_readonly("yyErr", &SdssShapeBatchResult::yyErr);
+    cls.def_readonly("xyErr", &SdssShapeBatchResult::xyErr);
+    cls.def_readonly("xx_yy_Cov", &SdssShapeBatchResult::xx_yy_Cov);
+    cls.def_readonly("xx_xy_Cov", &SdssShapeBatchResult::xx_xy_Cov);
+    cls.def_readonly("yy_xy_Cov", &SdssShapeBatchResult::yy_xy_Cov);
+    cls.def_readonly("instFlux_xx_Cov", &SdssShapeBatchResult::instFlux_xx_Cov);
+    cls.def_readonly("instFlux_yy_Cov", &SdssShapeBatchResult::instFlux_yy_Cov);
+    cls.def_readonly("instFlux_xy_Cov", &SdssShapeBatchResult::instFlux_xy_Cov);
+    cls.def_readonly("nIter", &SdssShapeBatchResult::nIter);
+    cls.def_readonly("bboxArea", &SdssShapeBatchResult::bboxArea);
+    cls.def_readonly("flags", &SdssShapeBatchResult::flags);
+}
+
 PyShapeTransform declareShapeTransform(py::module &mod) {
     PyShapeTransform cls(mod, "SdssShapeTransform");
 
@@ -154,6 +225,7 @@ PyShapeTransform declareShapeTransform(py::module &mod) {
 }  // namespace
 
 PYBIND11_MODULE(sdssShape, mod) {
+    py::module::import("lsst.daf.base");
     py::module::import("lsst.afw.geom");
     py::module::import("lsst.afw.table");
     py::module::import("lsst.meas.base.algorithm");
@@ -167,6 +239,7 @@ PYBIND11_MODULE(sdssShape, mod) {
     declareShapeResultKey(mod);
     auto clsShapeAlgorithm = declareShapeAlgorithm(mod);
     declareShapeResult(mod);
+    declareShapeBatchResult(mod);
     auto clsShapeTransform = declareShapeTransform(mod);
 
     clsShapeAlgorithm.attr("Control") = clsShapeControl;
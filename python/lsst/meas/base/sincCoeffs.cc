@@ -35,10 +35,35 @@ namespace {
 
 template <typename T>
 void declareSincCoeffs(py::module& mod, std::string const& suffix) {
+    using Statistics = typename SincCoeffs<T>::LruStatistics;
+
     py::class_<SincCoeffs<T>> cls(mod, ("SincCoeffs" + suffix).c_str());
 
-    cls.def_static("cache", &SincCoeffs<T>::cache, "rInner"_a, "rOuter"_a);
-    cls.def_static("get", &SincCoeffs<T>::get, "outerEllipse"_a, "innerRadiusFactor"_a);
+    py::class_<Statistics> clsStatistics(cls, "LruStatistics");
+    clsStatistics.def_readonly("hits", &Statistics::hits);
+    clsStatistics.def_readonly("misses", &Statistics::misses);
+    clsStatistics.def_readonly("evictions", &Statistics::evictions);
+    clsStatistics.def_readonly("size", &Statistics::size);
+    clsStatistics.def_readonly("bytes", &Statistics::bytes);
+
+    cls.def_static("cache", &SincCoeffs<T>::cache, "rInner"_a, "rOuter"_a,
+                   py::call_guard<py::gil_scoped_release>());
+    cls.def_static("get",
+                   py::overload_cast<afw::geom::ellipses::Axes const&, float>(&SincCoeffs<T>::get),
+                   "outerEllipse"_a, "innerRadiusFactor"_a, py::call_guard<py::gil_scoped_release>());
+    cls.def_static("get",
+                   py::overload_cast<afw::geom::ellipses::Axes const&, float, double>(
+                           &SincCoeffs<T>::get),
+                   "outerEllipse"_a, "innerRadiusFactor"_a, "tolerance"_a,
+                   py::call_guard<py::gil_scoped_release>());
+    cls.def_static("setLruCapacity", &SincCoeffs<T>::setLruCapacity, "bytes"_a);
+    cls.def_static("getLruCapacity", &SincCoeffs<T>::getLruCapacity);
+    cls.def_static("getLruStatistics", &SincCoeffs<T>::getLruStatistics);
+    cls.def_static("setStore", &SincCoeffs<T>::setStore, "store"_a);
+    cls.def_static("requireStore", &SincCoeffs<T>::requireStore, "store"_a);
+    cls.def_static("getStore", &SincCoeffs<T>::getStore);
+    cls.def_static("setFftwPlanning", &SincCoeffs<T>::setFftwPlanning, "measure"_a, "wisdomFile"_a = "");
+    cls.def_static("requireFftwPlanning", &SincCoeffs<T>::requireFftwPlanning, "wisdomFile"_a);
 }
 
 }  // namespace
@@ -46,6 +71,7 @@ void declareSincCoeffs(py::module& mod, std::string const& suffix) {
 PYBIND11_MODULE(sincCoeffs, mod) {
     py::module::import("lsst.afw.geom");
     py::module::import("lsst.afw.image");
+    py::module::import("lsst.meas.base.sincCoeffsStore");
 
     declareSincCoeffs<float>(mod, "F");
     declareSincCoeffs<double>(mod, "D");
@@ -0,0 +1,57 @@
+/*
+ * LSST Data Management System
+ * Copyright 2008-2019  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+
+#include <memory>
+
+#include "lsst/meas/base/SincCoeffsStore.h"
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+namespace lsst {
+namespace meas {
+namespace base {
+
+PYBIND11_MODULE(sincCoeffsStore, mod) {
+    py::module::import("lsst.afw.image");
+
+    py::class_<SincCoeffsStore, std::shared_ptr<SincCoeffsStore>> cls(mod, "SincCoeffsStore");
+
+    cls.def(py::init<std::string const &>(), "filename"_a);
+
+    cls.attr("VERSION") = py::cast(int(SincCoeffsStore::VERSION));
+
+    cls.def_static("get", &SincCoeffsStore::get, "filename"_a);
+    cls.def_static("write", &SincCoeffsStore::write, "filename"_a, "rInner"_a, "rOuter"_a,
+                   py::call_guard<py::gil_scoped_release>());
+    cls.def("getCoeffsF", &SincCoeffsStore::getCoeffs<float>, "radius"_a, "innerFactor"_a);
+    cls.def("getCoeffsD", &SincCoeffsStore::getCoeffs<double>, "radius"_a, "innerFactor"_a);
+    cls.def("__len__", &SincCoeffsStore::size);
+    cls.def("getFilename", &SincCoeffsStore::getFilename);
+}
+
+}  // namespace base
+}  // namespace meas
+}  // namespace lsst
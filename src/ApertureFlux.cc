@@ -21,17 +21,21 @@
  * see <http://www.lsstcorp.org/LegalNotices/>.
  */
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <numeric>
+#include <vector>
 
 #include "boost/algorithm/string/replace.hpp"
 
-#include "ndarray/eigen.h"
-
+#include "lsst/geom/Angle.h"
 #include "lsst/afw/math/offsetImage.h"
 #include "lsst/afw/geom/ellipses/PixelRegion.h"
 #include "lsst/afw/table/Source.h"
 #include "lsst/meas/base/SincCoeffs.h"
 #include "lsst/meas/base/ApertureFlux.h"
+#include "LanczosShift.h"
 
 namespace lsst {
 namespace meas {
@@ -48,7 +52,13 @@ FlagDefinition const ApertureFluxAlgorithm::SINC_COEFFS_TRUNCATED = flagDefiniti
 
 FlagDefinitionList const &ApertureFluxAlgorithm::getFlagDefinitions() { return flagDefinitions; }
 
-ApertureFluxControl::ApertureFluxControl() : radii(10), maxSincRadius(10.0), shiftKernel("lanczos5") {
+ApertureFluxControl::ApertureFluxControl()
+        : radii(10),
+          maxSincRadius(10.0),
+          shiftKernel("lanczos5"),
+          sincCacheTolerance(0.0),
+          sincCoeffsStore(""),
+          sincFftwWisdom("") {
     // defaults here stolen from HSC pipeline defaults
     static std::array<double, 10> defaultRadii = {{3.0, 4.5, 6.0, 9.0, 12.0, 17.0, 25.0, 35.0, 50.0, 70.0}};
     std::copy(defaultRadii.begin(), defaultRadii.end(), radii.begin());
@@ -107,35 +117,143 @@ void ApertureFluxAlgorithm::copyResultToRecord(Result const &result, afw::table:
 
 namespace {
 
-// Helper function for computeSincFlux get Sinc instFlux coefficients, and handle cases where the coeff
-// image needs to be clipped to fit in the measurement image
+// For the Lanczos kernels, we apply afw::math::offsetImage's convolution to the sinc coefficients on the
+// fly while computing their dot product with the image, so nothing needs to be allocated for each source.
+typedef detail::LanczosShift SincCoeffsShift;
+using detail::getLanczosOrder;
+using detail::setLanczosShift;
+
+SincCoeffsShift const NO_SHIFT = {0, 0, 1, {{1.0}}};
+
+// Set the shifts with which afw::math::offsetImage would move an image of the given dimensions to a
+// position; return false if they can't be applied on the fly
+bool setSincCoeffsShifts(std::string const &kernelName, geom::Point2D const &center,
+                         geom::Extent2I const &dimensions, SincCoeffsShift &xShift, SincCoeffsShift &yShift) {
+    int const order = getLanczosOrder(kernelName);
+    if (order == 0 || dimensions.getX() < 2 * order || dimensions.getY() < 2 * order) {
+        return false;
+    }
+    // offsetImage takes the position in single precision, and only moves the origin for large shifts
+    float const dx = center.getX();
+    float const dy = center.getY();
+    if (dx > -1 && dx < 1 && dy > -1 && dy < 1) {
+        setLanczosShift(order, 0, dx, xShift);
+        setLanczosShift(order, 0, dy, yShift);
+    } else {
+        int const dOrigX = static_cast<int>(std::floor(dx + 0.5));
+        int const dOrigY = static_cast<int>(std::floor(dy + 0.5));
+        setLanczosShift(order, dOrigX, dx - dOrigX, xShift);
+        setLanczosShift(order, dOrigY, dy - dOrigY, yShift);
+    }
+    return true;
+}
+
+// Return the (unshifted) sinc coefficients for an aperture
 template <typename T>
 CONST_PTR(afw::image::Image<T>)
-getSincCoeffs(geom::Box2I const &bbox,                      // measurement image bbox we need to fit inside
-              afw::geom::ellipses::Ellipse const &ellipse,  // ellipse that defines the aperture
-              ApertureFluxAlgorithm::Result &result,        // result object where we set flags if we do clip
-              ApertureFluxAlgorithm::Control const &ctrl    // configuration
-) {
-    CONST_PTR(afw::image::Image<T>) cImage = SincCoeffs<T>::get(ellipse.getCore(), 0.0);
-    cImage = afw::math::offsetImage(*cImage, ellipse.getCenter().getX(), ellipse.getCenter().getY(),
-                                    ctrl.shiftKernel);
-    if (!bbox.contains(cImage->getBBox())) {
+getSincCoeffs(afw::geom::ellipses::Ellipse const &ellipse, ApertureFluxAlgorithm::Control const &ctrl) {
+    if (ctrl.sincCacheTolerance < 0.0) {
+        return SincCoeffs<T>::get(ellipse.getCore(), 0.0);
+    }
+    return SincCoeffs<T>::get(ellipse.getCore(), 0.0, ctrl.sincCacheTolerance);
+}
+
+// Sum image*coeff and variance*coeff^2 over `overlap` (PARENT coordinates), where coeff is `coeffs` shifted
+// by `xShift` and `yShift`; `variance` may be null
+template <typename T, typename VarianceT>
+void accumulateSincFlux(afw::image::Image<T> const &coeffs, SincCoeffsShift const &xShift,
+                        SincCoeffsShift const &yShift, afw::image::Image<T> const &image,
+                        afw::image::Image<VarianceT> const *variance, geom::Box2I const &overlap,
+                        double &flux, double &fluxVar) {
+    thread_local std::vector<double> column;  // coefficients convolved in y, for the current row
+    int const width = coeffs.getWidth();
+    int const height = coeffs.getHeight();
+    int const x0 = coeffs.getX0() + xShift.offset;
+    int const y0 = coeffs.getY0() + yShift.offset;
+    int const xBegin = overlap.getMinX() - x0;
+    int const xEnd = overlap.getMaxX() + 1 - x0;
+    int const columnBegin = std::max(0, xBegin - xShift.ctr);
+    int const columnEnd = std::min(width, xEnd - xShift.ctr + xShift.size - 1);
+    column.resize(width);
+
+    auto coeffArray = coeffs.getArray();
+    auto imageArray = image.getArray();
+    T const *coeffData = coeffArray.getData();
+    std::ptrdiff_t const coeffStride = coeffArray.template getStride<0>();
+    for (int y = overlap.getMinY() - y0; y <= overlap.getMaxY() - y0; ++y) {
+        bool const isRowConvolved = yShift.isConvolved(y, height);
+        if (isRowConvolved) {
+            std::fill(column.begin() + columnBegin, column.begin() + columnEnd, 0.0);
+            for (int j = 0; j < yShift.size; ++j) {
+                T const *coeffRow = coeffData + (y - yShift.ctr + j) * coeffStride;
+                double const weight = yShift.values[j];
+                for (int x = columnBegin; x < columnEnd; ++x) {
+                    column[x] += weight * coeffRow[x];
+                }
+            }
+        }
+        T const *coeffRow = coeffData + y * coeffStride;
+        T const *imageRow = imageArray[y + y0 - image.getY0()].getData() + x0 - image.getX0();
+        VarianceT const *varianceRow =
+                variance ? variance->getArray()[y + y0 - variance->getY0()].getData() + x0 - variance->getX0()
+                         : nullptr;
+        for (int x = xBegin; x < xEnd; ++x) {
+            double convolved = coeffRow[x];
+            if (isRowConvolved && xShift.isConvolved(x, width)) {
+                convolved = 0.0;
+                for (int i = 0; i < xShift.size; ++i) {
+                    convolved += xShift.values[i] * column[x - xShift.ctr + i];
+                }
+            }
+            T const coeff = convolved;  // offsetImage rounds the shifted coefficients to the pixel type
+            flux += static_cast<double>(imageRow[x]) * coeff;
+            if (varianceRow) {
+                fluxVar += static_cast<T>(varianceRow[x]) * coeff * coeff;
+            }
+        }
+    }
+}
+
+// Compute the sinc flux of an image with an optional variance plane
+template <typename T, typename VarianceT>
+ApertureFluxAlgorithm::Result computeSincFluxImpl(afw::image::Image<T> const &image,
+                                                  afw::image::Image<VarianceT> const *variance,
+                                                  afw::geom::ellipses::Ellipse const &ellipse,
+                                                  ApertureFluxAlgorithm::Control const &ctrl) {
+    ApertureFluxAlgorithm::Result result;
+    CONST_PTR(afw::image::Image<T>) coeffs = getSincCoeffs<T>(ellipse, ctrl);
+    SincCoeffsShift xShift, yShift;
+    if (!setSincCoeffsShifts(ctrl.shiftKernel, ellipse.getCenter(), coeffs->getDimensions(), xShift,
+                             yShift)) {
+        coeffs = afw::math::offsetImage(*coeffs, ellipse.getCenter().getX(), ellipse.getCenter().getY(),
+                                        ctrl.shiftKernel);
+        xShift = yShift = NO_SHIFT;
+    }
+    geom::Box2I overlap(geom::Point2I(coeffs->getX0() + xShift.offset, coeffs->getY0() + yShift.offset),
+                        coeffs->getDimensions());
+    if (!image.getBBox().contains(overlap)) {
         // We had to clip out at least part part of the coeff image,
         // but since that's much larger than the aperture (and close
         // to zero outside the aperture), it may not be a serious
         // problem.
         result.setFlag(ApertureFluxAlgorithm::SINC_COEFFS_TRUNCATED.number);
-        geom::Box2I overlap = cImage->getBBox();
-        overlap.clip(bbox);
+        overlap.clip(image.getBBox());
         if (!overlap.contains(geom::Box2I(ellipse.computeBBox()))) {
             // The clipping was indeed serious, as we we did have to clip within
             // the aperture; can't expect any decent answer at this point.
             result.setFlag(ApertureFluxAlgorithm::APERTURE_TRUNCATED.number);
             result.setFlag(ApertureFluxAlgorithm::FAILURE.number);
+            return result;
         }
-        cImage = std::make_shared<afw::image::Image<T> >(*cImage, overlap);
     }
-    return cImage;
+    double flux = 0.0;
+    double fluxVar = 0.0;
+    accumulateSincFlux(*coeffs, xShift, yShift, image, variance, overlap, flux, fluxVar);
+    result.instFlux = flux;
+    if (variance) {
+        result.instFluxErr = std::sqrt(fluxVar);
+    }
+    return result;
 }
 
 }  // namespace
@@ -143,31 +261,199 @@ getSincCoeffs(geom::Box2I const &bbox,                      // measurement image
 template <typename T>
 ApertureFluxAlgorithm::Result ApertureFluxAlgorithm::computeSincFlux(
         afw::image::Image<T> const &image, afw::geom::ellipses::Ellipse const &ellipse, Control const &ctrl) {
-    Result result;
-    CONST_PTR(afw::image::Image<T>) cImage = getSincCoeffs<T>(image.getBBox(), ellipse, result, ctrl);
-    if (result.getFlag(APERTURE_TRUNCATED.number)) return result;
-    afw::image::Image<T> subImage(image, cImage->getBBox());
-    result.instFlux =
-            (ndarray::asEigenArray(subImage.getArray()) * ndarray::asEigenArray(cImage->getArray())).sum();
-    return result;
+    return computeSincFluxImpl(image, static_cast<afw::image::Image<T> const *>(nullptr), ellipse, ctrl);
 }
 
 template <typename T>
 ApertureFluxAlgorithm::Result ApertureFluxAlgorithm::computeSincFlux(
         afw::image::MaskedImage<T> const &image, afw::geom::ellipses::Ellipse const &ellipse,
         Control const &ctrl) {
-    Result result;
-    CONST_PTR(afw::image::Image<T>) cImage = getSincCoeffs<T>(image.getBBox(), ellipse, result, ctrl);
-    if (result.getFlag(APERTURE_TRUNCATED.number)) return result;
-    afw::image::MaskedImage<T> subImage(image, cImage->getBBox(afw::image::PARENT), afw::image::PARENT);
-    result.instFlux = (ndarray::asEigenArray(subImage.getImage()->getArray()) *
-                       ndarray::asEigenArray(cImage->getArray()))
-                              .sum();
-    result.instFluxErr =
-            std::sqrt((ndarray::asEigenArray(subImage.getVariance()->getArray()).template cast<T>() *
-                       ndarray::asEigenArray(cImage->getArray()).square())
-                              .sum());
-    return result;
+    return computeSincFluxImpl(*image.getImage(), image.getVariance().get(), ellipse, ctrl);
+}
+
+template <typename T>
+SincCoeffsStack<T>::SincCoeffsStack(std::vector<double> const &radii, ApertureFluxControl const &ctrl)
+        : _radii(radii) {
+    std::vector<CONST_PTR(afw::image::Image<T>)> images;
+    images.reserve(radii.size());
+    _bboxes.reserve(radii.size());
+    for (double radius : radii) {
+        images.push_back(getSincCoeffs<T>(
+                afw::geom::ellipses::Ellipse(afw::geom::ellipses::Axes(radius, radius, 0.0)), ctrl));
+        _bboxes.push_back(images.back()->getBBox());
+        _bbox.include(_bboxes.back());
+    }
+    std::size_t const n = radii.size();
+    _coeffs.assign(static_cast<std::size_t>(_bbox.getArea()) * n, 0.0);
+    for (std::size_t k = 0; k < n; ++k) {
+        geom::Box2I const &bbox = _bboxes[k];
+        for (int y = 0; y < bbox.getHeight(); ++y) {
+            std::size_t const row = bbox.getMinY() + y - _bbox.getMinY();
+            std::size_t index = (row * _bbox.getWidth() + bbox.getMinX() - _bbox.getMinX()) * n + k;
+            for (typename afw::image::Image<T>::x_iterator ptr = images[k]->row_begin(y),
+                                                           end = images[k]->row_end(y);
+                 ptr != end; ++ptr, index += n) {
+                _coeffs[index] = *ptr;
+            }
+        }
+    }
+}
+
+namespace {
+
+// Compute the sinc fluxes of stacked apertures on an image with an optional variance plane.
+//
+// This is accumulateSincFlux applied to all the apertures in one pass over the pixels: the coefficients of
+// the apertures at each pixel are adjacent, so each convolution and product runs over a short vector of
+// apertures.  Each aperture is still shifted as offsetImage would shift its own coefficient image (copying
+// the pixels at its edges), and its sums are accumulated in the same order, so the results are identical.
+template <typename T, typename VarianceT>
+std::vector<ApertureFluxAlgorithm::Result> computeSincFluxesImpl(afw::image::Image<T> const &image,
+                                                                 afw::image::Image<VarianceT> const *variance,
+                                                                 geom::Point2D const &center,
+                                                                 SincCoeffsStack<T> const &stack,
+                                                                 ApertureFluxAlgorithm::Control const &ctrl) {
+    std::size_t const n = stack.getRadii().size();
+    std::vector<ApertureFluxAlgorithm::Result> results(n);
+    SincCoeffsShift xShift, yShift;
+    bool canShift = setSincCoeffsShifts(ctrl.shiftKernel, center, stack.getBBox().getDimensions(), xShift,
+                                        yShift);
+    for (std::size_t k = 0; canShift && k < n; ++k) {
+        SincCoeffsShift unused;
+        canShift = setSincCoeffsShifts(ctrl.shiftKernel, center, stack.getBBox(k).getDimensions(), unused,
+                                       unused);
+    }
+    if (!canShift) {
+        for (std::size_t k = 0; k < n; ++k) {
+            afw::geom::ellipses::Axes const axes(stack.getRadii()[k], stack.getRadii()[k], 0.0);
+            afw::geom::ellipses::Ellipse const ellipse(axes, center);
+            results[k] = computeSincFluxImpl(image, variance, ellipse, ctrl);
+        }
+        return results;
+    }
+
+    // The pixels measured by each aperture, as in computeSincFluxImpl
+    geom::Extent2I const offset(xShift.offset, yShift.offset);
+    std::vector<geom::Box2I> overlaps(n);
+    geom::Box2I overlapAll;
+    for (std::size_t k = 0; k < n; ++k) {
+        geom::Box2I overlap(stack.getBBox(k).getMin() + offset, stack.getBBox(k).getDimensions());
+        if (!image.getBBox().contains(overlap)) {
+            results[k].setFlag(ApertureFluxAlgorithm::SINC_COEFFS_TRUNCATED.number);
+            overlap.clip(image.getBBox());
+            afw::geom::ellipses::Axes const axes(stack.getRadii()[k], stack.getRadii()[k], 0.0);
+            if (!overlap.contains(geom::Box2I(afw::geom::ellipses::Ellipse(axes, center).computeBBox()))) {
+                results[k].setFlag(ApertureFluxAlgorithm::APERTURE_TRUNCATED.number);
+                results[k].setFlag(ApertureFluxAlgorithm::FAILURE.number);
+                continue;
+            }
+        }
+        overlaps[k] = overlap;
+        overlapAll.include(overlap);
+    }
+    if (overlapAll.isEmpty()) {
+        return results;
+    }
+
+    // Positions are relative to the stack from here on, unless they're relative to an aperture (subscript k)
+    int const width = stack.getBBox().getWidth();
+    int const x0 = stack.getBBox().getMinX() + xShift.offset;
+    int const y0 = stack.getBBox().getMinY() + yShift.offset;
+    std::vector<int> xk0(n), yk0(n), widthk(n), heightk(n);
+    for (std::size_t k = 0; k < n; ++k) {
+        xk0[k] = stack.getBBox(k).getMinX() - stack.getBBox().getMinX();
+        yk0[k] = stack.getBBox(k).getMinY() - stack.getBBox().getMinY();
+        widthk[k] = stack.getBBox(k).getWidth();
+        heightk[k] = stack.getBBox(k).getHeight();
+    }
+    int const xBegin = overlapAll.getMinX() - x0;
+    int const xEnd = overlapAll.getMaxX() + 1 - x0;
+    std::size_t const columnBegin = std::max(0, xBegin - xShift.ctr) * n;
+    std::size_t const columnEnd = std::min(width, xEnd - xShift.ctr + xShift.size - 1) * n;
+    thread_local std::vector<double> column;  // coefficients convolved in y, for the current row
+    column.resize(width * n);
+    std::vector<int> xBeginK(n), xEndK(n);  // columns measured by each aperture in the current row
+    std::vector<char> isRowConvolved(n);
+    std::vector<double> fluxes(n, 0.0);
+    std::vector<double> fluxVars(n, 0.0);
+
+    auto imageArray = image.getArray();
+    T const *coeffData = stack.getCoeffs();
+    std::size_t const coeffStride = width * n;
+    for (int y = overlapAll.getMinY() - y0; y <= overlapAll.getMaxY() - y0; ++y) {
+        bool isAnyRowConvolved = false;
+        for (std::size_t k = 0; k < n; ++k) {
+            bool const isRowMeasured = !overlaps[k].isEmpty() && y + y0 >= overlaps[k].getMinY() &&
+                                       y + y0 <= overlaps[k].getMaxY();
+            xBeginK[k] = isRowMeasured ? overlaps[k].getMinX() - x0 : 0;
+            xEndK[k] = isRowMeasured ? overlaps[k].getMaxX() + 1 - x0 : 0;
+            isRowConvolved[k] = isRowMeasured && yShift.isConvolved(y - yk0[k], heightk[k]);
+            isAnyRowConvolved |= isRowConvolved[k];
+        }
+        if (isAnyRowConvolved) {
+            // the rows convolved lie within the coefficients of each aperture for which this row is convolved
+            std::fill(column.begin() + columnBegin, column.begin() + columnEnd, 0.0);
+            for (int j = 0; j < yShift.size; ++j) {
+                T const *coeffRow = coeffData + (y - yShift.ctr + j) * coeffStride;
+                double const weight = yShift.values[j];
+                for (std::size_t i = columnBegin; i < columnEnd; ++i) {
+                    column[i] += weight * coeffRow[i];
+                }
+            }
+        }
+        T const *coeffRow = coeffData + y * coeffStride;
+        T const *imageRow = imageArray[y + y0 - image.getY0()].getData() + x0 - image.getX0();
+        VarianceT const *varianceRow =
+                variance ? variance->getArray()[y + y0 - variance->getY0()].getData() + x0 - variance->getX0()
+                         : nullptr;
+        for (int x = xBegin; x < xEnd; ++x) {
+            for (std::size_t k = 0; k < n; ++k) {
+                if (x < xBeginK[k] || x >= xEndK[k]) {
+                    continue;
+                }
+                double convolved = coeffRow[x * n + k];
+                if (isRowConvolved[k] && xShift.isConvolved(x - xk0[k], widthk[k])) {
+                    convolved = 0.0;
+                    for (int i = 0; i < xShift.size; ++i) {
+                        convolved += xShift.values[i] * column[(x - xShift.ctr + i) * n + k];
+                    }
+                }
+                T const coeff = convolved;  // offsetImage rounds the shifted coefficients to the pixel type
+                fluxes[k] += static_cast<double>(imageRow[x]) * coeff;
+                if (varianceRow) {
+                    fluxVars[k] += static_cast<T>(varianceRow[x]) * coeff * coeff;
+                }
+            }
+        }
+    }
+
+    for (std::size_t k = 0; k < n; ++k) {
+        if (overlaps[k].isEmpty()) {
+            continue;
+        }
+        results[k].instFlux = fluxes[k];
+        if (variance) {
+            results[k].instFluxErr = std::sqrt(fluxVars[k]);
+        }
+    }
+    return results;
+}
+
+}  // namespace
+
+template <typename T>
+std::vector<ApertureFluxAlgorithm::Result> ApertureFluxAlgorithm::computeSincFluxes(
+        afw::image::Image<T> const &image, geom::Point2D const &center, SincCoeffsStack<T> const &coeffs,
+        Control const &ctrl) {
+    return computeSincFluxesImpl(image, static_cast<afw::image::Image<T> const *>(nullptr), center, coeffs,
+                                 ctrl);
+}
+
+template <typename T>
+std::vector<ApertureFluxAlgorithm::Result> ApertureFluxAlgorithm::computeSincFluxes(
+        afw::image::MaskedImage<T> const &image, geom::Point2D const &center,
+        SincCoeffsStack<T> const &coeffs, Control const &ctrl) {
+    return computeSincFluxesImpl(*image.getImage(), image.getVariance().get(), center, coeffs, ctrl);
 }
 
 template <typename T>
@@ -217,6 +503,182 @@ ApertureFluxAlgorithm::Result ApertureFluxAlgorithm::computeNaiveFlux(
     return result;
 }
 
+namespace {
+
+// Sum the pixels in columns [begin, end) of a row
+template <typename Iterator>
+double sumColumns(Iterator row, int begin, int end) {
+    return (begin < end) ? std::accumulate(row + begin, row + end, 0.0) : 0.0;
+}
+
+template <typename T, typename VarianceT>
+std::vector<ApertureFluxAlgorithm::Result> computeNaiveFluxesImpl(
+        afw::image::Image<T> const &image, afw::image::Image<VarianceT> const *variance,
+        geom::Point2D const &center, std::vector<double> const &radii) {
+    std::vector<ApertureFluxAlgorithm::Result> results(radii.size());
+
+    // Visit the apertures from the smallest out, keeping the regions of those that fit within the image
+    std::vector<std::size_t> order(radii.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&radii](std::size_t a, std::size_t b) { return radii[a] < radii[b]; });
+    std::vector<std::size_t> fitting;
+    std::vector<afw::geom::ellipses::PixelRegion> regions;
+    geom::Box2I bbox;
+    for (std::size_t i : order) {
+        afw::geom::ellipses::PixelRegion region(
+                afw::geom::ellipses::Ellipse(afw::geom::ellipses::Axes(radii[i], radii[i], 0.0), center));
+        if (!image.getBBox().contains(region.getBBox())) {
+            results[i].setFlag(ApertureFluxAlgorithm::APERTURE_TRUNCATED.number);
+            results[i].setFlag(ApertureFluxAlgorithm::FAILURE.number);
+            continue;
+        }
+        bbox.include(region.getBBox());
+        fitting.push_back(i);
+        regions.push_back(region);
+    }
+    if (fitting.empty()) {
+        return results;
+    }
+
+    // The columns (relative to the image) of each region in each row of their union; empty if begin == end
+    int const height = bbox.getHeight();
+    std::vector<int> begins(fitting.size() * height, 0);
+    std::vector<int> ends(fitting.size() * height, 0);
+    for (std::size_t k = 0; k < regions.size(); ++k) {
+        for (afw::geom::ellipses::PixelRegion::Iterator spanIter = regions[k].begin(),
+                                                        spanEnd = regions[k].end();
+             spanIter != spanEnd; ++spanIter) {
+            std::size_t const index = k * height + spanIter->getY() - bbox.getMinY();
+            begins[index] = spanIter->getBeginX() - image.getX0();
+            ends[index] = begins[index] + spanIter->getWidth();
+        }
+    }
+
+    // Sum each row once: the spans of concentric circles nest, so each aperture adds only the pixels
+    // outside the columns already summed for the apertures within it
+    std::vector<double> fluxes(fitting.size(), 0.0);
+    std::vector<double> variances(fitting.size(), 0.0);
+    for (int row = 0; row < height; ++row) {
+        int const y = bbox.getMinY() + row - image.getY0();
+        typename afw::image::Image<T>::x_iterator pixRow = image.row_begin(y);
+        int lo = 0, hi = 0;  // columns summed so far
+        double rowFlux = 0.0;
+        double rowVariance = 0.0;
+        for (std::size_t k = 0; k < fitting.size(); ++k) {
+            int const begin = begins[k * height + row];
+            int const end = ends[k * height + row];
+            if (begin < end) {
+                if (lo == hi) {
+                    lo = hi = begin;
+                }
+                rowFlux += sumColumns(pixRow, begin, lo) + sumColumns(pixRow, hi, end);
+                if (variance) {
+                    typename afw::image::Image<VarianceT>::x_iterator varRow = variance->row_begin(y);
+                    rowVariance += sumColumns(varRow, begin, lo) + sumColumns(varRow, hi, end);
+                }
+                lo = std::min(lo, begin);
+                hi = std::max(hi, end);
+            }
+            fluxes[k] += rowFlux;
+            variances[k] += rowVariance;
+        }
+    }
+
+    for (std::size_t k = 0; k < fitting.size(); ++k) {
+        ApertureFluxAlgorithm::Result &result = results[fitting[k]];
+        result.instFlux = fluxes[k];
+        if (variance) {
+            result.instFluxErr = std::sqrt(variances[k]);
+        }
+    }
+    return results;
+}
+
+}  // namespace
+
+template <typename T>
+std::vector<ApertureFluxAlgorithm::Result> ApertureFluxAlgorithm::computeNaiveFluxes(
+        afw::image::Image<T> const &image, geom::Point2D const &center, std::vector<double> const &radii) {
+    return computeNaiveFluxesImpl(image, static_cast<afw::image::Image<T> const *>(nullptr), center, radii);
+}
+
+template <typename T>
+std::vector<ApertureFluxAlgorithm::Result> ApertureFluxAlgorithm::computeNaiveFluxes(
+        afw::image::MaskedImage<T> const &image, geom::Point2D const &center,
+        std::vector<double> const &radii) {
+    return computeNaiveFluxesImpl(*image.getImage(), image.getVariance().get(), center, radii);
+}
+
+namespace {
+
+// Fill sums with the sum of the pixels to the left of each column (and the end) of each row of an image
+template <typename T>
+void sumRows(afw::image::Image<T> const &image, std::vector<double> &sums) {
+    sums.resize(static_cast<std::size_t>(image.getWidth() + 1) * image.getHeight());
+    std::vector<double>::iterator out = sums.begin();
+    for (int y = 0; y < image.getHeight(); ++y) {
+        double sum = 0.0;
+        *out++ = sum;
+        for (typename afw::image::Image<T>::x_iterator ptr = image.row_begin(y), end = image.row_end(y);
+             ptr != end; ++ptr) {
+            sum += *ptr;
+            *out++ = sum;
+        }
+    }
+}
+
+}  // namespace
+
+template <typename T>
+PrefixSumImage<T>::PrefixSumImage(afw::image::Image<T> const &image) : _bbox(image.getBBox()) {
+    sumRows(image, _image);
+}
+
+template <typename T>
+PrefixSumImage<T>::PrefixSumImage(afw::image::MaskedImage<T> const &image) : _bbox(image.getBBox()) {
+    sumRows(*image.getImage(), _image);
+    sumRows(*image.getVariance(), _variance);
+}
+
+template <typename T>
+ApertureFluxAlgorithm::Result ApertureFluxAlgorithm::computeNaiveFlux(
+        PrefixSumImage<T> const &sums, afw::geom::ellipses::Ellipse const &ellipse, Control const &ctrl) {
+    Result result;
+    afw::geom::ellipses::PixelRegion region(ellipse);  // behaves mostly like a Footprint
+    if (!sums.getBBox().contains(region.getBBox())) {
+        result.setFlag(APERTURE_TRUNCATED.number);
+        result.setFlag(FAILURE.number);
+        return result;
+    }
+    result.instFlux = 0.0;
+    double variance = 0.0;
+    for (afw::geom::ellipses::PixelRegion::Iterator spanIter = region.begin(), spanEnd = region.end();
+         spanIter != spanEnd; ++spanIter) {
+        int const endX = spanIter->getBeginX() + spanIter->getWidth();
+        result.instFlux += sums.sumImage(spanIter->getY(), spanIter->getBeginX(), endX);
+        if (sums.hasVariance()) {
+            variance += sums.sumVariance(spanIter->getY(), spanIter->getBeginX(), endX);
+        }
+    }
+    if (sums.hasVariance()) {
+        result.instFluxErr = std::sqrt(variance);
+    }
+    return result;
+}
+
+template <typename T>
+std::vector<ApertureFluxAlgorithm::Result> ApertureFluxAlgorithm::computeNaiveFluxes(
+        PrefixSumImage<T> const &sums, geom::Point2D const &center, std::vector<double> const &radii) {
+    std::vector<Result> results;
+    results.reserve(radii.size());
+    for (double radius : radii) {
+        afw::geom::ellipses::Ellipse const ellipse(afw::geom::ellipses::Axes(radius, radius, 0.0), center);
+        results.push_back(computeNaiveFlux(sums, ellipse));
+    }
+    return results;
+}
+
 template <typename T>
 ApertureFluxAlgorithm::Result ApertureFluxAlgorithm::computeFlux(afw::image::Image<T> const &image,
                                                                  afw::geom::ellipses::Ellipse const &ellipse,
@@ -246,7 +708,23 @@ ApertureFluxAlgorithm::Result ApertureFluxAlgorithm::computeFlux(afw::image::Mas
     template ApertureFluxAlgorithm::Result ApertureFluxAlgorithm::computeNaiveFlux(                     \
             afw::image::Image<T> const &, afw::geom::ellipses::Ellipse const &, Control const &);       \
     template ApertureFluxAlgorithm::Result ApertureFluxAlgorithm::computeNaiveFlux(                     \
-            afw::image::MaskedImage<T> const &, afw::geom::ellipses::Ellipse const &, Control const &)
+            afw::image::MaskedImage<T> const &, afw::geom::ellipses::Ellipse const &, Control const &); \
+    template std::vector<ApertureFluxAlgorithm::Result> ApertureFluxAlgorithm::computeNaiveFluxes(      \
+            afw::image::Image<T> const &, geom::Point2D const &, std::vector<double> const &);          \
+    template std::vector<ApertureFluxAlgorithm::Result> ApertureFluxAlgorithm::computeNaiveFluxes(      \
+            afw::image::MaskedImage<T> const &, geom::Point2D const &, std::vector<double> const &);    \
+    template class PrefixSumImage<T>;                                                                   \
+    template class SincCoeffsStack<T>;                                                                  \
+    template std::vector<ApertureFluxAlgorithm::Result> ApertureFluxAlgorithm::computeSincFluxes(       \
+            afw::image::Image<T> const &, geom::Point2D const &, SincCoeffsStack<T> const &,            \
+            Control const &);                                                                           \
+    template std::vector<ApertureFluxAlgorithm::Result> ApertureFluxAlgorithm::computeSincFluxes(       \
+            afw::image::MaskedImage<T> const &, geom::Point2D const &, SincCoeffsStack<T> const &,      \
+            Control const &);                                                                           \
+    template ApertureFluxAlgorithm::Result ApertureFluxAlgorithm::computeNaiveFlux(                     \
+            PrefixSumImage<T> const &, afw::geom::ellipses::Ellipse const &, Control const &);          \
+    template std::vector<ApertureFluxAlgorithm::Result> ApertureFluxAlgorithm::computeNaiveFluxes(      \
+            PrefixSumImage<T> const &, geom::Point2D const &, std::vector<double> const &)
 
 INSTANTIATE(float);
 INSTANTIATE(double);
@@ -25,6 +25,7 @@
 #include "lsst/meas/base/ApertureFlux.h"
 #include "lsst/meas/base/CircularApertureFlux.h"
 #include "lsst/meas/base/SincCoeffs.h"
+#include "lsst/meas/base/SincCoeffsStore.h"
 
 namespace lsst {
 namespace meas {
@@ -34,26 +35,55 @@ CircularApertureFluxAlgorithm::CircularApertureFluxAlgorithm(Control const& ctrl
                                                              afw::table::Schema& schema,
                                                              daf::base::PropertySet& metadata)
         : ApertureFluxAlgorithm(ctrl, name, schema, metadata) {
+    if (!ctrl.sincFftwWisdom.empty()) {
+        SincCoeffs<float>::requireFftwPlanning(ctrl.sincFftwWisdom);
+    }
+    if (!ctrl.sincCoeffsStore.empty()) {
+        SincCoeffs<float>::requireStore(SincCoeffsStore::get(ctrl.sincCoeffsStore));
+    }
     for (std::size_t i = 0; i < ctrl.radii.size(); ++i) {
         if (ctrl.radii[i] > ctrl.maxSincRadius) break;
         SincCoeffs<float>::cache(0.0, ctrl.radii[i]);
     }
+    std::vector<double> sincRadii;
+    for (std::size_t i = 0; i < ctrl.radii.size(); ++i) {
+        if (ctrl.radii[i] <= ctrl.maxSincRadius) {
+            _sincIndices.push_back(i);
+            sincRadii.push_back(ctrl.radii[i]);
+        }
+    }
+    _sincCoeffs = std::make_shared<SincCoeffsStack<float>>(sincRadii, ctrl);
 }
 
 void CircularApertureFluxAlgorithm::measure(afw::table::SourceRecord& measRecord,
                                             afw::image::Exposure<float> const& exposure) const {
-    afw::geom::ellipses::Ellipse ellipse(afw::geom::ellipses::Axes(1.0, 1.0, 0.0));
-    PTR(afw::geom::ellipses::Axes)
-    axes = std::static_pointer_cast<afw::geom::ellipses::Axes>(ellipse.getCorePtr());
+    geom::Point2D center;
+    std::vector<std::size_t> naiveIndices;
+    std::vector<double> naiveRadii;
     for (std::size_t i = 0; i < _ctrl.radii.size(); ++i) {
         // Each call to _centroidExtractor within this loop goes through exactly the same error-checking
         // logic and returns the same result, but it's not expensive logic, so we just call it repeatedly
         // instead of coming up with a new interface that would allow us to move it outside the loop.
-        ellipse.setCenter(_centroidExtractor(measRecord, getFlagHandler(i)));
-        axes->setA(_ctrl.radii[i]);
-        axes->setB(_ctrl.radii[i]);
-        ApertureFluxAlgorithm::Result result = computeFlux(exposure.getMaskedImage(), ellipse, _ctrl);
-        copyResultToRecord(result, measRecord, i);
+        center = _centroidExtractor(measRecord, getFlagHandler(i));
+        if (_ctrl.radii[i] > _ctrl.maxSincRadius) {
+            // measured below, in one pass over the pixels for all the naive apertures
+            naiveIndices.push_back(i);
+            naiveRadii.push_back(_ctrl.radii[i]);
+        }
+    }
+    if (!_sincIndices.empty()) {
+        std::vector<ApertureFluxAlgorithm::Result> results =
+                computeSincFluxes(exposure.getMaskedImage(), center, *_sincCoeffs, _ctrl);
+        for (std::size_t j = 0; j < _sincIndices.size(); ++j) {
+            copyResultToRecord(results[j], measRecord, _sincIndices[j]);
+        }
+    }
+    if (!naiveIndices.empty()) {
+        std::vector<ApertureFluxAlgorithm::Result> results =
+                computeNaiveFluxes(exposure.getMaskedImage(), center, naiveRadii);
+        for (std::size_t j = 0; j < naiveIndices.size(); ++j) {
+            copyResultToRecord(results[j], measRecord, naiveIndices[j]);
+        }
     }
 }
 
@@ -55,8 +55,9 @@ void GaussianFluxAlgorithm::measure(afw::table::SourceRecord& measRecord,
     geom::Point2D centroid = _centroidExtractor(measRecord, _flagHandler);
     afw::geom::ellipses::Quadrupole shape = _shapeExtractor(measRecord, _flagHandler);
 
-    FluxResult result =
-            SdssShapeAlgorithm::computeFixedMomentsFlux(exposure.getMaskedImage(), shape, centroid);
+    // If base_SdssShape measured this source with these weights its sums are reused
+    FluxResult result = SdssShapeAlgorithm::computeFixedMomentsFlux(exposure.getMaskedImage(), shape,
+                                                                    centroid, measRecord.getId());
 
     measRecord.set(_instFluxResultKey, result);
     _flagHandler.setValue(measRecord, FAILURE.number, false);
@@ -0,0 +1,96 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2019 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#ifndef LSST_MEAS_BASE_LanczosShift_h_INCLUDED
+#define LSST_MEAS_BASE_LanczosShift_h_INCLUDED
+
+/*
+ * Private header: the kernels with which afw::math::offsetImage shifts an image by a fraction of a pixel.
+ *
+ * offsetImage convolves the image with a separable Lanczos warping kernel.  Applying exactly the same
+ * convolution on the fly, a row at a time, lets ApertureFlux.cc and PsfFlux.cc shift sinc coefficients
+ * and PSF models without allocating a shifted image for each source.
+ */
+
+#include <array>
+#include <cmath>
+#include <string>
+
+#include "lsst/geom/Angle.h"
+
+namespace lsst {
+namespace meas {
+namespace base {
+namespace detail {
+
+int const MAX_LANCZOS_ORDER = 10;
+
+/// The shift of one axis of an image: an integer offset of its origin, and a kernel applied to each pixel
+struct LanczosShift {
+    int offset;  ///< shift of the origin of the image
+    int ctr;     ///< index of the kernel value applied to the pixel being shifted
+    int size;    ///< number of kernel values
+    std::array<double, 2 * MAX_LANCZOS_ORDER> values;
+
+    /// Is pixel i of an image of size n convolved?  Otherwise it's copied, as afw does at the edges.
+    bool isConvolved(int i, int n) const { return i >= ctr && i - ctr + size <= n; }
+};
+
+/// Return the order of a Lanczos warping kernel, or 0 if the kernel isn't one
+inline int getLanczosOrder(std::string const &name) {
+    std::string const prefix = "lanczos";
+    if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+        name.find_first_not_of("0123456789", prefix.size()) != std::string::npos) {
+        return 0;
+    }
+    int const order = std::stoi(name.substr(prefix.size()));
+    return (order <= MAX_LANCZOS_ORDER) ? order : 0;
+}
+
+/// Set the kernel that afw::math::offsetImage uses to shift an axis by a fraction `frac` of a pixel
+inline void setLanczosShift(int order, int offset, double frac, LanczosShift &shift) {
+    // afw passes -frac to the kernel, and moves its center when that is negative to keep the largest
+    // values in the middle (see afw::math::offsetImage)
+    double const param = -frac;
+    shift.offset = offset;
+    shift.ctr = (param < 0) ? order : order - 1;
+    shift.size = 2 * order;
+    double sum = 0.0;
+    for (int i = 0; i < shift.size; ++i) {
+        // afw::math::LanczosFunction1
+        double const arg1 = (i - shift.ctr - param) * geom::PI;
+        double const arg2 = arg1 / order;
+        shift.values[i] = (std::fabs(arg1) > 1.0e-5) ? std::sin(arg1) * std::sin(arg2) / (arg1 * arg2) : 1.0;
+        sum += shift.values[i];
+    }
+    for (int i = 0; i < shift.size; ++i) {
+        shift.values[i] /= sum;
+    }
+}
+
+}  // namespace detail
+}  // namespace base
+}  // namespace meas
+}  // namespace lsst
+
+#endif  // !LSST_MEAS_BASE_LanczosShift_h_INCLUDED
@@ -67,7 +67,10 @@ void LocalBackgroundAlgorithm::measure(afw::table::SourceRecord& measRecord,
     if (!psf) {
         throw LSST_EXCEPT(MeasurementError, NO_PSF.doc, NO_PSF.number);
     }
-    float const psfSigma = psf->computeShape().getDeterminantRadius();
+    if (!_psfCache || _psfCache->getPsf() != psf || _psfCache->getBBox() != exposure.getBBox()) {
+        _psfCache = PsfCache::get(psf, exposure.getBBox());
+    }
+    float const psfSigma = _psfCache->computeShape().getDeterminantRadius();
 
     float const innerRadius = _ctrl.annulusInner * psfSigma;
     afw::geom::ellipses::Axes const innerCircle{innerRadius, innerRadius};
@@ -73,8 +73,10 @@ public:
         BICKERTON          ///< Weight \<r^2> by I^2 to avoid negative instFluxes
     };
 
-    PsfAttributes(CONST_PTR(afw::detection::Psf) psf, int const iX, int const iY);
-    PsfAttributes(CONST_PTR(afw::detection::Psf) psf, geom::Point2I const &cen);
+    PsfAttributes(PsfCache const &psfCache, int const iX, int const iY, int const gridSpacing,
+                  double const tolerance);
+    PsfAttributes(PsfCache const &psfCache, geom::Point2I const &cen, int const gridSpacing,
+                  double const tolerance);
 
     double computeGaussianWidth(Method how = ADAPTIVE_MOMENT) const;
     double computeEffectiveArea() const;
@@ -86,23 +88,27 @@ private:
 /**
  * @brief Constructor for PsfAttributes
  */
-PsfAttributes::PsfAttributes(CONST_PTR(afw::detection::Psf) psf,  ///< The psf whose attributes we want
+PsfAttributes::PsfAttributes(PsfCache const &psfCache,  ///< The cached psf whose attributes we want
                              int const iX,  ///< the x position in the frame we want the attributes at
-                             int const iY   ///< the y position in the frame we want the attributes at
+                             int const iY,  ///< the y position in the frame we want the attributes at
+                             int const gridSpacing,  ///< spacing of the PsfCache grid; 0 for the exact psf
+                             double const tolerance  ///< tolerance of the PsfCache grid
                              ) {
     // N.b. (iX, iY) are ints so that we know this image is centered in the central pixel of _psfImage
-    _psfImage = psf->computeImage(geom::PointD(iX, iY));
+    _psfImage = psfCache.computeImage(geom::PointD(iX, iY), gridSpacing, tolerance);
 }
 
 /**
  * @brief Constructor for PsfAttributes
  */
 PsfAttributes::PsfAttributes(
-        CONST_PTR(afw::detection::Psf) psf,  ///< The psf whose attributes we want
-        geom::Point2I const &cen             ///< the position in the frame we want the attributes at
+        PsfCache const &psfCache,  ///< The cached psf whose attributes we want
+        geom::Point2I const &cen,  ///< the position in the frame we want the attributes at
+        int const gridSpacing,     ///< spacing of the PsfCache grid; 0 for the exact psf
+        double const tolerance     ///< tolerance of the PsfCache grid
         )
         :  // N.b. cen is a PointI so that we know this image is centered in the central pixel of _psfImage
-          _psfImage(psf->computeImage(geom::PointD(cen))) {}
+          _psfImage(psfCache.computeImage(geom::PointD(cen), gridSpacing, tolerance)) {}
 
 /**
  * @brief Compute the effective area of the psf ( sum(I)^2/sum(I^2) )
@@ -207,6 +213,9 @@ void PeakLikelihoodFluxAlgorithm::measure(afw::table::SourceRecord &measRecord,
         throw LSST_EXCEPT(pex::exceptions::InvalidParameterError, "exposure has no PSF");
     }
     PTR(afw::detection::Psf const) psfPtr = exposure.getPsf();
+    if (!_psfCache || _psfCache->getPsf() != psfPtr || _psfCache->getBBox() != exposure.getBBox()) {
+        _psfCache = PsfCache::get(psfPtr, exposure.getBBox());
+    }
     if (!geom::Box2D(mimage.getBBox()).contains(center)) {
         std::ostringstream os;
         os << "Center = " << center << " not in exposure bbox" << mimage.getBBox();
@@ -223,7 +232,7 @@ void PeakLikelihoodFluxAlgorithm::measure(afw::table::SourceRecord &measRecord,
                             afw::image::indexToPosition(ctrPixParentInd[1]));
 
     // compute weight = 1/sum(PSF^2) for PSF at ctrPix, where PSF is normalized to a sum of 1
-    PsfAttributes psfAttr(psfPtr, ctrPixParentInd);
+    PsfAttributes psfAttr(*_psfCache, ctrPixParentInd, _ctrl.psfCacheSpacing, _ctrl.psfCacheTolerance);
     double weight = psfAttr.computeEffectiveArea();
 
     /*
@@ -0,0 +1,273 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2019 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/meas/base/PsfCache.h"
+
+namespace lsst {
+namespace meas {
+namespace base {
+namespace {
+
+// The caches in use, so that algorithms measuring the same exposure can share them
+std::mutex registryMutex;
+std::vector<std::weak_ptr<PsfCache>> registry;
+
+}  // namespace
+
+std::shared_ptr<PsfCache> PsfCache::get(std::shared_ptr<afw::detection::Psf const> const& psf,
+                                        geom::Box2I const& bbox) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.erase(std::remove_if(registry.begin(), registry.end(),
+                                  [](std::weak_ptr<PsfCache> const& entry) { return entry.expired(); }),
+                   registry.end());
+    for (auto const& entry : registry) {
+        std::shared_ptr<PsfCache> cache = entry.lock();
+        if (cache && cache->_psf == psf && cache->_bbox == bbox) {
+            return cache;
+        }
+    }
+    auto cache = std::make_shared<PsfCache>(psf, bbox);
+    registry.push_back(cache);
+    return cache;
+}
+
+PsfCache::PsfCache(std::shared_ptr<afw::detection::Psf const> const& psf, geom::Box2I const& bbox)
+        : _psf(psf), _bbox(bbox) {
+    if (!psf) {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError, "PsfCache requires a PSF model");
+    }
+}
+
+PsfCache::Grid& PsfCache::_getGrid(int gridSpacing) const {
+    auto iter = _grids.find(gridSpacing);
+    if (iter != _grids.end()) {
+        return iter->second;
+    }
+    // Nodes lie on the first and last pixels of the image, at most gridSpacing apart
+    Grid grid;
+    int const width = _bbox.getWidth() - 1;
+    int const height = _bbox.getHeight() - 1;
+    grid.nx = (width > 0) ? std::max(2, (width + gridSpacing - 1) / gridSpacing + 1) : 1;
+    grid.ny = (height > 0) ? std::max(2, (height + gridSpacing - 1) / gridSpacing + 1) : 1;
+    grid.dx = (grid.nx > 1) ? static_cast<double>(width) / (grid.nx - 1) : 1.0;
+    grid.dy = (grid.ny > 1) ? static_cast<double>(height) / (grid.ny - 1) : 1.0;
+    grid.nodes.resize(grid.nx * grid.ny);
+    grid.imageSpreads.assign(std::max(grid.nx - 1, 1) * std::max(grid.ny - 1, 1), -1.0);
+    return _grids.emplace(gridSpacing, std::move(grid)).first->second;
+}
+
+PsfCache::Node& PsfCache::_getNode(Grid& grid, int ix, int iy) const {
+    Node& node = grid.nodes[iy * grid.nx + ix];
+    if (!node.computed) {
+        node.computed = true;
+        node.position = geom::Point2D(_bbox.getMinX() + ix * grid.dx, _bbox.getMinY() + iy * grid.dy);
+        ++_statistics.evaluations;
+        try {
+            node.shape = _psf->computeShape(node.position);
+            node.valid = true;
+        } catch (pex::exceptions::Exception& err) {
+            node.valid = false;
+        }
+    }
+    return node;
+}
+
+std::shared_ptr<PsfCache::Image const> PsfCache::_getKernelImage(Node& node) const {
+    if (!node.kernelImage) {
+        node.kernelImage = _psf->computeKernelImage(node.position);
+    }
+    return node.kernelImage;
+}
+
+double PsfCache::_getImageSpread(Grid& grid, int ix, int iy, Node* const corners[4]) const {
+    double& spread = grid.imageSpreads[iy * std::max(grid.nx - 1, 1) + ix];
+    if (spread >= 0) {
+        return spread;
+    }
+    spread = HUGE_VAL;
+    std::shared_ptr<Image const> images[4];
+    try {
+        for (int i = 0; i < 4; ++i) {
+            images[i] = _getKernelImage(*corners[i]);
+        }
+    } catch (pex::exceptions::Exception&) {
+        return spread;
+    }
+    for (int i = 1; i < 4; ++i) {
+        if (images[i]->getBBox() != images[0]->getBBox()) {
+            return spread;
+        }
+    }
+    double peak = 0.0;
+    double difference = 0.0;
+    for (int y = 0; y < images[0]->getHeight(); ++y) {
+        Image::const_x_iterator rows[4] = {images[0]->row_begin(y), images[1]->row_begin(y),
+                                           images[2]->row_begin(y), images[3]->row_begin(y)};
+        for (int x = 0; x < images[0]->getWidth(); ++x) {
+            double minValue = rows[0][x];
+            double maxValue = rows[0][x];
+            for (int i = 1; i < 4; ++i) {
+                minValue = std::min(minValue, static_cast<double>(rows[i][x]));
+                maxValue = std::max(maxValue, static_cast<double>(rows[i][x]));
+            }
+            peak = std::max(peak, std::max(std::abs(minValue), std::abs(maxValue)));
+            difference = std::max(difference, maxValue - minValue);
+        }
+    }
+    if (peak > 0) {
+        spread = difference / peak;
+    }
+    return spread;
+}
+
+PsfCache::Node* PsfCache::_lookup(geom::Point2D const& position, int gridSpacing, double tolerance,
+                                  bool checkImages, Shape* shape) const {
+    double const u = position.getX() - _bbox.getMinX();
+    double const v = position.getY() - _bbox.getMinY();
+    bool const onImage = u >= 0 && u <= _bbox.getWidth() - 1 && v >= 0 && v <= _bbox.getHeight() - 1;
+    if (gridSpacing <= 0 || !onImage) {
+        ++_statistics.fallbacks;
+        return nullptr;
+    }
+
+    Grid& grid = _getGrid(gridSpacing);
+    int const ix = std::min(static_cast<int>(u / grid.dx), std::max(grid.nx - 2, 0));
+    int const iy = std::min(static_cast<int>(v / grid.dy), std::max(grid.ny - 2, 0));
+    double const fx = (grid.nx > 1) ? u / grid.dx - ix : 0.0;
+    double const fy = (grid.ny > 1) ? v / grid.dy - iy : 0.0;
+    int const ix1 = std::min(ix + 1, grid.nx - 1);
+    int const iy1 = std::min(iy + 1, grid.ny - 1);
+
+    Node* corners[4] = {&_getNode(grid, ix, iy), &_getNode(grid, ix1, iy), &_getNode(grid, ix, iy1),
+                        &_getNode(grid, ix1, iy1)};
+    double const weights[4] = {(1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy};
+
+    double ixx = 0, iyy = 0, ixy = 0;
+    double minIxx = HUGE_VAL, maxIxx = -HUGE_VAL;
+    double minIyy = HUGE_VAL, maxIyy = -HUGE_VAL;
+    double minIxy = HUGE_VAL, maxIxy = -HUGE_VAL;
+    for (int i = 0; i < 4; ++i) {
+        if (!corners[i]->valid) {
+            ++_statistics.fallbacks;
+            return nullptr;
+        }
+        Shape const& corner = corners[i]->shape;
+        ixx += weights[i] * corner.getIxx();
+        iyy += weights[i] * corner.getIyy();
+        ixy += weights[i] * corner.getIxy();
+        minIxx = std::min(minIxx, corner.getIxx());
+        maxIxx = std::max(maxIxx, corner.getIxx());
+        minIyy = std::min(minIyy, corner.getIyy());
+        maxIyy = std::max(maxIyy, corner.getIyy());
+        minIxy = std::min(minIxy, corner.getIxy());
+        maxIxy = std::max(maxIxy, corner.getIxy());
+    }
+    // The interpolated moments lie within the range of the corners, which bounds their error where the
+    // moments vary monotonically across the cell
+    double const spread = std::max(std::max(maxIxx - minIxx, maxIyy - minIyy), maxIxy - minIxy);
+    double const trace = 0.5 * (minIxx + maxIxx + minIyy + maxIyy);
+    if (!(spread <= tolerance * trace)) {
+        ++_statistics.fallbacks;
+        return nullptr;
+    }
+    // The wings, asymmetry or centroid of the model can vary while its moments don't, so the nearest
+    // node's kernel image is only used if those of all the corners agree pixel by pixel
+    if (checkImages && !(_getImageSpread(grid, ix, iy, corners) <= tolerance)) {
+        ++_statistics.fallbacks;
+        return nullptr;
+    }
+    ++_statistics.hits;
+    if (shape) {
+        *shape = Shape(ixx, iyy, ixy);
+    }
+    return corners[(fy < 0.5 ? 0 : 2) + (fx < 0.5 ? 0 : 1)];
+}
+
+PsfCache::Shape PsfCache::computeShape(geom::Point2D const& position, int gridSpacing,
+                                       double tolerance) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Shape shape;
+    if (!_lookup(position, gridSpacing, tolerance, false, &shape)) {
+        return _psf->computeShape(position);
+    }
+    return shape;
+}
+
+std::shared_ptr<PsfCache::Image> PsfCache::computeImage(geom::Point2D const& position, int gridSpacing,
+                                                       double tolerance) const {
+    std::shared_ptr<Image const> kernelImage;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Node* node = _lookup(position, gridSpacing, tolerance, true, nullptr);
+        if (!node) {
+            return _psf->computeImage(position);
+        }
+        kernelImage = _getKernelImage(*node);
+    }
+    // recenterKernelImage may move the image it's given, so give it a copy
+    return afw::detection::Psf::recenterKernelImage(std::make_shared<Image>(*kernelImage, true), position);
+}
+
+std::shared_ptr<PsfCache::Image const> PsfCache::computeKernelImage(geom::Point2D const& position,
+                                                                   int gridSpacing, double tolerance) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Node* node = _lookup(position, gridSpacing, tolerance, true, nullptr);
+    if (!node) {
+        return _psf->computeKernelImage(position);
+    }
+    return _getKernelImage(*node);
+}
+
+std::shared_ptr<afw::math::Kernel const> PsfCache::getLocalKernel(geom::Point2D const& position,
+                                                                 int gridSpacing, double tolerance) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Node* node = _lookup(position, gridSpacing, tolerance, true, nullptr);
+    if (!node) {
+        return _psf->getLocalKernel(position);
+    }
+    if (!node->kernel) {
+        node->kernel = _psf->getLocalKernel(node->position);
+    }
+    return node->kernel;
+}
+
+PsfCache::Statistics PsfCache::getStatistics() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _statistics;
+}
+
+PsfCache::Shape PsfCache::computeShape() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_averageShape) {
+        _averageShape.reset(new Shape(_psf->computeShape()));
+    }
+    return *_averageShape;
+}
+
+}  // namespace base
+}  // namespace meas
+}  // namespace lsst
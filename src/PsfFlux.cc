@@ -22,16 +22,22 @@
  * see <http://www.lsstcorp.org/LegalNotices/>.
  */
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <map>
+#include <numeric>
+#include <vector>
 
-#include "ndarray/eigen.h"
+#include "Eigen/Cholesky"
 
 #include "lsst/afw/table/Source.h"
 #include "lsst/afw/detection/Psf.h"
+#include "lsst/afw/image/ImageUtils.h"
 #include "lsst/log/Log.h"
-#include "lsst/afw/geom/SpanSet.h"
+#include "lsst/pex/exceptions.h"
 #include "lsst/meas/base/PsfFlux.h"
+#include "LanczosShift.h"
 
 namespace lsst {
 namespace meas {
@@ -48,7 +54,332 @@ FlagDefinition const PsfFluxAlgorithm::EDGE = flagDefinitions.add(
 
 FlagDefinitionList const& PsfFluxAlgorithm::getFlagDefinitions() { return flagDefinitions; }
 
-namespace {}  // namespace
+namespace {
+
+// The sums over the unmasked pixels of a fit region from which a PSF flux and its error are computed
+struct PsfFitSums {
+    PsfFitSums() : area(0), modelData(0.0), modelSquared(0.0), modelSquaredVariance(0.0), model(0.0) {}
+
+    std::size_t area;             // number of pixels summed
+    double modelData;             // sum(model*data)
+    double modelSquared;          // sum(model^2)
+    double modelSquaredVariance;  // sum(model^2*variance)
+    double model;                 // sum(model)
+};
+
+// Accumulate the sums over the pixels of fitBBox with none of badBits set, walking the rows of the model
+// and the image directly rather than flattening them over a SpanSet
+template <typename PixelT>
+PsfFitSums sumPsfFit(afw::detection::Psf::Image const& model, afw::image::MaskedImage<PixelT> const& mimage,
+                     geom::Box2I const& fitBBox, afw::image::MaskPixel badBits) {
+    typedef afw::detection::Psf::Pixel PsfPixel;
+    auto modelArray = model.getArray();
+    auto imageArray = mimage.getImage()->getArray();
+    auto varianceArray = mimage.getVariance()->getArray();
+    auto maskArray = mimage.getMask()->getArray();
+    int const width = fitBBox.getWidth();
+    PsfFitSums sums;
+    int const modelOffset = fitBBox.getMinX() - model.getX0();
+    int const offset = fitBBox.getMinX() - mimage.getX0();
+    for (int y = fitBBox.getMinY(); y <= fitBBox.getMaxY(); ++y) {
+        PsfPixel const* modelRow = modelArray[y - model.getY0()].getData() + modelOffset;
+        PixelT const* imageRow = imageArray[y - mimage.getY0()].getData() + offset;
+        afw::image::VariancePixel const* varianceRow = varianceArray[y - mimage.getY0()].getData() + offset;
+        afw::image::MaskPixel const* maskRow = maskArray[y - mimage.getY0()].getData() + offset;
+        for (int x = 0; x < width; ++x) {
+            if (maskRow[x] & badBits) {
+                continue;
+            }
+            PsfPixel const m = modelRow[x];
+            PsfPixel const m2 = m * m;
+            sums.modelData += m * static_cast<PsfPixel>(imageRow[x]);
+            sums.modelSquared += m2;
+            sums.modelSquaredVariance += m2 * static_cast<PsfPixel>(varianceRow[x]);
+            sums.model += m;
+            ++sums.area;
+        }
+    }
+    return sums;
+}
+
+// Return sum(model1*model2) and sum(model1*model2*variance) over the pixels of bbox (which both models
+// must contain) with none of badBits set
+template <typename PixelT>
+std::pair<double, double> sumPsfOverlap(afw::detection::Psf::Image const& model1,
+                                        afw::detection::Psf::Image const& model2,
+                                        afw::image::MaskedImage<PixelT> const& mimage,
+                                        geom::Box2I const& bbox, afw::image::MaskPixel badBits) {
+    typedef afw::detection::Psf::Pixel PsfPixel;
+    auto model1Array = model1.getArray();
+    auto model2Array = model2.getArray();
+    auto varianceArray = mimage.getVariance()->getArray();
+    auto maskArray = mimage.getMask()->getArray();
+    int const width = bbox.getWidth();
+    int const model1Offset = bbox.getMinX() - model1.getX0();
+    int const model2Offset = bbox.getMinX() - model2.getX0();
+    int const offset = bbox.getMinX() - mimage.getX0();
+    double modelModel = 0.0;
+    double modelModelVariance = 0.0;
+    for (int y = bbox.getMinY(); y <= bbox.getMaxY(); ++y) {
+        PsfPixel const* model1Row = model1Array[y - model1.getY0()].getData() + model1Offset;
+        PsfPixel const* model2Row = model2Array[y - model2.getY0()].getData() + model2Offset;
+        afw::image::VariancePixel const* varianceRow = varianceArray[y - mimage.getY0()].getData() + offset;
+        afw::image::MaskPixel const* maskRow = maskArray[y - mimage.getY0()].getData() + offset;
+        for (int x = 0; x < width; ++x) {
+            if (maskRow[x] & badBits) {
+                continue;
+            }
+            PsfPixel const mm = model1Row[x] * model2Row[x];
+            modelModel += mm;
+            modelModelVariance += mm * static_cast<PsfPixel>(varianceRow[x]);
+        }
+    }
+    return std::make_pair(modelModel, modelModelVariance);
+}
+
+afw::image::MaskPixel getBadBits(std::vector<std::string> const& badMaskPlanes,
+                                 afw::image::Mask<afw::image::MaskPixel> const& mask) {
+    afw::image::MaskPixel badBits = 0x0;
+    for (std::vector<std::string>::const_iterator i = badMaskPlanes.begin(); i != badMaskPlanes.end(); ++i) {
+        badBits |= mask.getPlaneBitMask(*i);
+    }
+    return badBits;
+}
+
+// Set the results of a fit from its sums, throwing as PsfFluxAlgorithm::measure does if there are none
+void setPsfFitResult(afw::table::SourceRecord& record, PsfFitSums const& sums,
+                     FluxResultKey const& instFluxResultKey, afw::table::Key<float> const& areaKey) {
+    if (sums.area == 0) {
+        throw LSST_EXCEPT(MeasurementError, PsfFluxAlgorithm::NO_GOOD_PIXELS.doc,
+                          PsfFluxAlgorithm::NO_GOOD_PIXELS.number);
+    }
+    double const alpha = sums.modelSquared;
+    FluxResult result;
+    result.instFlux = sums.modelData / alpha;
+    // If we're not using per-pixel weights to compute the instFlux, we'll still want to compute the
+    // variance as if we had, so we'll apply the weights to the model now, and update alpha.
+    result.instFluxErr = std::sqrt(sums.modelSquaredVariance) / alpha;
+    record.set(areaKey, sums.model / alpha);
+    if (!std::isfinite(result.instFlux) || !std::isfinite(result.instFluxErr)) {
+        throw LSST_EXCEPT(PixelValueError, "Invalid pixel value detected in image.");
+    }
+    record.set(instFluxResultKey, result);
+}
+
+// The smallest pivot of the normal matrix of PsfFluxAlgorithm::measureN, relative to the corresponding
+// diagonal element, for which a source's model is considered independent of those of the others
+double const PIVOT_TOLERANCE = 1E-8;
+
+// The number of sources PsfFluxAlgorithm::measureBatch fits at once: a vector of doubles on AVX-512
+int const BATCH_LANES = 8;
+
+// Copy the pixels of fitBBox in the model, image and variance of one source to one lane of the batch
+// buffers (pixel p of lane l is at [p*BATCH_LANES + l]), in the order sumPsfFit visits them, with zeros for
+// masked pixels; return the number of unmasked pixels
+template <typename PixelT>
+std::size_t gatherPsfFit(afw::detection::Psf::Image const& model,
+                         afw::image::MaskedImage<PixelT> const& mimage, geom::Box2I const& fitBBox,
+                         afw::image::MaskPixel badBits, int lane, double* modelLanes,
+                         double* dataLanes, double* varianceLanes) {
+    typedef afw::detection::Psf::Pixel PsfPixel;
+    auto modelArray = model.getArray();
+    auto imageArray = mimage.getImage()->getArray();
+    auto varianceArray = mimage.getVariance()->getArray();
+    auto maskArray = mimage.getMask()->getArray();
+    int const width = fitBBox.getWidth();
+    int const modelOffset = fitBBox.getMinX() - model.getX0();
+    int const offset = fitBBox.getMinX() - mimage.getX0();
+    std::size_t area = 0;
+    std::size_t p = lane;
+    for (int y = fitBBox.getMinY(); y <= fitBBox.getMaxY(); ++y) {
+        PsfPixel const* modelRow = modelArray[y - model.getY0()].getData() + modelOffset;
+        PixelT const* imageRow = imageArray[y - mimage.getY0()].getData() + offset;
+        afw::image::VariancePixel const* varianceRow = varianceArray[y - mimage.getY0()].getData() + offset;
+        afw::image::MaskPixel const* maskRow = maskArray[y - mimage.getY0()].getData() + offset;
+        for (int x = 0; x < width; ++x, p += BATCH_LANES) {
+            if (maskRow[x] & badBits) {
+                modelLanes[p] = dataLanes[p] = varianceLanes[p] = 0.0;
+                continue;
+            }
+            modelLanes[p] = modelRow[x];
+            dataLanes[p] = static_cast<PsfPixel>(imageRow[x]);
+            varianceLanes[p] = static_cast<PsfPixel>(varianceRow[x]);
+            ++area;
+        }
+    }
+    return area;
+}
+
+// Accumulate the sums of BATCH_LANES gathered sources (all but the areas), a source per vector lane.  Each
+// lane makes the same operations on its source's pixels, in the same order, as sumPsfFit, and a masked
+// pixel adds exact zeros, so the sums are identical.
+void sumPsfFitLanes(double const* modelLanes, double const* dataLanes, double const* varianceLanes,
+                    std::size_t nPixels, PsfFitSums* sums) {
+    alignas(64) double modelData[BATCH_LANES] = {};
+    alignas(64) double modelSquared[BATCH_LANES] = {};
+    alignas(64) double modelSquaredVariance[BATCH_LANES] = {};
+    alignas(64) double modelSum[BATCH_LANES] = {};
+    for (std::size_t p = 0; p < nPixels; ++p) {
+        double const* m = modelLanes + p * BATCH_LANES;
+        double const* d = dataLanes + p * BATCH_LANES;
+        double const* v = varianceLanes + p * BATCH_LANES;
+        for (int lane = 0; lane < BATCH_LANES; ++lane) {
+            double const m2 = m[lane] * m[lane];
+            modelData[lane] += m[lane] * d[lane];
+            modelSquared[lane] += m2;
+            modelSquaredVariance[lane] += m2 * v[lane];
+            modelSum[lane] += m[lane];
+        }
+    }
+    for (int lane = 0; lane < BATCH_LANES; ++lane) {
+        sums[lane].modelData = modelData[lane];
+        sums[lane].modelSquared = modelSquared[lane];
+        sums[lane].modelSquaredVariance = modelSquaredVariance[lane];
+        sums[lane].model = modelSum[lane];
+    }
+}
+
+// The warping kernel with which Psf::computeImage recenters kernel images (see Psf::recenterKernelImage)
+std::string const RECENTER_KERNEL = "lanczos5";
+
+// The size of the tiles in which computeFluxes groups positions
+int const TILE_SIZE = 64;
+
+// Shift a kernel image (centered on the origin) to a position, as Psf::recenterKernelImage does, into
+// model (which must have the same dimensions).  Psf::recenterKernelImage pads the image with enough zeros
+// for every pixel to be convolved, so there's no copying of edge pixels to emulate.
+void recenterKernelImage(afw::detection::Psf::Image const& kernelImage, geom::Point2D const& position,
+                         std::vector<double>& scratch, afw::detection::Psf::Image& model) {
+    std::pair<int, double> const irX = afw::image::positionToIndex(position.getX(), true);
+    std::pair<int, double> const irY = afw::image::positionToIndex(position.getY(), true);
+    model.setXY0(kernelImage.getX0() + irX.first, kernelImage.getY0() + irY.first);
+    if (irX.second == 0.0 && irY.second == 0.0) {
+        model.assign(kernelImage);
+        return;
+    }
+    // offsetImage takes the shift in single precision
+    int const order = detail::getLanczosOrder(RECENTER_KERNEL);
+    detail::LanczosShift xShift, yShift;
+    detail::setLanczosShift(order, 0, static_cast<float>(irX.second), xShift);
+    detail::setLanczosShift(order, 0, static_cast<float>(irY.second), yShift);
+
+    int const width = kernelImage.getWidth();
+    int const height = kernelImage.getHeight();
+    auto kernelArray = kernelImage.getArray();
+    auto modelArray = model.getArray();
+    scratch.resize(width);
+    for (int y = 0; y < height; ++y) {
+        // convolve the columns, then the row
+        std::fill(scratch.begin(), scratch.end(), 0.0);
+        for (int j = std::max(0, yShift.ctr - y); j < yShift.size && y - yShift.ctr + j < height; ++j) {
+            double const* kernelRow = kernelArray[y - yShift.ctr + j].getData();
+            double const weight = yShift.values[j];
+            for (int x = 0; x < width; ++x) {
+                scratch[x] += weight * kernelRow[x];
+            }
+        }
+        double* modelRow = modelArray[y].getData();
+        for (int x = 0; x < width; ++x) {
+            double value = 0.0;
+            for (int i = std::max(0, xShift.ctr - x); i < xShift.size && x - xShift.ctr + i < width; ++i) {
+                value += xShift.values[i] * scratch[x - xShift.ctr + i];
+            }
+            modelRow[x] = value;
+        }
+    }
+}
+
+}  // namespace
+
+std::vector<PsfFluxAlgorithm::Result> PsfFluxAlgorithm::computeFluxes(
+        afw::image::MaskedImage<float> const& image, afw::math::Kernel const& kernel,
+        std::vector<geom::Point2D> const& positions, Control const& ctrl) {
+    afw::image::MaskPixel const badBits = getBadBits(ctrl.badMaskPlanes, *image.getMask());
+    geom::Box2I const bbox = image.getBBox();
+
+    // The basis images of a linear combination, which are the same everywhere
+    auto const* combination = dynamic_cast<afw::math::LinearCombinationKernel const*>(&kernel);
+    std::vector<afw::detection::Psf::Image> basis;
+    std::vector<double> coeffs;
+    std::vector<afw::math::Kernel::SpatialFunctionPtr> spatialFunctions;
+    if (combination) {
+        for (auto const& basisKernel : combination->getKernelList()) {
+            basis.emplace_back(kernel.getDimensions());
+            basisKernel->computeImage(basis.back(), false);
+        }
+        coeffs = combination->getKernelParameters();
+        if (combination->isSpatiallyVarying()) {
+            spatialFunctions = combination->getSpatialFunctionList();
+        }
+    }
+
+    // Visit the positions a tile of the image at a time
+    auto getTile = [&bbox](geom::Point2D const& position) {
+        return std::make_pair(static_cast<int>(std::floor((position.getY() - bbox.getMinY()) / TILE_SIZE)),
+                              static_cast<int>(std::floor((position.getX() - bbox.getMinX()) / TILE_SIZE)));
+    };
+    std::vector<std::size_t> order(positions.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return getTile(positions[a]) < getTile(positions[b]);
+    });
+
+    afw::detection::Psf::Image kernelImage(kernel.getDimensions());
+    kernelImage.setXY0(-kernel.getCtr().getX(), -kernel.getCtr().getY());
+    afw::detection::Psf::Image model(kernel.getDimensions());
+    std::vector<double> scratch;
+    std::vector<Result> results(positions.size());
+    for (std::size_t index : order) {
+        geom::Point2D const& position = positions[index];
+        Result& result = results[index];
+        if (combination) {
+            for (std::size_t k = 0; k < spatialFunctions.size(); ++k) {
+                coeffs[k] = (*spatialFunctions[k])(position.getX(), position.getY());
+            }
+            kernelImage = 0.0;
+            for (std::size_t k = 0; k < basis.size(); ++k) {
+                kernelImage.scaledPlus(coeffs[k], basis[k]);
+            }
+            double sum = 0.0;
+            for (int y = 0; y < kernelImage.getHeight(); ++y) {
+                sum = std::accumulate(kernelImage.row_begin(y), kernelImage.row_end(y), sum);
+            }
+            if (sum == 0.0) {
+                result.setFlag(FAILURE.number);
+                continue;
+            }
+            kernelImage /= sum;
+        } else {
+            try {
+                kernel.computeImage(kernelImage, true, position.getX(), position.getY());
+            } catch (pex::exceptions::Exception&) {
+                result.setFlag(FAILURE.number);
+                continue;
+            }
+        }
+        recenterKernelImage(kernelImage, position, scratch, model);
+
+        geom::Box2I fitBBox = model.getBBox();
+        fitBBox.clip(bbox);
+        if (fitBBox != model.getBBox()) {
+            result.setFlag(FAILURE.number);
+            result.setFlag(EDGE.number);
+        }
+        PsfFitSums const sums = sumPsfFit(model, image, fitBBox, badBits);
+        if (sums.area == 0) {
+            result.setFlag(FAILURE.number);
+            result.setFlag(NO_GOOD_PIXELS.number);
+            continue;
+        }
+        result.instFlux = sums.modelData / sums.modelSquared;
+        result.instFluxErr = std::sqrt(sums.modelSquaredVariance) / sums.modelSquared;
+        result.area = sums.model / sums.modelSquared;
+        if (!std::isfinite(result.instFlux) || !std::isfinite(result.instFluxErr)) {
+            result.setFlag(FAILURE.number);
+        }
+    }
+    return results;
+}
 
 PsfFluxAlgorithm::PsfFluxAlgorithm(Control const& ctrl, std::string const& name, afw::table::Schema& schema,
                                    std::string const& logName)
@@ -68,8 +399,12 @@ void PsfFluxAlgorithm::measure(afw::table::SourceRecord& measRecord,
         LOGL_ERROR(getLogName(), "PsfFlux: no psf attached to exposure");
         throw LSST_EXCEPT(FatalAlgorithmError, "PsfFlux algorithm requires a Psf with every exposure");
     }
+    if (!_psfCache || _psfCache->getPsf() != psf || _psfCache->getBBox() != exposure.getBBox()) {
+        _psfCache = PsfCache::get(psf, exposure.getBBox());
+    }
     geom::Point2D position = _centroidExtractor(measRecord, _flagHandler);
-    PTR(afw::detection::Psf::Image) psfImage = psf->computeImage(position);
+    PTR(afw::detection::Psf::Image) psfImage =
+            _psfCache->computeImage(position, _ctrl.psfCacheSpacing, _ctrl.psfCacheTolerance);
     geom::Box2I fitBBox = psfImage->getBBox();
     fitBBox.clip(exposure.getBBox());
     if (fitBBox != psfImage->getBBox()) {
@@ -77,43 +412,235 @@ void PsfFluxAlgorithm::measure(afw::table::SourceRecord& measRecord,
                               true);  // if we had a suspect flag, we'd set that instead
         _flagHandler.setValue(measRecord, EDGE.number, true);
     }
-    auto fitRegionSpans = std::make_shared<afw::geom::SpanSet>(fitBBox);
-    afw::detection::Footprint fitRegion(fitRegionSpans);
-    if (!_ctrl.badMaskPlanes.empty()) {
-        afw::image::MaskPixel badBits = 0x0;
-        for (std::vector<std::string>::const_iterator i = _ctrl.badMaskPlanes.begin();
-             i != _ctrl.badMaskPlanes.end(); ++i) {
-            badBits |= exposure.getMaskedImage().getMask()->getPlaneBitMask(*i);
+    afw::image::MaskPixel const badBits =
+            getBadBits(_ctrl.badMaskPlanes, *exposure.getMaskedImage().getMask());
+    PsfFitSums const sums = sumPsfFit(*psfImage, exposure.getMaskedImage(), fitBBox, badBits);
+    setPsfFitResult(measRecord, sums, _instFluxResultKey, _areaKey);
+}
+
+void PsfFluxAlgorithm::measureBatch(afw::table::SourceCatalog const& measCat,
+                                    afw::image::Exposure<float> const& exposure) const {
+    PTR(afw::detection::Psf const) psf = exposure.getPsf();
+    if (!psf) {
+        LOGL_ERROR(getLogName(), "PsfFlux: no psf attached to exposure");
+        throw LSST_EXCEPT(FatalAlgorithmError, "PsfFlux algorithm requires a Psf with every exposure");
+    }
+    if (!_psfCache || _psfCache->getPsf() != psf || _psfCache->getBBox() != exposure.getBBox()) {
+        _psfCache = PsfCache::get(psf, exposure.getBBox());
+    }
+    afw::image::MaskedImage<float> const& mimage = exposure.getMaskedImage();
+    afw::image::MaskPixel const badBits = getBadBits(_ctrl.badMaskPlanes, *mimage.getMask());
+
+    // Evaluate the model of each source, and group the sources by the dimensions of their fit regions
+    std::vector<std::shared_ptr<afw::table::SourceRecord>> records;
+    std::vector<PTR(afw::detection::Psf::Image)> models;
+    std::vector<geom::Box2I> fitBBoxes;
+    std::map<std::pair<int, int>, std::vector<std::size_t>> groups;
+    for (std::size_t i = 0; i < measCat.size(); ++i) {
+        std::shared_ptr<afw::table::SourceRecord> record = measCat.get(i);
+        try {
+            geom::Point2D position = _centroidExtractor(*record, _flagHandler);
+            PTR(afw::detection::Psf::Image) psfImage =
+                    _psfCache->computeImage(position, _ctrl.psfCacheSpacing, _ctrl.psfCacheTolerance);
+            geom::Box2I fitBBox = psfImage->getBBox();
+            fitBBox.clip(exposure.getBBox());
+            if (fitBBox != psfImage->getBBox()) {
+                _flagHandler.setValue(*record, FAILURE.number, true);
+                _flagHandler.setValue(*record, EDGE.number, true);
+            }
+            groups[std::make_pair(fitBBox.getWidth(), fitBBox.getHeight())].push_back(records.size());
+            records.push_back(record);
+            models.push_back(psfImage);
+            fitBBoxes.push_back(fitBBox);
+        } catch (FatalAlgorithmError&) {
+            throw;
+        } catch (MeasurementError& error) {
+            fail(*record, &error);
+        } catch (pex::exceptions::Exception&) {
+            // e.g. a Psf that can't be evaluated at this position; as callMeasure fails a single record
+            fail(*record);
         }
-        fitRegion.setSpans(fitRegion.getSpans()
-                                   ->intersectNot(*exposure.getMaskedImage().getMask(), badBits)
-                                   ->clippedTo(exposure.getMaskedImage().getMask()->getBBox()));
     }
-    if (fitRegion.getArea() == 0) {
-        throw LSST_EXCEPT(MeasurementError, NO_GOOD_PIXELS.doc, NO_GOOD_PIXELS.number);
+
+    // Fit BATCH_LANES sources with fit regions of the same dimensions at a time
+    std::vector<double> model, data, variance;
+    PsfFitSums sums[BATCH_LANES];
+    for (auto const& group : groups) {
+        std::size_t const nPixels = static_cast<std::size_t>(group.first.first) * group.first.second;
+        model.assign(nPixels * BATCH_LANES, 0.0);
+        data.assign(nPixels * BATCH_LANES, 0.0);
+        variance.assign(nPixels * BATCH_LANES, 0.0);
+        std::vector<std::size_t> const& members = group.second;
+        for (std::size_t begin = 0; begin < members.size(); begin += BATCH_LANES) {
+            int const nLanes = std::min<std::size_t>(BATCH_LANES, members.size() - begin);
+            for (int lane = 0; lane < nLanes; ++lane) {
+                std::size_t const i = members[begin + lane];
+                sums[lane].area = gatherPsfFit(*models[i], mimage, fitBBoxes[i], badBits, lane, model.data(),
+                                               data.data(), variance.data());
+            }
+            for (int lane = nLanes; lane < BATCH_LANES; ++lane) {
+                for (std::size_t p = 0; p < nPixels; ++p) {
+                    model[p * BATCH_LANES + lane] = 0.0;
+                }
+            }
+            sumPsfFitLanes(model.data(), data.data(), variance.data(), nPixels, sums);
+            for (int lane = 0; lane < nLanes; ++lane) {
+                afw::table::SourceRecord& record = *records[members[begin + lane]];
+                try {
+                    setPsfFitResult(record, sums[lane], _instFluxResultKey, _areaKey);
+                } catch (MeasurementError& error) {
+                    fail(record, &error);
+                } catch (pex::exceptions::Exception&) {
+                    fail(record);
+                }
+            }
+        }
     }
-    typedef afw::detection::Psf::Pixel PsfPixel;
-    // SpanSet::flatten returns a new ndarray::Array, which must stay in scope
-    // while we use an Eigen::Map view of it
-    auto modelNdArray = fitRegion.getSpans()->flatten(psfImage->getArray(), psfImage->getXY0());
-    auto dataNdArray = fitRegion.getSpans()->flatten(exposure.getMaskedImage().getImage()->getArray(),
-                                                     exposure.getXY0());
-    auto varianceNdArray = fitRegion.getSpans()->flatten(exposure.getMaskedImage().getVariance()->getArray(),
-                                                         exposure.getXY0());
-    auto model = ndarray::asEigenMatrix(modelNdArray);
-    auto data = ndarray::asEigenMatrix(dataNdArray);
-    auto variance = ndarray::asEigenMatrix(varianceNdArray);
-    PsfPixel alpha = model.squaredNorm();
-    FluxResult result;
-    result.instFlux = model.dot(data.cast<PsfPixel>()) / alpha;
-    // If we're not using per-pixel weights to compute the instFlux, we'll still want to compute the
-    // variance as if we had, so we'll apply the weights to the model now, and update alpha.
-    result.instFluxErr = std::sqrt(model.array().square().matrix().dot(variance.cast<PsfPixel>())) / alpha;
-    measRecord.set(_areaKey, model.sum() / alpha);
-    if (!std::isfinite(result.instFlux) || !std::isfinite(result.instFluxErr)) {
-        throw LSST_EXCEPT(PixelValueError, "Invalid pixel value detected in image.");
+}
+
+void PsfFluxAlgorithm::measureN(afw::table::SourceCatalog const& measCat,
+                                afw::image::Exposure<float> const& exposure) const {
+    // The framework calls this on every isolated source too; measure() has already fit those on their own
+    if (measCat.size() < 2) {
+        return;
+    }
+    PTR(afw::detection::Psf const) psf = exposure.getPsf();
+    if (!psf) {
+        LOGL_ERROR(getLogName(), "PsfFlux: no psf attached to exposure");
+        throw LSST_EXCEPT(FatalAlgorithmError, "PsfFlux algorithm requires a Psf with every exposure");
+    }
+    if (!_psfCache || _psfCache->getPsf() != psf || _psfCache->getBBox() != exposure.getBBox()) {
+        _psfCache = PsfCache::get(psf, exposure.getBBox());
+    }
+    afw::image::MaskedImage<float> const& mimage = exposure.getMaskedImage();
+    afw::image::MaskPixel const badBits = getBadBits(_ctrl.badMaskPlanes, *mimage.getMask());
+
+    // Evaluate the model of each source, leaving out those that can't be fit at all
+    std::vector<std::shared_ptr<afw::table::SourceRecord>> records;
+    std::vector<PTR(afw::detection::Psf::Image)> models;
+    std::vector<geom::Box2I> fitBBoxes;
+    std::vector<PsfFitSums> sums;
+    for (std::size_t i = 0; i < measCat.size(); ++i) {
+        std::shared_ptr<afw::table::SourceRecord> record = measCat.get(i);
+        // the single-object measurement may have set flags and results we won't; its results are biased
+        // by the neighbours, so they mustn't survive a failure of the joint fit
+        for (std::size_t j = 0; j < getFlagDefinitions().size(); ++j) {
+            _flagHandler.setValue(*record, j, false);
+        }
+        record->set(_instFluxResultKey, FluxResult());
+        record->set(_areaKey, std::numeric_limits<float>::quiet_NaN());
+        try {
+            geom::Point2D position = _centroidExtractor(*record, _flagHandler);
+            PTR(afw::detection::Psf::Image) psfImage =
+                    _psfCache->computeImage(position, _ctrl.psfCacheSpacing, _ctrl.psfCacheTolerance);
+            geom::Box2I fitBBox = psfImage->getBBox();
+            fitBBox.clip(exposure.getBBox());
+            if (fitBBox != psfImage->getBBox()) {
+                _flagHandler.setValue(*record, FAILURE.number, true);
+                _flagHandler.setValue(*record, EDGE.number, true);
+            }
+            PsfFitSums const recordSums = sumPsfFit(*psfImage, mimage, fitBBox, badBits);
+            if (recordSums.area == 0) {
+                throw LSST_EXCEPT(MeasurementError, NO_GOOD_PIXELS.doc, NO_GOOD_PIXELS.number);
+            }
+            records.push_back(record);
+            models.push_back(psfImage);
+            fitBBoxes.push_back(fitBBox);
+            sums.push_back(recordSums);
+        } catch (FatalAlgorithmError&) {
+            throw;
+        } catch (MeasurementError& error) {
+            fail(*record, &error);
+        } catch (pex::exceptions::Exception&) {
+            // e.g. a Psf that can't be evaluated at this position; the rest of the family can still be fit
+            fail(*record);
+        }
+    }
+
+    // Only sources whose models overlap are coupled by the normal equations
+    int const n = records.size();
+    Eigen::MatrixXd normal = Eigen::MatrixXd::Zero(n, n);    // sum(model_i*model_j)
+    Eigen::MatrixXd weighted = Eigen::MatrixXd::Zero(n, n);  // sum(model_i*model_j*variance)
+    Eigen::VectorXd rhs(n);                                  // sum(model_i*data)
+    for (int i = 0; i < n; ++i) {
+        normal(i, i) = sums[i].modelSquared;
+        weighted(i, i) = sums[i].modelSquaredVariance;
+        rhs[i] = sums[i].modelData;
+        for (int j = i + 1; j < n; ++j) {
+            geom::Box2I overlap = fitBBoxes[i];
+            overlap.clip(fitBBoxes[j]);
+            if (overlap.isEmpty()) {
+                continue;
+            }
+            std::pair<double, double> const products =
+                    sumPsfOverlap(*models[i], *models[j], mimage, overlap, badBits);
+            normal(i, j) = normal(j, i) = products.first;
+            weighted(i, j) = weighted(j, i) = products.second;
+        }
+    }
+
+    // Fail the sources whose models are (nearly) degenerate with those of the others, and fit the rest
+    // again without them: LDLT silently zeroes the solution for a zero pivot
+    std::vector<int> active(n);
+    std::iota(active.begin(), active.end(), 0);
+    while (!active.empty()) {
+        int const m = active.size();
+        Eigen::MatrixXd activeNormal(m, m);
+        Eigen::MatrixXd activeWeighted(m, m);
+        Eigen::VectorXd activeRhs(m);
+        for (int k = 0; k < m; ++k) {
+            activeRhs[k] = rhs[active[k]];
+            for (int l = 0; l < m; ++l) {
+                activeNormal(k, l) = normal(active[k], active[l]);
+                activeWeighted(k, l) = weighted(active[k], active[l]);
+            }
+        }
+        Eigen::LDLT<Eigen::MatrixXd> solver(activeNormal);
+        if (solver.info() != Eigen::Success) {
+            for (int k = 0; k < m; ++k) {
+                fail(*records[active[k]]);
+            }
+            return;
+        }
+        // pivot k of the decomposition belongs to source order[k] of the active sources
+        Eigen::VectorXi order = Eigen::VectorXi::LinSpaced(m, 0, m - 1);
+        order = solver.transpositionsP() * order;
+        std::vector<bool> degenerate(m, false);
+        bool anyDegenerate = false;
+        for (int k = 0; k < m; ++k) {
+            if (!(std::abs(solver.vectorD()[k]) > PIVOT_TOLERANCE * activeNormal(order[k], order[k]))) {
+                degenerate[order[k]] = anyDegenerate = true;
+            }
+        }
+        if (anyDegenerate) {
+            std::vector<int> remaining;
+            for (int k = 0; k < m; ++k) {
+                if (degenerate[k]) {
+                    fail(*records[active[k]]);
+                } else {
+                    remaining.push_back(active[k]);
+                }
+            }
+            active.swap(remaining);
+            continue;
+        }
+        Eigen::VectorXd const instFlux = solver.solve(activeRhs);
+        // The covariance of the unweighted fit, normal^-1 weighted normal^-1
+        Eigen::MatrixXd const covariance = solver.solve(solver.solve(activeWeighted).transpose());
+        for (int k = 0; k < m; ++k) {
+            int const i = active[k];
+            FluxResult result;
+            result.instFlux = instFlux[k];
+            result.instFluxErr = std::sqrt(covariance(k, k));
+            if (!std::isfinite(result.instFlux) || !std::isfinite(result.instFluxErr)) {
+                fail(*records[i]);
+                continue;
+            }
+            records[i]->set(_areaKey, sums[i].model / sums[i].modelSquared);
+            records[i]->set(_instFluxResultKey, result);
+        }
+        break;
     }
-    measRecord.set(_instFluxResultKey, result);
 }
 
 void PsfFluxAlgorithm::fail(afw::table::SourceRecord& measRecord, MeasurementError* error) const {
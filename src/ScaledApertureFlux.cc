@@ -36,14 +36,32 @@ ScaledApertureFluxAlgorithm::ScaledApertureFluxAlgorithm(Control const& ctrl, st
         : _ctrl(ctrl),
           _instFluxResultKey(
                   FluxResultKey::addFields(schema, name, "instFlux derived from PSF-scaled aperture")),
-          _centroidExtractor(schema, name) {
+          _centroidExtractor(schema, name),
+          _name(name),
+          _metadata(nullptr) {
     _flagHandler = FlagHandler::addFields(schema, name, ApertureFluxAlgorithm::getFlagDefinitions());
 }
 
+ScaledApertureFluxAlgorithm::ScaledApertureFluxAlgorithm(Control const& ctrl, std::string const& name,
+                                                         afw::table::Schema& schema,
+                                                         daf::base::PropertySet& metadata)
+        : ScaledApertureFluxAlgorithm(ctrl, name, schema) {
+    _metadata = &metadata;
+    _metadataKeys = {{name + "_sincCacheHits", name + "_sincCacheMisses", name + "_sincCacheEvictions",
+                      name + "_psfCacheHits", name + "_psfCacheFallbacks", name + "_psfCacheEvaluations"}};
+    _reported.fill(-1);
+}
+
 void ScaledApertureFluxAlgorithm::measure(afw::table::SourceRecord& measRecord,
                                           afw::image::Exposure<float> const& exposure) const {
     geom::Point2D const center = _centroidExtractor(measRecord, _flagHandler);
-    double const radius = exposure.getPsf()->computeShape(center).getDeterminantRadius();
+    PTR(afw::detection::Psf const) psf = exposure.getPsf();
+    if (!_psfCache || _psfCache->getPsf() != psf || _psfCache->getBBox() != exposure.getBBox()) {
+        _psfCache = PsfCache::get(psf, exposure.getBBox());
+    }
+    double const radius =
+            _psfCache->computeShape(center, _ctrl.psfCacheSpacing, _ctrl.psfCacheTolerance)
+                    .getDeterminantRadius();
     double const fwhm = 2.0 * std::sqrt(2.0 * std::log(2)) * radius;
     double const size = _ctrl.scale * fwhm;
     afw::geom::ellipses::Axes const axes(size, size);
@@ -52,11 +70,28 @@ void ScaledApertureFluxAlgorithm::measure(afw::table::SourceRecord& measRecord,
     // argument. All that it uses it for is to read the type of warping kernel.
     ApertureFluxControl apCtrl;
     apCtrl.shiftKernel = _ctrl.shiftKernel;
+    apCtrl.sincCacheTolerance = _ctrl.sincCacheTolerance;
 
     Result result = ApertureFluxAlgorithm::computeSincFlux(
             exposure.getMaskedImage(), afw::geom::ellipses::Ellipse(axes, center), apCtrl);
     measRecord.set(_instFluxResultKey, result);
 
+    if (_metadata) {
+        SincCoeffs<float>::LruStatistics const statistics = SincCoeffs<float>::getLruStatistics();
+        PsfCache::Statistics const psfStatistics = _psfCache->getStatistics();
+        std::array<long, 6> const values = {
+                {static_cast<long>(statistics.hits), static_cast<long>(statistics.misses),
+                 static_cast<long>(statistics.evictions), static_cast<long>(psfStatistics.hits),
+                 static_cast<long>(psfStatistics.fallbacks), static_cast<long>(psfStatistics.evaluations)}};
+        // Only set the statistics that changed (each measurement changes one or two of them)
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            if (values[i] != _reported[i]) {
+                _metadata->set(_metadataKeys[i], values[i]);
+                _reported[i] = values[i];
+            }
+        }
+    }
+
     for (std::size_t i = 0; i < ApertureFluxAlgorithm::getFlagDefinitions().size(); i++) {
         FlagDefinition const& iter = ApertureFluxAlgorithm::getFlagDefinitions()[i];
         if (result.getFlag(iter.number)) {
@@ -357,11 +357,12 @@ void doMeasureCentroidImpl(double *xCenter,                 // output; x-positio
 }
 
 template <typename MaskedImageT>
-std::pair<MaskedImageT, double> smoothAndBinImage(CONST_PTR(afw::detection::Psf) psf, int const x,
-                                                  const int y, MaskedImageT const &mimage, int binX, int binY,
+std::pair<MaskedImageT, double> smoothAndBinImage(PsfCache const &psfCache, int const gridSpacing,
+                                                  double const tolerance, int const x, const int y,
+                                                  MaskedImageT const &mimage, int binX, int binY,
                                                   FlagHandler _flagHandler) {
     geom::Point2D const center(x + mimage.getX0(), y + mimage.getY0());
-    afw::geom::ellipses::Quadrupole const &shape = psf->computeShape(center);
+    afw::geom::ellipses::Quadrupole const shape = psfCache.computeShape(center, gridSpacing, tolerance);
     double const smoothingSigma = shape.getDeterminantRadius();
 #if 0
     double const nEffective = psf->computeEffectiveArea(); // not implemented yet (#2821)
@@ -369,7 +370,7 @@ std::pair<MaskedImageT, double> smoothAndBinImage(CONST_PTR(afw::detection::Psf)
     double const nEffective = 4 * M_PI * smoothingSigma * smoothingSigma;  // correct for a Gaussian
 #endif
 
-    std::shared_ptr<afw::math::Kernel const> kernel = psf->getLocalKernel(center);
+    std::shared_ptr<afw::math::Kernel const> kernel = psfCache.getLocalKernel(center, gridSpacing, tolerance);
     int const kWidth = kernel->getWidth();
     int const kHeight = kernel->getHeight();
 
@@ -442,13 +443,17 @@ void SdssCentroidAlgorithm::measure(afw::table::SourceRecord &measRecord,
     if (!psf) {
         throw LSST_EXCEPT(FatalAlgorithmError, "SdssCentroid algorithm requires a Psf with every exposure");
     }
+    if (!_psfCache || _psfCache->getPsf() != psf || _psfCache->getBBox() != exposure.getBBox()) {
+        _psfCache = PsfCache::get(psf, exposure.getBBox());
+    }
 
     int binX = 1;
     int binY = 1;
     double xc = 0., yc = 0., dxc = 0., dyc = 0.;  // estimated centre and error therein
     for (int binsize = 1; binsize <= _ctrl.binmax; binsize *= 2) {
         std::pair<MaskedImageT, double> result =
-                smoothAndBinImage(psf, x, y, mimage, binX, binY, _flagHandler);
+                smoothAndBinImage(*_psfCache, _ctrl.psfCacheSpacing, _ctrl.psfCacheTolerance, x, y, mimage,
+                                  binX, binY, _flagHandler);
         MaskedImageT const smoothedImage = result.first;
         double const smoothingSigma = result.second;
 
@@ -21,8 +21,16 @@
  * see <https://www.lsstcorp.org/LegalNotices/>.
  */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <tuple>
+#include <vector>
 
 #include "boost/tuple/tuple.hpp"
 #include "Eigen/LU"
@@ -32,9 +40,12 @@
 #include "lsst/afw/image.h"
 #include "lsst/afw/detection/Psf.h"
 #include "lsst/afw/geom/ellipses.h"
+#include "lsst/afw/geom/SkyWcs.h"
+#include "lsst/afw/geom/transformFactory.h"
 #include "lsst/afw/table/Source.h"
 #include "lsst/meas/base/exceptions.h"
 #include "lsst/meas/base/SdssShape.h"
+#include "SdssShapeKernels.h"
 
 namespace lsst {
 namespace meas {
@@ -153,6 +164,9 @@ struct ImageAdaptor {
 
     Image const &getImage(ImageT const &image) const { return image; }
 
+    // A plain Image isn't held by a shared_ptr, so it can't be identified
+    std::shared_ptr<void const> getImagePtr(ImageT const &) const { return nullptr; }
+
     double getVariance(ImageT const &, int, int) { return std::numeric_limits<double>::quiet_NaN(); }
 };
 
@@ -164,6 +178,10 @@ struct ImageAdaptor<afw::image::MaskedImage<T> > {
 
     Image const &getImage(afw::image::MaskedImage<T> const &mimage) const { return *mimage.getImage(); }
 
+    std::shared_ptr<void const> getImagePtr(afw::image::MaskedImage<T> const &mimage) const {
+        return mimage.getImage();
+    }
+
     double getVariance(afw::image::MaskedImage<T> const &mimage, int ix, int iy) {
         return mimage.at(ix, iy).variance();
     }
@@ -206,6 +224,137 @@ geom::Box2I computeAdaptiveMomentsBBox(geom::Box2I const &bbox,      // full ima
     return result;
 }
 
+/*****************************************************************************/
+/*
+ * The ways in which calcmom can accumulate the moments.  The kernel is chosen once per call to calcmom,
+ * and each kernel is a separate instantiation, so there are no per-pixel branches on the configuration.
+ */
+enum class MomentsKernel {
+    SCALAR,              // the original SDSS loop, calling exp for every pixel
+    VECTOR,              // the best vectorized kernel that the CPU supports, accumulating in double
+    VECTOR_COMPENSATED,  // ditto, accumulating each row in single precision with Kahan compensation
+    RECURRENCE,          // weights generated along each row by recurrence
+    INTERPOLATED         // weights integrated over a 4x4 sub-pixel grid; used for very small objects
+};
+
+MomentsKernel chooseMomentsKernel(bool interpflag, SdssShapeControl const &control) {
+    if (interpflag) {
+        return MomentsKernel::INTERPOLATED;
+    } else if (control.doWeightRecurrence) {
+        return MomentsKernel::RECURRENCE;
+    } else if (control.doVectorize) {
+        return control.doCompensatedSums ? MomentsKernel::VECTOR_COMPENSATED : MomentsKernel::VECTOR;
+    }
+    return MomentsKernel::SCALAR;
+}
+
+/*
+ * Accumulate the weighted moments of the pixels in [ix0, ix1] x [iy0, iy1] with one of the row kernels
+ * (VECTOR, VECTOR_COMPENSATED or RECURRENCE).
+ *
+ * Only the span of each row that lies within the weight's cutoff ellipse is visited.  The pixels of
+ * the span are converted to float into a per-thread buffer; the quantities that only depend on the
+ * column are computed once per call rather than once per pixel.
+ */
+template <MomentsKernel kernel, bool instFluxOnly, typename ImageT>
+void accumulateRowMoments(ImageT const &image, float xcen, float ycen, int ix0, int ix1, int iy0, int iy1,
+                          float bkgd, double w11, double w12, double w22, detail::MomentSums &sums) {
+    static thread_local std::vector<float> buffer;
+    int const nx = ix1 - ix0 + 1;
+    buffer.resize(4 * nx);
+    float *const tmod = buffer.data();
+    float *const x = tmod + nx;
+    float *const x2 = x + nx;
+    float *const xpos = x2 + nx;
+
+    for (int j = ix0; j <= ix1; ++j) {
+        x[j - ix0] = j - xcen;
+        x2[j - ix0] = x[j - ix0] * x[j - ix0];
+        xpos[j - ix0] = j;
+    }
+
+    detail::MomentsIsa const isa = detail::getMomentsIsa();
+    for (int i = iy0; i <= iy1; ++i) {
+        float const y = i - ycen;
+        float const y2 = y * y;
+        int begin, end;
+        if (!detail::getMomentsRowSpan(ix0, ix1, xcen, y, w11, w12, w22, begin, end,
+                                       detail::MOMENTS_SPAN_ALIGN)) {
+            continue;
+        }
+        int const offset = begin - ix0;
+        int const n = end - begin + 1;
+        typename ImageT::x_iterator ptr = image.x_at(begin, i);
+        for (int j = offset; j < offset + n; ++j, ++ptr) {
+            tmod[j] = *ptr - bkgd;
+        }
+        if (kernel == MomentsKernel::RECURRENCE) {
+            detail::accumulateMomentsRowRecurrence<instFluxOnly>(n, tmod + offset, x + offset, x2 + offset,
+                                                                 xpos + offset, begin - double(xcen), y, y2,
+                                                                 i, w11, w12, w22, sums);
+        } else {
+            detail::accumulateMomentsRow<instFluxOnly, kernel == MomentsKernel::VECTOR_COMPENSATED>(
+                    isa, n, tmod + offset, x + offset, x2 + offset, xpos + offset, y, y2, i, w11, w12, w22,
+                    sums);
+        }
+    }
+}
+
+/*
+ * Accumulate the weighted moments of the pixels in [ix0, ix1] x [iy0, iy1] one pixel at a time, as
+ * in the original SDSS code (but only visiting the span of each row within the weight's cutoff).
+ */
+template <bool instFluxOnly, typename ImageT>
+void accumulateScalarMoments(ImageT const &image, float xcen, float ycen, int ix0, int ix1, int iy0,
+                             int iy1, float bkgd, double w11, double w12, double w22,
+                             detail::MomentSums &sums) {
+    for (int i = iy0; i <= iy1; ++i) {
+        float const y = i - ycen;
+        float const y2 = y * y;
+        int begin, end;
+        if (!detail::getMomentsRowSpan(ix0, ix1, xcen, y, w11, w12, w22, begin, end)) {
+            continue;
+        }
+        typename ImageT::x_iterator ptr = image.x_at(begin, i);
+        for (int j = begin; j <= end; ++j, ++ptr) {
+            float const x = j - xcen;
+            detail::accumulateMomentsPixel<instFluxOnly>(*ptr - bkgd, x, x * x, j, y, y2, i, w11, w12, w22,
+                                                         sums);
+        }
+    }
+}
+
+/*
+ * Accumulate the weighted moments of the pixels in [ix0, ix1] x [iy0, iy1], integrating the weight
+ * over each pixel.
+ */
+template <bool instFluxOnly, typename ImageT>
+void accumulateInterpolatedMoments(ImageT const &image, float xcen, float ycen, int ix0, int ix1, int iy0,
+                                   int iy1, float bkgd, double w11, double w12, double w22,
+                                   detail::MomentSums &sums) {
+    // The sub-pixel weights only depend on the weights, the centre and the box, so we tabulate them
+    std::shared_ptr<detail::SubpixelMomentsTable const> table =
+            detail::getSubpixelMomentsTable(ix0, ix1, iy0, iy1, xcen, ycen, w11, w12, w22);
+    for (int i = iy0; i <= iy1; ++i) {
+        typename ImageT::x_iterator ptr = image.x_at(ix0, i);
+        if (table) {
+            detail::SubpixelMomentWeights const *pixel = table->getRow(i);
+            for (int j = ix0; j <= ix1; ++j, ++ptr, ++pixel) {
+                if (pixel->w > 0) {
+                    detail::addSubpixelMomentsPixel<instFluxOnly>(*ptr - bkgd, *pixel, sums);
+                }
+            }
+        } else {
+            detail::SubpixelMomentWeights pixel;
+            for (int j = ix0; j <= ix1; ++j, ++ptr) {
+                if (detail::computeSubpixelMomentWeights(j, i, xcen, ycen, w11, w12, w22, pixel)) {
+                    detail::addSubpixelMomentsPixel<instFluxOnly>(*ptr - bkgd, pixel, sums);
+                }
+            }
+        }
+    }
+}
+
 /*****************************************************************************/
 /*
  * Calculate weighted moments of an object up to 2nd order
@@ -222,26 +371,13 @@ static int calcmom(ImageT const &image,                             // the image
                    double *psumx, double *psumy,                    // sum [xy]*w*I (if !instFluxOnly)
                    double *psumxx, double *psumxy, double *psumyy,  // sum [xy]^2*w*I (if !instFluxOnly)
                    double *psums4,  // sum w*I*weight^2 (if !instFluxOnly && !NULL)
-                   bool negative = false) {
-    float tmod, ymod;
-    float X, Y;  // sub-pixel interpolated [xy]
-    float weight;
-    float tmp;
-    double sum, sumx, sumy, sumxx, sumyy, sumxy, sums4;
-#define RECALC_W 0  // estimate sigmaXX_w within BBox?
-#if RECALC_W
-    double wsum, wsumxx, wsumxy, wsumyy;
-
-    wsum = wsumxx = wsumxy = wsumyy = 0;
-#endif
-
+                   bool negative,   // is the object negative?
+                   SdssShapeControl const &control) {  // chooses the kernel if !interpflag
     assert(w11 >= 0);  // i.e. it was set
     if (fabs(w11) > 1e6 || fabs(w12) > 1e6 || fabs(w22) > 1e6) {
         return (-1);
     }
 
-    sum = sumx = sumy = sumxx = sumxy = sumyy = sums4 = 0;
-
     int const ix0 = bbox.getMinX();  // corners of the box being analyzed
     int const ix1 = bbox.getMaxX();
     int const iy0 = bbox.getMinY();  // corners of the box being analyzed
@@ -251,103 +387,32 @@ static int calcmom(ImageT const &image,                             // the image
         return -1;
     }
 
-    for (int i = iy0; i <= iy1; ++i) {
-        typename ImageT::x_iterator ptr = image.x_at(ix0, i);
-        float const y = i - ycen;
-        float const y2 = y * y;
-        float const yl = y - 0.375;
-        float const yh = y + 0.375;
-        for (int j = ix0; j <= ix1; ++j, ++ptr) {
-            float x = j - xcen;
-            if (interpflag) {
-                float const xl = x - 0.375;
-                float const xh = x + 0.375;
-
-                float expon = xl * xl * w11 + yl * yl * w22 + 2.0 * xl * yl * w12;
-                tmp = xh * xh * w11 + yh * yh * w22 + 2.0 * xh * yh * w12;
-                expon = (expon > tmp) ? expon : tmp;
-                tmp = xl * xl * w11 + yh * yh * w22 + 2.0 * xl * yh * w12;
-                expon = (expon > tmp) ? expon : tmp;
-                tmp = xh * xh * w11 + yl * yl * w22 + 2.0 * xh * yl * w12;
-                expon = (expon > tmp) ? expon : tmp;
-
-                if (expon <= 9.0) {
-                    tmod = *ptr - bkgd;
-                    for (Y = yl; Y <= yh; Y += 0.25) {
-                        double const interpY2 = Y * Y;
-                        for (X = xl; X <= xh; X += 0.25) {
-                            double const interpX2 = X * X;
-                            double const interpXy = X * Y;
-                            expon = interpX2 * w11 + 2 * interpXy * w12 + interpY2 * w22;
-                            weight = std::exp(-0.5 * expon);
-
-                            ymod = tmod * weight;
-                            sum += ymod;
-                            if (!instFluxOnly) {
-                                sumx += ymod * (X + xcen);
-                                sumy += ymod * (Y + ycen);
-#if RECALC_W
-                                wsum += weight;
-
-                                tmp = interpX2 * weight;
-                                wsumxx += tmp;
-                                sumxx += tmod * tmp;
-
-                                tmp = interpXy * weight;
-                                wsumxy += tmp;
-                                sumxy += tmod * tmp;
-
-                                tmp = interpY2 * weight;
-                                wsumyy += tmp;
-                                sumyy += tmod * tmp;
-#else
-                                sumxx += interpX2 * ymod;
-                                sumxy += interpXy * ymod;
-                                sumyy += interpY2 * ymod;
-#endif
-                                sums4 += expon * expon * ymod;
-                            }
-                        }
-                    }
-                }
-            } else {
-                float x2 = x * x;
-                float xy = x * y;
-                float expon = x2 * w11 + 2 * xy * w12 + y2 * w22;
-
-                if (expon <= 14.0) {
-                    weight = std::exp(-0.5 * expon);
-                    tmod = *ptr - bkgd;
-                    ymod = tmod * weight;
-                    sum += ymod;
-                    if (!instFluxOnly) {
-                        sumx += ymod * j;
-                        sumy += ymod * i;
-#if RECALC_W
-                        wsum += weight;
-
-                        tmp = x2 * weight;
-                        wsumxx += tmp;
-                        sumxx += tmod * tmp;
-
-                        tmp = xy * weight;
-                        wsumxy += tmp;
-                        sumxy += tmod * tmp;
-
-                        tmp = y2 * weight;
-                        wsumyy += tmp;
-                        sumyy += tmod * tmp;
-#else
-                        sumxx += x2 * ymod;
-                        sumxy += xy * ymod;
-                        sumyy += y2 * ymod;
-#endif
-                        sums4 += expon * expon * ymod;
-                    }
-                }
-            }
-        }
+    detail::MomentSums sums;
+    switch (chooseMomentsKernel(interpflag, control)) {
+        case MomentsKernel::INTERPOLATED:
+            accumulateInterpolatedMoments<instFluxOnly>(image, xcen, ycen, ix0, ix1, iy0, iy1, bkgd, w11, w12,
+                                                        w22, sums);
+            break;
+        case MomentsKernel::RECURRENCE:
+            accumulateRowMoments<MomentsKernel::RECURRENCE, instFluxOnly>(image, xcen, ycen, ix0, ix1, iy0,
+                                                                          iy1, bkgd, w11, w12, w22, sums);
+            break;
+        case MomentsKernel::VECTOR:
+            accumulateRowMoments<MomentsKernel::VECTOR, instFluxOnly>(image, xcen, ycen, ix0, ix1, iy0, iy1,
+                                                                      bkgd, w11, w12, w22, sums);
+            break;
+        case MomentsKernel::VECTOR_COMPENSATED:
+            accumulateRowMoments<MomentsKernel::VECTOR_COMPENSATED, instFluxOnly>(
+                    image, xcen, ycen, ix0, ix1, iy0, iy1, bkgd, w11, w12, w22, sums);
+            break;
+        case MomentsKernel::SCALAR:
+            accumulateScalarMoments<instFluxOnly>(image, xcen, ycen, ix0, ix1, iy0, iy1, bkgd, w11, w12, w22,
+                                                  sums);
+            break;
     }
+    double const sum = sums.sum;
+    double const sumxx = sums.sumxx;
+    double const sumyy = sums.sumyy;
 
     std::tuple<std::pair<bool, double>, double, double, double> const weights = getWeights(w11, w12, w22);
     double const detW = std::get<1>(weights) * std::get<3>(weights) - std::pow(std::get<2>(weights), 2);
@@ -356,26 +421,16 @@ static int calcmom(ImageT const &image,                             // the image
         *psum = sum;
     }
     if (!instFluxOnly) {
-        *psumx = sumx;
-        *psumy = sumy;
+        *psumx = sums.sumx;
+        *psumy = sums.sumy;
         *psumxx = sumxx;
-        *psumxy = sumxy;
+        *psumxy = sums.sumxy;
         *psumyy = sumyy;
         if (psums4 != NULL) {
-            *psums4 = sums4;
+            *psums4 = sums.sums4;
         }
     }
 
-#if RECALC_W
-    if (wsum > 0 && !instFluxOnly) {
-        double det = w11 * w22 - w12 * w12;
-        wsumxx /= wsum;
-        wsumxy /= wsum;
-        wsumyy /= wsum;
-        printf("%g %g %g  %g %g %g\n", w22 / det, -w12 / det, w11 / det, wsumxx, wsumxy, wsumyy);
-    }
-#endif
-
     if (negative) {
         return (instFluxOnly || (sum < 0 && sumxx < 0 && sumyy < 0)) ? 0 : -1;
     } else {
@@ -383,14 +438,244 @@ static int calcmom(ImageT const &image,                             // the image
     }
 }
 
+/*
+ * Is a shape usable as the starting point for the adaptive moments iteration?
+ */
+bool isValidInitialShape(afw::geom::ellipses::Quadrupole const &shape) {
+    double const ixx = shape.getIxx();
+    double const iyy = shape.getIyy();
+    double const ixy = shape.getIxy();
+    return std::isfinite(ixx) && std::isfinite(iyy) && std::isfinite(ixy) && ixx > 0 && iyy > 0 &&
+           ixx * iyy > ixy * ixy;
+}
+
+/*
+ * Aitken delta-squared extrapolation of the weight moments (sigma11W, sigma12W, sigma22W)
+ *
+ * The adaptive moments iteration converges linearly, so after three successive updates s0, s1, s2 of a
+ * moment its limit is approximately s2 - (s2 - s1)^2/(s2 - 2 s1 + s0).  The extrapolation is only used if
+ * it is finite, positive definite and within a factor of two of s2 (it's unreliable far from convergence,
+ * and a bad guess only costs iterations); after each extrapolation three fresh updates are needed.
+ */
+class WeightExtrapolator {
+public:
+    WeightExtrapolator() : _n(0) {}
+
+    // Forget the history, e.g. when the moments jump because we start interpolating
+    void reset() { _n = 0; }
+
+    // Record a new set of weight moments, replacing them with their extrapolated values if possible
+    void update(double *sigma11W, double *sigma12W, double *sigma22W) {
+        if (_n == 3) {
+            std::copy(_history + 1, _history + 3, _history);
+            --_n;
+        }
+        _history[_n++] = {{*sigma11W, *sigma12W, *sigma22W}};
+        if (_n < 3) {
+            return;
+        }
+
+        double const scale = std::max(std::fabs(*sigma11W), std::fabs(*sigma22W));
+        std::array<double, 3> limit;
+        for (int i = 0; i < 3; ++i) {
+            double const s0 = _history[0][i], s1 = _history[1][i], s2 = _history[2][i];
+            double const denom = s2 - 2 * s1 + s0;
+            limit[i] = (std::fabs(denom) > 1e-9 * scale) ? s2 - (s2 - s1) * (s2 - s1) / denom : s2;
+        }
+        if (!std::isfinite(limit[0]) || !std::isfinite(limit[1]) || !std::isfinite(limit[2]) ||
+            limit[0] <= 0.5 * *sigma11W || limit[0] >= 2 * *sigma11W || limit[2] <= 0.5 * *sigma22W ||
+            limit[2] >= 2 * *sigma22W || limit[0] * limit[2] <= limit[1] * limit[1]) {
+            return;
+        }
+        *sigma11W = limit[0];
+        *sigma12W = limit[1];
+        *sigma22W = limit[2];
+        _n = 0;
+    }
+
+private:
+    int _n;                             // number of valid entries in _history
+    std::array<double, 3> _history[3];  // successive (sigma11W, sigma12W, sigma22W), oldest first
+};
+
+/*
+ * The weighted sums of the final iteration of an adaptive moments measurement, and everything they
+ * depend on, so that a fixed-moments flux computed with exactly the same weights can reuse them
+ */
+struct FinalMomentSums {
+    FinalMomentSums() : valid(false) {}
+
+    // Were these sums computed from the same pixels, in the same way, as a calcmom call would be?
+    template <typename ImageT>
+    bool matches(ImageT const &image, float xcen_, float ycen_, geom::BoxI const &bbox_, float bkgd_,
+                 bool interp_, double w11_, double w12_, double w22_, MomentsKernel kernel_) const {
+        return valid && pixels == image.getArray().getData() && imageBBox == image.getBBox() &&
+               xcen == xcen_ && ycen == ycen_ && bbox == bbox_ && bkgd == bkgd_ && interp == interp_ &&
+               w11 == w11_ && w12 == w12_ && w22 == w22_ && kernel == kernel_;
+    }
+
+    bool valid;          // are the other members set?
+    void const *pixels;  // identifies the image measured
+    geom::BoxI imageBBox;
+    float xcen, ycen;
+    geom::BoxI bbox;
+    float bkgd;
+    bool interp;
+    double w11, w12, w22;
+    MomentsKernel kernel;
+    double I0;  // the result
+};
+
+/*
+ * Binned copies of a region of an image, for coarse-to-fine adaptive moments of large objects
+ *
+ * Level k (1 <= k <= N_LEVELS) is the region binned by 2^k: each of its pixels is the sum of the 2^k x
+ * 2^k pixels of the image starting at the region's lower-left corner (so the moments are unchanged,
+ * apart from the blurring by the bins); rows and columns that don't fill a bin are dropped.
+ */
+class MomentsPyramid {
+public:
+    static int const N_LEVELS = 3;  // binning by 2, 4 and 8
+
+    // region is in the LOCAL coordinates of image
+    template <typename ImageT>
+    MomentsPyramid(ImageT const &image, geom::BoxI const &region) : _region(region) {
+        _levels[0] = binByTwo(image.getArray(), region.getMinX(), region.getMinY(), region.getWidth() / 2,
+                              region.getHeight() / 2);
+        for (int k = 1; k < N_LEVELS; ++k) {
+            _levels[k] = binByTwo(_levels[k - 1]->getArray(), 0, 0, _levels[k - 1]->getWidth() / 2,
+                                  _levels[k - 1]->getHeight() / 2);
+        }
+    }
+
+    // Return level k (the region binned by 2^k)
+    afw::image::Image<float> const &getLevel(int k) const { return *_levels[k - 1]; }
+
+    // Return the position on level k of a point in the LOCAL coordinates of the image
+    geom::Point2D toLevel(int k, geom::Point2D const &point) const {
+        int const factor = 1 << k;
+        double const offset = 0.5 * (factor - 1);  // centre of a bin, relative to its first pixel
+        return geom::Point2D((point.getX() - _region.getMinX() - offset) / factor,
+                             (point.getY() - _region.getMinY() - offset) / factor);
+    }
+
+private:
+    template <typename ArrayT>
+    static std::unique_ptr<afw::image::Image<float>> binByTwo(ArrayT const &array, int x0, int y0,
+                                                               int width, int height) {
+        std::unique_ptr<afw::image::Image<float>> binned(
+                new afw::image::Image<float>(std::max(width, 1), std::max(height, 1)));
+        *binned = 0.0;
+        auto out = binned->getArray();
+        for (int i = 0; i < height; ++i) {
+            for (int j = 0; j < width; ++j) {
+                int const x = x0 + 2 * j;
+                int const y = y0 + 2 * i;
+                out[i][j] = static_cast<double>(array[y][x]) + array[y][x + 1] + array[y + 1][x] +
+                            array[y + 1][x + 1];
+            }
+        }
+        return binned;
+    }
+
+    geom::BoxI _region;
+    std::unique_ptr<afw::image::Image<float>> _levels[N_LEVELS];
+};
+
+/*
+ * A MomentsPyramid of a whole image, built by the first thread to need it and then shared (read-only)
+ * by all the objects measured on that image
+ */
+class SharedMomentsPyramid {
+public:
+    template <typename ImageT>
+    MomentsPyramid const &get(ImageT const &image) {
+        std::call_once(_once, [&]() {
+            _pyramid.reset(new MomentsPyramid(image, image.getBBox(afw::image::LOCAL)));
+        });
+        return *_pyramid;
+    }
+
+private:
+    std::once_flag _once;
+    std::unique_ptr<MomentsPyramid> _pyramid;
+};
+
+// Levels of a MomentsPyramid are only used while the weight's sigma is at least this many binned pixels
+double const PYRAMID_MIN_BINNED_SIGMA = 4.0;
+
+template <typename ImageT>
+bool getAdaptiveMoments(ImageT const &mimage, double xcen, double ycen, double shiftmax,
+                        SdssShapeResult *shape, bool negative, SdssShapeControl const &control,
+                        afw::geom::ellipses::Quadrupole const *initialShape, FinalMomentSums *finalSums,
+                        SharedMomentsPyramid *sharedPyramid);
+
+/*
+ * Improve the weight moments of a large object by running the adaptive moments iteration to convergence
+ * on successively finer levels of a pyramid, starting with the coarsest level on which the weight's sigma
+ * is at least PYRAMID_MIN_BINNED_SIGMA pixels.  The moments are left at the result of the finest level on
+ * which the iteration succeeded; returns false if it failed on the coarsest.
+ *
+ * xcen and ycen are in the LOCAL coordinates of the image the pyramid was made from.
+ */
+bool refineWeightsOnPyramid(MomentsPyramid const &pyramid, double xcen, double ycen, bool negative,
+                            SdssShapeControl const &control, double &sigma11W, double &sigma12W,
+                            double &sigma22W) {
+    double const sigma = std::sqrt(std::max(sigma11W, sigma22W));
+    int k = MomentsPyramid::N_LEVELS;
+    while (k > 0 && sigma / (1 << k) < PYRAMID_MIN_BINNED_SIGMA) {
+        --k;
+    }
+    bool refined = false;
+    for (; k > 0; --k) {
+        double const factor2 = 1 << (2 * k);              // area of a bin
+        double const binVariance = (factor2 - 1) / 12.0;  // variance of a bin, in pixels^2
+        afw::geom::ellipses::Quadrupole const guess((sigma11W + binVariance) / factor2,
+                                                    (sigma22W + binVariance) / factor2,
+                                                    sigma12W / factor2);
+        if (!isValidInitialShape(guess)) {
+            break;
+        }
+        SdssShapeControl coarseControl(control);
+        coarseControl.background = control.background * factor2;
+        coarseControl.pyramidMinSigma = 0;
+        geom::Point2D const center = pyramid.toLevel(k, geom::Point2D(xcen, ycen));
+        SdssShapeResult coarse;
+        if (!getAdaptiveMoments(pyramid.getLevel(k), center.getX(), center.getY(), 10.0, &coarse, negative,
+                                coarseControl, &guess, nullptr, nullptr) ||
+            coarse.flags[SdssShapeAlgorithm::UNWEIGHTED.number]) {
+            break;
+        }
+        double const xx = coarse.xx * factor2 - binVariance;
+        double const yy = coarse.yy * factor2 - binVariance;
+        double const xy = coarse.xy * factor2;
+        if (!(xx > 0 && yy > 0 && xx * yy > xy * xy)) {
+            break;
+        }
+        sigma11W = xx;
+        sigma12W = xy;
+        sigma22W = yy;
+        refined = true;
+    }
+    return refined;
+}
+
 /*
  * Workhorse for adaptive moments
  *
  * All inputs are expected to be in LOCAL image coordinates
  */
 template <typename ImageT>
-bool getAdaptiveMoments(ImageT const &mimage, double bkgd, double xcen, double ycen, double shiftmax,
-                        SdssShapeResult *shape, int maxIter, float tol1, float tol2, bool negative) {
+bool getAdaptiveMoments(ImageT const &mimage, double xcen, double ycen, double shiftmax,
+                        SdssShapeResult *shape, bool negative, SdssShapeControl const &control,
+                        afw::geom::ellipses::Quadrupole const *initialShape, FinalMomentSums *finalSums,
+                        SharedMomentsPyramid *sharedPyramid) {
+    double const bkgd = control.background;
+    int const maxIter = control.maxIter;
+    float const tol1 = control.tol1;
+    float const tol2 = control.tol2;
+    bool const accelerate = control.doAccelerate;
+
     double I0 = 0;               // amplitude of best-fit Gaussian
     double sum;                  // sum of intensity*weight
     double sumx, sumy;           // sum ((int)[xy])*intensity*weight
@@ -403,12 +688,21 @@ bool getAdaptiveMoments(ImageT const &mimage, double bkgd, double xcen, double y
     double sigma12W = 0.0;  //     weighting fcn;
     double sigma22W = 1.5;  //               xx, xy, and yy
 
+    if (initialShape && isValidInitialShape(*initialShape)) {
+        sigma11W = initialShape->getIxx();
+        sigma12W = initialShape->getIxy();
+        sigma22W = initialShape->getIyy();
+    }
+
     double w11 = -1, w12 = -1, w22 = -1;  // current weights for moments; always set when iter == 0
     float e1_old = 1e6, e2_old = 1e6;     // old values of shape parameters e1 and e2
     float sigma11_ow_old = 1e6;           // previous version of sigma11_ow
+    WeightExtrapolator extrapolator;      // used if accelerate
 
     typename ImageAdaptor<ImageT>::Image const &image = ImageAdaptor<ImageT>().getImage(mimage);
 
+    shape->nIter = 0;
+    shape->bboxArea = 0;
     if (std::isnan(xcen) || std::isnan(ycen)) {
         // Can't do anything
         shape->flags[SdssShapeAlgorithm::UNWEIGHTED_BAD.number] = true;
@@ -416,9 +710,33 @@ bool getAdaptiveMoments(ImageT const &mimage, double bkgd, double xcen, double y
     }
 
     bool interpflag = false;  // interpolate finer than a pixel?
+    bool pyramidUsed = false;  // have the weights been refined on a MomentsPyramid?
     geom::BoxI bbox;
     int iter = 0;  // iteration number
     for (; iter < maxIter; iter++) {
+        if (control.pyramidMinSigma > 0 && !pyramidUsed &&
+            std::max(sigma11W, sigma22W) > control.pyramidMinSigma * control.pyramidMinSigma) {
+            // A large object: converge on binned images first, and only refine at full resolution
+            pyramidUsed = true;
+            std::unique_ptr<MomentsPyramid> localPyramid;
+            MomentsPyramid const *pyramid = nullptr;
+            if (sharedPyramid) {
+                pyramid = &sharedPyramid->get(image);
+            } else {
+                // Twice the size of the current box, to leave the weights room to grow
+                geom::BoxI const region = computeAdaptiveMomentsBBox(
+                        image.getBBox(afw::image::LOCAL), geom::Point2D(xcen, ycen), 4 * sigma11W,
+                        4 * sigma12W, 4 * sigma22W);
+                localPyramid.reset(new MomentsPyramid(image, region));
+                pyramid = localPyramid.get();
+            }
+            if (refineWeightsOnPyramid(*pyramid, xcen, ycen, negative, control, sigma11W, sigma12W,
+                                       sigma22W)) {
+                extrapolator.reset();
+                e1_old = e2_old = 1e6;  // the previous iterations tell us nothing about convergence
+                sigma11_ow_old = 1e6;
+            }
+        }
         bbox = computeAdaptiveMomentsBBox(image.getBBox(afw::image::LOCAL), geom::Point2D(xcen, ycen),
                                           sigma11W, sigma12W, sigma22W);
         std::tuple<std::pair<bool, double>, double, double, double> weights =
@@ -448,6 +766,7 @@ bool getAdaptiveMoments(ImageT const &mimage, double bkgd, double xcen, double y
             if (shouldInterp(sigma11W, sigma22W, detW)) {
                 if (!interpflag) {
                     interpflag = true;  // N.b.: stays set for this object
+                    extrapolator.reset();  // the moments change discontinuously
                     if (iter > 0) {
                         sigma11_ow_old = 1.e6;  // force at least one more iteration
                         w11 = ow11;
@@ -460,7 +779,7 @@ bool getAdaptiveMoments(ImageT const &mimage, double bkgd, double xcen, double y
         }
 
         if (calcmom<false>(image, xcen, ycen, bbox, bkgd, interpflag, w11, w12, w22, &I0, &sum, &sumx, &sumy,
-                           &sumxx, &sumxy, &sumyy, &sums4, negative) < 0) {
+                           &sumxx, &sumxy, &sumyy, &sums4, negative, control) < 0) {
             shape->flags[SdssShapeAlgorithm::UNWEIGHTED.number] = true;
             break;
         }
@@ -563,8 +882,14 @@ bool getAdaptiveMoments(ImageT const &mimage, double bkgd, double xcen, double y
             shape->flags[SdssShapeAlgorithm::UNWEIGHTED.number] = true;
             break;
         }
+
+        if (accelerate) {
+            extrapolator.update(&sigma11W, &sigma12W, &sigma22W);
+        }
     }
 
+    shape->nIter = std::min(iter + 1, maxIter);
+    shape->bboxArea = bbox.getArea();
     if (iter == maxIter) {
         shape->flags[SdssShapeAlgorithm::UNWEIGHTED.number] = true;
         shape->flags[SdssShapeAlgorithm::MAXITER.number] = true;
@@ -573,13 +898,29 @@ bool getAdaptiveMoments(ImageT const &mimage, double bkgd, double xcen, double y
     if (sumxx + sumyy == 0.0) {
         shape->flags[SdssShapeAlgorithm::UNWEIGHTED.number] = true;
     }
+    if (finalSums && !shape->flags[SdssShapeAlgorithm::UNWEIGHTED.number]) {
+        // The sums of the last iteration were computed with the weights we're about to return
+        finalSums->valid = true;
+        finalSums->pixels = image.getArray().getData();
+        finalSums->imageBBox = image.getBBox();
+        finalSums->xcen = xcen;
+        finalSums->ycen = ycen;
+        finalSums->bbox = bbox;
+        finalSums->bkgd = bkgd;
+        finalSums->interp = interpflag;
+        finalSums->w11 = w11;
+        finalSums->w12 = w12;
+        finalSums->w22 = w22;
+        finalSums->kernel = chooseMomentsKernel(interpflag, control);
+        finalSums->I0 = I0;
+    }
     /*
      * Problems; try calculating the un-weighted moments
      */
     if (shape->flags[SdssShapeAlgorithm::UNWEIGHTED.number]) {
         w11 = w22 = w12 = 0;
         if (calcmom<false>(image, xcen, ycen, bbox, bkgd, interpflag, w11, w12, w22, &I0, &sum, &sumx, &sumy,
-                           &sumxx, &sumxy, &sumyy, NULL, negative) < 0 ||
+                           &sumxx, &sumxy, &sumyy, NULL, negative, control) < 0 ||
             (!negative && sum <= 0) || (negative && sum >= 0)) {
             shape->flags[SdssShapeAlgorithm::UNWEIGHTED.number] = false;
             shape->flags[SdssShapeAlgorithm::UNWEIGHTED_BAD.number] = true;
@@ -636,12 +977,232 @@ bool getAdaptiveMoments(ImageT const &mimage, double bkgd, double xcen, double y
     return true;
 }
 
+/*
+ * Implementation of SdssShapeAlgorithm::computeAdaptiveMoments, optionally starting from initialShape
+ */
+template <typename ImageT>
+SdssShapeResult computeAdaptiveMomentsImpl(ImageT const &image, geom::Point2D const &center, bool negative,
+                                           SdssShapeControl const &control,
+                                           afw::geom::ellipses::Quadrupole const *initialShape,
+                                           FinalMomentSums *finalSums = nullptr,
+                                           SharedMomentsPyramid *sharedPyramid = nullptr) {
+    double xcen = center.getX();  // object's column position
+    double ycen = center.getY();  // object's row position
+
+    xcen -= image.getX0();  // work in image Pixel coordinates
+    ycen -= image.getY0();
+
+    float shiftmax = control.maxShift;  // Max allowed centroid shift
+    if (shiftmax < 2) {
+        shiftmax = 2;
+    } else if (shiftmax > 10) {
+        shiftmax = 10;
+    }
+
+    SdssShapeResult result;
+    try {
+        result.flags[SdssShapeAlgorithm::FAILURE.number] =
+                !getAdaptiveMoments(image, xcen, ycen, shiftmax, &result, negative, control, initialShape,
+                                    finalSums, sharedPyramid);
+    } catch (pex::exceptions::Exception &err) {
+        result.flags[SdssShapeAlgorithm::FAILURE.number] = true;
+    }
+    if (result.flags[SdssShapeAlgorithm::UNWEIGHTED.number] ||
+        result.flags[SdssShapeAlgorithm::SHIFT.number]) {
+        // These are also considered fatal errors in terms of the quality of the results,
+        // even though they do produce some results.
+        result.flags[SdssShapeAlgorithm::FAILURE.number] = true;
+    }
+    if (result.getQuadrupole().getIxx() * result.getQuadrupole().getIyy() <
+        (1.0 + 1.0e-6) * result.getQuadrupole().getIxy() * result.getQuadrupole().getIxy())
+    // We are checking that Ixx*Iyy > (1 + epsilon)*Ixy*Ixy where epsilon is suitably small. The
+    // value of epsilon used here is a magic number. DM-5801 is supposed to figure out if we are
+    // to keep this value.
+    {
+        if (!result.flags[SdssShapeAlgorithm::FAILURE.number]) {
+            throw LSST_EXCEPT(pex::exceptions::LogicError,
+                              "Should not get singular moments unless a flag is set");
+        }
+    }
+
+    // getAdaptiveMoments() just computes the zeroth moment in result.instFlux (and its error in
+    // result.instFluxErr, result.instFlux_xx_Cov, etc.)  That's related to the instFlux by some geometric
+    // factors, which we apply here.
+    double instFluxScale = computeFluxScale(result);
+
+    result.instFlux *= instFluxScale;
+    result.instFluxErr *= instFluxScale;
+    result.x += image.getX0();
+    result.y += image.getY0();
+
+    if (ImageAdaptor<ImageT>::hasVariance) {
+        result.instFlux_xx_Cov *= instFluxScale;
+        result.instFlux_yy_Cov *= instFluxScale;
+        result.instFlux_xy_Cov *= instFluxScale;
+    }
+
+    return result;
+}
+
+// The final sums of the source most recently measured by an SdssShapeAlgorithm on this thread, and the
+// Image they were measured in (a weak_ptr can't be matched by a new Image, even at the same address)
+thread_local afw::table::RecordId lastMeasuredId = 0;
+thread_local std::weak_ptr<void const> lastMeasuredImage;
+thread_local FinalMomentSums lastMeasuredSums;
+
+/*
+ * Implementation of SdssShapeAlgorithm::computeFixedMomentsFlux, reusing the sums in cached (if not null)
+ * if they were computed with the same weights
+ */
+template <typename ImageT>
+FluxResult computeFixedMomentsFluxImpl(ImageT const &image, afw::geom::ellipses::Quadrupole const &shape,
+                                       geom::Point2D const &center, SdssShapeControl const &control,
+                                       FinalMomentSums const *cached) {
+    // while arguments to computeFixedMomentsFlux are in PARENT coordinates, the implementation is LOCAL.
+    geom::Point2D localCenter = center - geom::Extent2D(image.getXY0());
+
+    geom::BoxI const bbox = computeAdaptiveMomentsBBox(image.getBBox(afw::image::LOCAL), localCenter,
+                                                       shape.getIxx(), shape.getIxy(), shape.getIyy());
+
+    std::tuple<std::pair<bool, double>, double, double, double> weights =
+            getWeights(shape.getIxx(), shape.getIxy(), shape.getIyy());
+
+    FluxResult result;
+
+    if (!std::get<0>(weights).first) {
+        throw pex::exceptions::InvalidParameterError("Input shape is singular");
+    }
+
+    double const w11 = std::get<1>(weights);
+    double const w12 = std::get<2>(weights);
+    double const w22 = std::get<3>(weights);
+    bool const interp = shouldInterp(shape.getIxx(), shape.getIyy(), std::get<0>(weights).second);
+
+    double i0 = 0;  // amplitude of Gaussian
+    if (cached && cached->matches(ImageAdaptor<ImageT>().getImage(image), localCenter.getX(),
+                                  localCenter.getY(), bbox, 0.0, interp, w11, w12, w22,
+                                  chooseMomentsKernel(interp, control))) {
+        i0 = cached->I0;
+    } else if (calcmom<true>(ImageAdaptor<ImageT>().getImage(image), localCenter.getX(), localCenter.getY(),
+                             bbox, 0.0, interp, w11, w12, w22, &i0, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                             false, control) < 0) {
+        throw LSST_EXCEPT(pex::exceptions::RuntimeError, "Error from calcmom");
+    }
+
+    double const wArea = geom::PI * std::sqrt(shape.getDeterminant());
+
+    result.instFlux = i0 * 2 * wArea;
+
+    if (ImageAdaptor<ImageT>::hasVariance) {
+        int ix = static_cast<int>(center.getX() - image.getX0());
+        int iy = static_cast<int>(center.getY() - image.getY0());
+        if (!image.getBBox(afw::image::LOCAL).contains(geom::Point2I(ix, iy))) {
+            throw LSST_EXCEPT(pex::exceptions::RuntimeError,
+                              (boost::format("Center (%d,%d) not in image (%dx%d)") % ix % iy %
+                               image.getWidth() % image.getHeight())
+                                      .str());
+        }
+        double var = ImageAdaptor<ImageT>().getVariance(image, ix, iy);
+        double i0Err = std::sqrt(var / wArea);
+        result.instFluxErr = i0Err * 2 * wArea;
+    }
+
+    return result;
+}
+
 }  // namespace
 
 SdssShapeResult::SdssShapeResult()
         : instFlux_xx_Cov(std::numeric_limits<ErrElement>::quiet_NaN()),
           instFlux_yy_Cov(std::numeric_limits<ErrElement>::quiet_NaN()),
-          instFlux_xy_Cov(std::numeric_limits<ErrElement>::quiet_NaN()) {}
+          instFlux_xy_Cov(std::numeric_limits<ErrElement>::quiet_NaN()),
+          nIter(0),
+          bboxArea(0) {}
+
+SdssShapeBatchResult::SdssShapeBatchResult(std::size_t size)
+        : instFlux(ndarray::allocate(size)),
+          instFluxErr(ndarray::allocate(size)),
+          x(ndarray::allocate(size)),
+          y(ndarray::allocate(size)),
+          xErr(ndarray::allocate(size)),
+          yErr(ndarray::allocate(size)),
+          x_y_Cov(ndarray::allocate(size)),
+          xx(ndarray::allocate(size)),
+          yy(ndarray::allocate(size)),
+          xy(ndarray::allocate(size)),
+          xxErr(ndarray::allocate(size)),
+          yyErr(ndarray::allocate(size)),
+          xyErr(ndarray::allocate(size)),
+          xx_yy_Cov(ndarray::allocate(size)),
+          xx_xy_Cov(ndarray::allocate(size)),
+          yy_xy_Cov(ndarray::allocate(size)),
+          instFlux_xx_Cov(ndarray::allocate(size)),
+          instFlux_yy_Cov(ndarray::allocate(size)),
+          instFlux_xy_Cov(ndarray::allocate(size)),
+          nIter(ndarray::allocate(size)),
+          bboxArea(ndarray::allocate(size)),
+          flags(ndarray::allocate(size, SdssShapeAlgorithm::N_FLAGS)) {
+    SdssShapeResult const empty;
+    for (std::size_t i = 0; i < size; ++i) {
+        set(i, empty);
+    }
+}
+
+SdssShapeResult SdssShapeBatchResult::get(std::size_t i) const {
+    SdssShapeResult result;
+    result.instFlux = instFlux[i];
+    result.instFluxErr = instFluxErr[i];
+    result.x = x[i];
+    result.y = y[i];
+    result.xErr = xErr[i];
+    result.yErr = yErr[i];
+    result.x_y_Cov = x_y_Cov[i];
+    result.xx = xx[i];
+    result.yy = yy[i];
+    result.xy = xy[i];
+    result.xxErr = xxErr[i];
+    result.yyErr = yyErr[i];
+    result.xyErr = xyErr[i];
+    result.xx_yy_Cov = xx_yy_Cov[i];
+    result.xx_xy_Cov = xx_xy_Cov[i];
+    result.yy_xy_Cov = yy_xy_Cov[i];
+    result.instFlux_xx_Cov = instFlux_xx_Cov[i];
+    result.instFlux_yy_Cov = instFlux_yy_Cov[i];
+    result.instFlux_xy_Cov = instFlux_xy_Cov[i];
+    result.nIter = nIter[i];
+    result.bboxArea = bboxArea[i];
+    for (std::size_t j = 0; j < SdssShapeAlgorithm::N_FLAGS; ++j) {
+        result.flags[j] = flags[i][j];
+    }
+    return result;
+}
+
+void SdssShapeBatchResult::set(std::size_t i, SdssShapeResult const &result) {
+    instFlux[i] = result.instFlux;
+    instFluxErr[i] = result.instFluxErr;
+    x[i] = result.x;
+    y[i] = result.y;
+    xErr[i] = result.xErr;
+    yErr[i] = result.yErr;
+    x_y_Cov[i] = result.x_y_Cov;
+    xx[i] = result.xx;
+    yy[i] = result.yy;
+    xy[i] = result.xy;
+    xxErr[i] = result.xxErr;
+    yyErr[i] = result.yyErr;
+    xyErr[i] = result.xyErr;
+    xx_yy_Cov[i] = result.xx_yy_Cov;
+    xx_xy_Cov[i] = result.xx_xy_Cov;
+    yy_xy_Cov[i] = result.yy_xy_Cov;
+    instFlux_xx_Cov[i] = result.instFlux_xx_Cov;
+    instFlux_yy_Cov[i] = result.instFlux_yy_Cov;
+    instFlux_xy_Cov[i] = result.instFlux_xy_Cov;
+    nIter[i] = result.nIter;
+    bboxArea[i] = result.bboxArea;
+    for (std::size_t j = 0; j < SdssShapeAlgorithm::N_FLAGS; ++j) {
+        flags[i][j] = result.flags[j];
+    }
+}
 
 SdssShapeResultKey SdssShapeResultKey::addFields(afw::table::Schema &schema, std::string const &name,
                                                  bool doMeasurePsf) {
@@ -679,6 +1240,11 @@ SdssShapeResultKey SdssShapeResultKey::addFields(afw::table::Schema &schema, std
                                          schema.join(name, "instFlux") % schema.join(name, "xy"))
                                                 .str(),
                                         "count*pixel^2");
+    r._nIter = schema.addField<int>(schema.join(name, "nIter"),
+                                    "number of iterations used by the adaptive moments");
+    r._bboxArea = schema.addField<int>(schema.join(name, "bboxArea"),
+                                       "number of pixels in the final adaptive moments bounding box",
+                                       "pixel^2");
 
     // Skip the psf flag if not recording the PSF shape.
     if (r._includePsf) {
@@ -697,6 +1263,14 @@ SdssShapeResultKey::SdssShapeResultKey(afw::table::SubSchema const &s)
           _instFlux_xx_Cov(s["instFlux"]["xx"]["Cov"]),
           _instFlux_yy_Cov(s["instFlux"]["yy"]["Cov"]),
           _instFlux_xy_Cov(s["instFlux"]["xy"]["Cov"]) {
+    // The iteration count and bounding box area are missing from older catalogs.
+    try {
+        _nIter = s["nIter"];
+        _bboxArea = s["bboxArea"];
+    } catch (pex::exceptions::NotFoundError &e) {
+        _nIter = afw::table::Key<int>();
+        _bboxArea = afw::table::Key<int>();
+    }
     // The input SubSchema may optionally provide for a PSF.
     try {
         _psfShapeResult = afw::table::QuadrupoleKey(s["psf"]);
@@ -717,6 +1291,10 @@ SdssShapeResult SdssShapeResultKey::get(afw::table::BaseRecord const &record) co
     result.instFlux_xx_Cov = record.get(_instFlux_xx_Cov);
     result.instFlux_yy_Cov = record.get(_instFlux_yy_Cov);
     result.instFlux_xy_Cov = record.get(_instFlux_xy_Cov);
+    if (_nIter.isValid()) {
+        result.nIter = record.get(_nIter);
+        result.bboxArea = record.get(_bboxArea);
+    }
     for (size_t n = 0; n < SdssShapeAlgorithm::N_FLAGS; ++n) {
         if (n == SdssShapeAlgorithm::PSF_SHAPE_BAD.number && !_includePsf) continue;
         result.flags[n] = _flagHandler.getValue(record, n);
@@ -735,6 +1313,10 @@ void SdssShapeResultKey::set(afw::table::BaseRecord &record, SdssShapeResult con
     record.set(_instFlux_xx_Cov, value.instFlux_xx_Cov);
     record.set(_instFlux_yy_Cov, value.instFlux_yy_Cov);
     record.set(_instFlux_xy_Cov, value.instFlux_xy_Cov);
+    if (_nIter.isValid()) {
+        record.set(_nIter, value.nIter);
+        record.set(_bboxArea, value.bboxArea);
+    }
     for (size_t n = 0; n < SdssShapeAlgorithm::N_FLAGS; ++n) {
         if (n == SdssShapeAlgorithm::PSF_SHAPE_BAD.number && !_includePsf) continue;
         _flagHandler.setValue(record, n, value.flags[n]);
@@ -750,7 +1332,8 @@ bool SdssShapeResultKey::operator==(SdssShapeResultKey const &other) const {
     return _shapeResult == other._shapeResult && _centroidResult == other._centroidResult &&
            _instFluxResult == other._instFluxResult && _psfShapeResult == other._psfShapeResult &&
            _instFlux_xx_Cov == other._instFlux_xx_Cov && _instFlux_yy_Cov == other._instFlux_yy_Cov &&
-           _instFlux_xy_Cov == other._instFlux_xy_Cov;
+           _instFlux_xy_Cov == other._instFlux_xy_Cov && _nIter == other._nIter &&
+           _bboxArea == other._bboxArea;
     // don't bother with flags - if we've gotten this far, it's basically impossible the flags don't match
 }
 
@@ -761,134 +1344,242 @@ bool SdssShapeResultKey::isValid() const {
     // don't bother with flags - if we've gotten this far, it's basically impossible the flags are invalid
 }
 
+namespace {
+
+void checkInitialGuess(std::string const &initialGuess) {
+    if (initialGuess != "default" && initialGuess != "psf" && initialGuess != "shape") {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          (boost::format("Invalid initialGuess '%s'; must be 'default', 'psf' or 'shape'") %
+                           initialGuess)
+                                  .str());
+    }
+}
+
+}  // namespace
+
 SdssShapeAlgorithm::SdssShapeAlgorithm(Control const &ctrl, std::string const &name,
                                        afw::table::Schema &schema)
         : _ctrl(ctrl),
           _resultKey(ResultKey::addFields(schema, name, ctrl.doMeasurePsf)),
-          _centroidExtractor(schema, name) {}
+          _centroidExtractor(schema, name),
+          _name(name),
+          _metadata(nullptr),
+          _nIter(0),
+          _nWarmStart(0),
+          _nIterSaved(0) {
+    checkInitialGuess(ctrl.initialGuess);
+}
+
+SdssShapeAlgorithm::SdssShapeAlgorithm(Control const &ctrl, std::string const &name,
+                                       afw::table::Schema &schema, daf::base::PropertySet &metadata)
+        : SdssShapeAlgorithm(ctrl, name, schema) {
+    _metadata = &metadata;
+}
 
 template <typename ImageT>
 SdssShapeResult SdssShapeAlgorithm::computeAdaptiveMoments(ImageT const &image, geom::Point2D const &center,
                                                            bool negative, Control const &control) {
-    double xcen = center.getX();  // object's column position
-    double ycen = center.getY();  // object's row position
-
-    xcen -= image.getX0();  // work in image Pixel coordinates
-    ycen -= image.getY0();
+    return computeAdaptiveMomentsImpl(image, center, negative, control, nullptr);
+}
 
-    float shiftmax = control.maxShift;  // Max allowed centroid shift
-    if (shiftmax < 2) {
-        shiftmax = 2;
-    } else if (shiftmax > 10) {
-        shiftmax = 10;
-    }
+template <typename ImageT>
+SdssShapeResult SdssShapeAlgorithm::computeAdaptiveMoments(
+        ImageT const &image, geom::Point2D const &center, afw::geom::ellipses::Quadrupole const &initialShape,
+        bool negative, Control const &control) {
+    return computeAdaptiveMomentsImpl(image, center, negative, control, &initialShape);
+}
 
-    SdssShapeResult result;
-    try {
-        result.flags[FAILURE.number] =
-                !getAdaptiveMoments(image, control.background, xcen, ycen, shiftmax, &result, control.maxIter,
-                                    control.tol1, control.tol2, negative);
-    } catch (pex::exceptions::Exception &err) {
-        result.flags[FAILURE.number] = true;
-    }
-    if (result.flags[UNWEIGHTED.number] || result.flags[SHIFT.number]) {
-        // These are also considered fatal errors in terms of the quality of the results,
-        // even though they do produce some results.
-        result.flags[FAILURE.number] = true;
-    }
-    if (result.getQuadrupole().getIxx() * result.getQuadrupole().getIyy() <
-        (1.0 + 1.0e-6) * result.getQuadrupole().getIxy() * result.getQuadrupole().getIxy())
-    // We are checking that Ixx*Iyy > (1 + epsilon)*Ixy*Ixy where epsilon is suitably small. The
-    // value of epsilon used here is a magic number. DM-5801 is supposed to figure out if we are
-    // to keep this value.
-    {
-        if (!result.flags[FAILURE.number]) {
-            throw LSST_EXCEPT(pex::exceptions::LogicError,
-                              "Should not get singular moments unless a flag is set");
-        }
+template <typename ImageT>
+SdssShapeBatchResult SdssShapeAlgorithm::computeAdaptiveMomentsBatch(
+        ImageT const &image, std::vector<geom::Point2D> const &positions, bool negative,
+        Control const &control, int nThreads) {
+    std::size_t const size = positions.size();
+    SdssShapeBatchResult results(size);
+
+    if (nThreads <= 0) {
+        nThreads = std::max(1U, std::thread::hardware_concurrency());
     }
+    nThreads = std::max<std::size_t>(1, std::min<std::size_t>(nThreads, size));
 
-    // getAdaptiveMoments() just computes the zeroth moment in result.instFlux (and its error in
-    // result.instFluxErr, result.instFlux_xx_Cov, etc.)  That's related to the instFlux by some geometric
-    // factors, which we apply here.
-    double instFluxScale = computeFluxScale(result);
+    // Binned copies of the whole image, made if an object is large enough to need them
+    SharedMomentsPyramid pyramid;
 
-    result.instFlux *= instFluxScale;
-    result.instFluxErr *= instFluxScale;
-    result.x += image.getX0();
-    result.y += image.getY0();
+    // Objects are handed out one at a time, as their cost varies wildly with their size
+    std::atomic<std::size_t> next(0);
+    std::vector<std::exception_ptr> errors(nThreads);
+    auto worker = [&](int thread) {
+        try {
+            for (std::size_t i = next++; i < size; i = next++) {
+                try {
+                    results.set(i, computeAdaptiveMomentsImpl(image, positions[i], negative, control,
+                                                              nullptr, nullptr, &pyramid));
+                } catch (pex::exceptions::Exception &err) {
+                    SdssShapeResult failed;
+                    failed.flags[FAILURE.number] = true;
+                    results.set(i, failed);
+                }
+            }
+        } catch (...) {
+            errors[thread] = std::current_exception();
+            next = size;  // stop the other threads as soon as they finish their current object
+        }
+    };
 
-    if (ImageAdaptor<ImageT>::hasVariance) {
-        result.instFlux_xx_Cov *= instFluxScale;
-        result.instFlux_yy_Cov *= instFluxScale;
-        result.instFlux_xy_Cov *= instFluxScale;
+    std::vector<std::thread> threads;
+    threads.reserve(nThreads - 1);
+    for (int thread = 1; thread < nThreads; ++thread) {
+        threads.emplace_back(worker, thread);
+    }
+    worker(0);
+    for (auto &thread : threads) {
+        thread.join();
     }
 
-    return result;
+    for (auto const &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return results;
 }
 
 template <typename ImageT>
 FluxResult SdssShapeAlgorithm::computeFixedMomentsFlux(ImageT const &image,
                                                        afw::geom::ellipses::Quadrupole const &shape,
-                                                       geom::Point2D const &center) {
-    // while arguments to computeFixedMomentsFlux are in PARENT coordinates, the implementation is LOCAL.
-    geom::Point2D localCenter = center - geom::Extent2D(image.getXY0());
-
-    geom::BoxI const bbox = computeAdaptiveMomentsBBox(image.getBBox(afw::image::LOCAL), localCenter,
-                                                       shape.getIxx(), shape.getIxy(), shape.getIyy());
-
-    std::tuple<std::pair<bool, double>, double, double, double> weights =
-            getWeights(shape.getIxx(), shape.getIxy(), shape.getIyy());
+                                                       geom::Point2D const &center,
+                                                       Control const &control) {
+    return computeFixedMomentsFluxImpl(image, shape, center, control, nullptr);
+}
 
-    FluxResult result;
+template <typename ImageT>
+FluxResult SdssShapeAlgorithm::computeFixedMomentsFlux(ImageT const &image,
+                                                       afw::geom::ellipses::Quadrupole const &shape,
+                                                       geom::Point2D const &center, afw::table::RecordId id,
+                                                       Control const &control) {
+    // The sums are only used once, so they can't outlive the measurement of this record
+    FinalMomentSums const sums = lastMeasuredSums;
+    lastMeasuredSums.valid = false;
+
+    std::shared_ptr<void const> const imagePtr = ImageAdaptor<ImageT>().getImagePtr(image);
+    bool const sameImage = imagePtr && !imagePtr.owner_before(lastMeasuredImage) &&
+                           !lastMeasuredImage.owner_before(imagePtr);
+    return computeFixedMomentsFluxImpl(image, shape, center, control,
+                                       (id == lastMeasuredId && sameImage) ? &sums : nullptr);
+}
 
-    if (!std::get<0>(weights).first) {
-        throw pex::exceptions::InvalidParameterError("Input shape is singular");
+void SdssShapeAlgorithm::measure(afw::table::SourceRecord &measRecord,
+                                 afw::image::Exposure<float> const &exposure) const {
+    // The forced plugin is constructed with the same schema (and slots), so this can only be caught here
+    if (_ctrl.initialGuess == "shape" && measRecord.getTable()->getShapeSlot().isValid() &&
+        measRecord.getSchema().getAliasMap()->get(measRecord.getTable()->getShapeSlot().getAlias()) ==
+                _name) {
+        throw LSST_EXCEPT(FatalAlgorithmError,
+                          (boost::format("%s: initialGuess='shape' would start from the shape this algorithm "
+                                         "is measuring; use another shape slot, or only use it in forced "
+                                         "measurement") %
+                           _name)
+                                  .str());
     }
+    _measure(measRecord, exposure, nullptr);
+}
 
-    double const w11 = std::get<1>(weights);
-    double const w12 = std::get<2>(weights);
-    double const w22 = std::get<3>(weights);
-    bool const interp = shouldInterp(shape.getIxx(), shape.getIyy(), std::get<0>(weights).second);
-
-    double i0 = 0;  // amplitude of Gaussian
-    if (calcmom<true>(ImageAdaptor<ImageT>().getImage(image), localCenter.getX(), localCenter.getY(), bbox,
-                      0.0, interp, w11, w12, w22, &i0, NULL, NULL, NULL, NULL, NULL, NULL, NULL) < 0) {
-        throw LSST_EXCEPT(pex::exceptions::RuntimeError, "Error from calcmom");
+void SdssShapeAlgorithm::measureForced(afw::table::SourceRecord &measRecord,
+                                       afw::image::Exposure<float> const &exposure,
+                                       afw::table::SourceRecord const &refRecord,
+                                       afw::geom::SkyWcs const &refWcs) const {
+    if (_ctrl.initialGuess != "shape" || !exposure.getWcs() ||
+        !refRecord.getTable()->getShapeSlot().isValid() ||
+        !refRecord.getTable()->getCentroidSlot().isValid()) {
+        _measure(measRecord, exposure, nullptr);
+        return;
     }
 
-    double const wArea = geom::PI * std::sqrt(shape.getDeterminant());
-
-    result.instFlux = i0 * 2 * wArea;
-
-    if (ImageAdaptor<ImageT>::hasVariance) {
-        int ix = static_cast<int>(center.getX() - image.getX0());
-        int iy = static_cast<int>(center.getY() - image.getY0());
-        if (!image.getBBox(afw::image::LOCAL).contains(geom::Point2I(ix, iy))) {
-            throw LSST_EXCEPT(pex::exceptions::RuntimeError,
-                              (boost::format("Center (%d,%d) not in image (%dx%d)") % ix % iy %
-                               image.getWidth() % image.getHeight())
-                                      .str());
-        }
-        double var = ImageAdaptor<ImageT>().getVariance(image, ix, iy);
-        double i0Err = std::sqrt(var / wArea);
-        result.instFluxErr = i0Err * 2 * wArea;
+    // Start from the reference shape, transformed to the pixel frame of the exposure
+    std::unique_ptr<afw::geom::ellipses::Quadrupole> initialShape;
+    try {
+        auto const refToExposure = afw::geom::makeWcsPairTransform(refWcs, *exposure.getWcs());
+        geom::AffineTransform const local =
+                afw::geom::linearizeTransform(*refToExposure, refRecord.getCentroid());
+        initialShape.reset(new afw::geom::ellipses::Quadrupole(refRecord.getShape()));
+        initialShape->transformInPlace(local.getLinear());
+    } catch (pex::exceptions::Exception &err) {
+        initialShape.reset();
     }
-
-    return result;
+    _measure(measRecord, exposure, initialShape.get());
 }
 
-void SdssShapeAlgorithm::measure(afw::table::SourceRecord &measRecord,
-                                 afw::image::Exposure<float> const &exposure) const {
+void SdssShapeAlgorithm::_measure(afw::table::SourceRecord &measRecord,
+                                  afw::image::Exposure<float> const &exposure,
+                                  afw::geom::ellipses::Quadrupole const *initialShape) const {
+    // The final sums are kept, so that GaussianFlux can reuse them for this source
+    lastMeasuredId = measRecord.getId();
+    lastMeasuredImage = exposure.getMaskedImage().getImage();
+    lastMeasuredSums.valid = false;
+
     bool negative = false;
 
     try {
         negative = measRecord.get(measRecord.getSchema().find<afw::table::Flag>("flags_negative").key);
     } catch (pexExcept::Exception &e) {
     }
-    SdssShapeResult result = computeAdaptiveMoments(
-            exposure.getMaskedImage(), _centroidExtractor(measRecord, _resultKey.getFlagHandler()), negative,
-            _ctrl);
+    geom::Point2D const center = _centroidExtractor(measRecord, _resultKey.getFlagHandler());
+
+    PTR(afw::detection::Psf const) psf = exposure.getPsf();
+    if (psf && (!_psfCache || _psfCache->getPsf() != psf || _psfCache->getBBox() != exposure.getBBox())) {
+        _psfCache = PsfCache::get(psf, exposure.getBBox());
+    }
+
+    // Find the starting point of the iteration, unless we've been given one
+    afw::geom::ellipses::Quadrupole guess;
+    if (!initialShape && _ctrl.initialGuess == "psf") {
+        try {
+            if (psf) {
+                guess = _psfCache->computeShape(center, _ctrl.psfCacheSpacing, _ctrl.psfCacheTolerance);
+                initialShape = &guess;
+            }
+        } catch (pex::exceptions::Exception &err) {
+        }
+    } else if (!initialShape && _ctrl.initialGuess == "shape") {
+        if (measRecord.getTable()->getShapeSlot().isValid()) {
+            guess = measRecord.getShape();
+            initialShape = &guess;
+        }
+    }
+    if (initialShape && !isValidInitialShape(*initialShape)) {
+        initialShape = nullptr;
+    }
+
+    SdssShapeResult result = computeAdaptiveMomentsImpl(exposure.getMaskedImage(), center, negative, _ctrl,
+                                                        initialShape, &lastMeasuredSums);
+
+    if (_metadata) {
+        _nIter += result.nIter;
+        _metadata->set(_name + "_nIter", _nIter);
+        if (result.nIter >= static_cast<int>(_nIterHist.size())) {
+            _nIterHist.resize(result.nIter + 1, 0);
+        }
+        ++_nIterHist[result.nIter];
+        _metadata->set(_name + "_nIterHist", _nIterHist);
+        std::size_t areaBin = 0;  // floor(log2(bboxArea)), with 0 and 1 both in bin 0
+        while ((2L << areaBin) <= result.bboxArea) {
+            ++areaBin;
+        }
+        if (areaBin >= _bboxAreaHist.size()) {
+            _bboxAreaHist.resize(areaBin + 1, 0);
+        }
+        ++_bboxAreaHist[areaBin];
+        _metadata->set(_name + "_bboxAreaHist", _bboxAreaHist);
+        if (initialShape) {
+            ++_nWarmStart;
+            _metadata->set(_name + "_nWarmStart", _nWarmStart);
+            if (_ctrl.doCompareColdStart) {
+                SdssShapeResult const coldResult = computeAdaptiveMomentsImpl(
+                        exposure.getMaskedImage(), center, negative, _ctrl, nullptr);
+                _nIterSaved += coldResult.nIter - result.nIter;
+                _metadata->set(_name + "_nIterSaved", _nIterSaved);
+            }
+        }
+    }
 
     if (_ctrl.doMeasurePsf) {
         // Compute moments of Psf model.  In the interest of implementing this quickly, we're just
@@ -899,11 +1590,12 @@ void SdssShapeAlgorithm::measure(afw::table::SourceRecord &measRecord,
         // by making the measurements stored with shape.sdss always computed via the
         // SdssShapeAlgorithm instead of delegating to the Psf class.
         try {
-            PTR(afw::detection::Psf const) psf = exposure.getPsf();
             if (!psf) {
                 result.flags[PSF_SHAPE_BAD.number] = true;
             } else {
-                _resultKey.setPsfShape(measRecord, psf->computeShape(geom::Point2D(result.x, result.y)));
+                _resultKey.setPsfShape(
+                        measRecord, _psfCache->computeShape(geom::Point2D(result.x, result.y),
+                                                            _ctrl.psfCacheSpacing, _ctrl.psfCacheTolerance));
             }
         } catch (pex::exceptions::Exception &err) {
             result.flags[PSF_SHAPE_BAD.number] = true;
@@ -917,11 +1609,20 @@ void SdssShapeAlgorithm::fail(afw::table::SourceRecord &measRecord, MeasurementE
     _resultKey.getFlagHandler().handleFailure(measRecord, error);
 }
 
-#define INSTANTIATE_IMAGE(IMAGE)                                          \
-    template SdssShapeResult SdssShapeAlgorithm::computeAdaptiveMoments(  \
-            IMAGE const &, geom::Point2D const &, bool, Control const &); \
-    template FluxResult SdssShapeAlgorithm::computeFixedMomentsFlux(      \
-            IMAGE const &, afw::geom::ellipses::Quadrupole const &, geom::Point2D const &)
+#define INSTANTIATE_IMAGE(IMAGE)                                                                 \
+    template SdssShapeResult SdssShapeAlgorithm::computeAdaptiveMoments(                         \
+            IMAGE const &, geom::Point2D const &, bool, Control const &);                        \
+    template SdssShapeResult SdssShapeAlgorithm::computeAdaptiveMoments(                         \
+            IMAGE const &, geom::Point2D const &, afw::geom::ellipses::Quadrupole const &, bool, \
+            Control const &);                                                                    \
+    template SdssShapeBatchResult SdssShapeAlgorithm::computeAdaptiveMomentsBatch(               \
+            IMAGE const &, std::vector<geom::Point2D> const &, bool, Control const &, int);      \
+    template FluxResult SdssShapeAlgorithm::computeFixedMomentsFlux(                             \
+            IMAGE const &, afw::geom::ellipses::Quadrupole const &, geom::Point2D const &,       \
+            Control const &);                                                                    \
+    template FluxResult SdssShapeAlgorithm::computeFixedMomentsFlux(                             \
+            IMAGE const &, afw::geom::ellipses::Quadrupole const &, geom::Point2D const &,       \
+            afw::table::RecordId, Control const &)
 
 #define INSTANTIATE_PIXEL(PIXEL)                 \
     INSTANTIATE_IMAGE(afw::image::Image<PIXEL>); \
@@ -0,0 +1,395 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2019 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+
+/*
+ * Vectorized kernels for the SdssShape adaptive moments.
+ *
+ * Each instruction set gets its own copy of the kernel (SdssShapeKernelsImpl.h), compiled with the
+ * appropriate target attribute; the copy to use is chosen once per process from the CPU's capabilities.
+ * This keeps the library itself buildable for the baseline architecture.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <type_traits>
+
+#include "SdssShapeKernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define LSST_MEAS_BASE_MOMENTS_X86 1
+#include <immintrin.h>
+#else
+#define LSST_MEAS_BASE_MOMENTS_X86 0
+#endif
+
+namespace lsst {
+namespace meas {
+namespace base {
+namespace detail {
+
+#if LSST_MEAS_BASE_MOMENTS_X86
+
+namespace sse4 {
+
+#define MOMENTS_TARGET __attribute__((target("sse4.1")))
+
+int const VWIDTH = 4;
+typedef __m128 vf;
+typedef __m128d vd;
+typedef __m128 vmask;
+
+MOMENTS_TARGET inline vf load(float const* p) { return _mm_loadu_ps(p); }
+MOMENTS_TARGET inline vf set1(float a) { return _mm_set1_ps(a); }
+MOMENTS_TARGET inline vf add(vf a, vf b) { return _mm_add_ps(a, b); }
+MOMENTS_TARGET inline vd add(vd a, vd b) { return _mm_add_pd(a, b); }
+MOMENTS_TARGET inline vf sub(vf a, vf b) { return _mm_sub_ps(a, b); }
+MOMENTS_TARGET inline vf mul(vf a, vf b) { return _mm_mul_ps(a, b); }
+MOMENTS_TARGET inline vf maxv(vf a, vf b) { return _mm_max_ps(a, b); }
+MOMENTS_TARGET inline vf floorv(vf a) { return _mm_floor_ps(a); }
+MOMENTS_TARGET inline vf pow2n(vf n) {
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23));
+}
+MOMENTS_TARGET inline vmask lessEqual(vf a, vf b) { return _mm_cmple_ps(a, b); }
+MOMENTS_TARGET inline vf select(vmask m, vf a) { return _mm_and_ps(m, a); }
+MOMENTS_TARGET inline vd zerod() { return _mm_setzero_pd(); }
+MOMENTS_TARGET inline void accumulate(vd& lo, vd& hi, vf a) {
+    lo = _mm_add_pd(lo, _mm_cvtps_pd(a));
+    hi = _mm_add_pd(hi, _mm_cvtps_pd(_mm_movehl_ps(a, a)));
+}
+MOMENTS_TARGET inline double hsum(vd a) { return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a))); }
+
+#include "SdssShapeKernelsImpl.h"
+
+#undef MOMENTS_TARGET
+
+}  // namespace sse4
+
+namespace avx2 {
+
+#define MOMENTS_TARGET __attribute__((target("avx2,fma")))
+
+int const VWIDTH = 8;
+typedef __m256 vf;
+typedef __m256d vd;
+typedef __m256 vmask;
+
+MOMENTS_TARGET inline vf load(float const* p) { return _mm256_loadu_ps(p); }
+MOMENTS_TARGET inline vf set1(float a) { return _mm256_set1_ps(a); }
+MOMENTS_TARGET inline vf add(vf a, vf b) { return _mm256_add_ps(a, b); }
+MOMENTS_TARGET inline vd add(vd a, vd b) { return _mm256_add_pd(a, b); }
+MOMENTS_TARGET inline vf sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+MOMENTS_TARGET inline vf mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+MOMENTS_TARGET inline vf maxv(vf a, vf b) { return _mm256_max_ps(a, b); }
+MOMENTS_TARGET inline vf floorv(vf a) { return _mm256_floor_ps(a); }
+MOMENTS_TARGET inline vf pow2n(vf n) {
+    return _mm256_castsi256_ps(
+            _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23));
+}
+MOMENTS_TARGET inline vmask lessEqual(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+MOMENTS_TARGET inline vf select(vmask m, vf a) { return _mm256_and_ps(m, a); }
+MOMENTS_TARGET inline vd zerod() { return _mm256_setzero_pd(); }
+MOMENTS_TARGET inline void accumulate(vd& lo, vd& hi, vf a) {
+    lo = _mm256_add_pd(lo, _mm256_cvtps_pd(_mm256_castps256_ps128(a)));
+    hi = _mm256_add_pd(hi, _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)));
+}
+MOMENTS_TARGET inline double hsum(vd a) {
+    __m128d const s = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+#include "SdssShapeKernelsImpl.h"
+
+#undef MOMENTS_TARGET
+
+}  // namespace avx2
+
+namespace avx512 {
+
+#define MOMENTS_TARGET __attribute__((target("avx512f")))
+
+// The unmasked forms of many AVX-512 intrinsics pass _mm512_undefined_*() as the source of the masked-off
+// lanes (as do the casts to narrower vectors, which GCC implements as extractions), and GCC reports that as
+// uninitialized once they are inlined into a function with a target attribute.  The zero-masking forms
+// with every lane enabled compile to the same instructions without the warnings.
+MOMENTS_TARGET inline __m512d cvtps_pd(__m256 a) { return _mm512_maskz_cvtps_pd(0xFF, a); }
+MOMENTS_TARGET inline __m256d lower_pd(__m512d a) { return _mm512_maskz_extractf64x4_pd(0xF, a, 0); }
+MOMENTS_TARGET inline __m256d upper_pd(__m512d a) { return _mm512_maskz_extractf64x4_pd(0xF, a, 1); }
+
+int const VWIDTH = 16;
+typedef __m512 vf;
+typedef __m512d vd;
+typedef __mmask16 vmask;
+
+MOMENTS_TARGET inline vf load(float const* p) { return _mm512_loadu_ps(p); }
+MOMENTS_TARGET inline vf set1(float a) { return _mm512_set1_ps(a); }
+MOMENTS_TARGET inline vf add(vf a, vf b) { return _mm512_add_ps(a, b); }
+MOMENTS_TARGET inline vd add(vd a, vd b) { return _mm512_add_pd(a, b); }
+MOMENTS_TARGET inline vf sub(vf a, vf b) { return _mm512_sub_ps(a, b); }
+MOMENTS_TARGET inline vf mul(vf a, vf b) { return _mm512_mul_ps(a, b); }
+MOMENTS_TARGET inline vf maxv(vf a, vf b) { return _mm512_maskz_max_ps(0xFFFF, a, b); }
+MOMENTS_TARGET inline vf floorv(vf a) {
+    return _mm512_maskz_roundscale_ps(0xFFFF, a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+}
+MOMENTS_TARGET inline vf pow2n(vf n) {
+    __m512i const exponent = _mm512_add_epi32(_mm512_maskz_cvtps_epi32(0xFFFF, n), _mm512_set1_epi32(127));
+    return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(0xFFFF, exponent, 23));
+}
+MOMENTS_TARGET inline vmask lessEqual(vf a, vf b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+MOMENTS_TARGET inline vf select(vmask m, vf a) { return _mm512_maskz_mov_ps(m, a); }
+MOMENTS_TARGET inline vd zerod() { return _mm512_setzero_pd(); }
+MOMENTS_TARGET inline void accumulate(vd& lo, vd& hi, vf a) {
+    lo = _mm512_add_pd(lo, cvtps_pd(_mm256_castpd_ps(lower_pd(_mm512_castps_pd(a)))));
+    hi = _mm512_add_pd(hi, cvtps_pd(_mm256_castpd_ps(upper_pd(_mm512_castps_pd(a)))));
+}
+MOMENTS_TARGET inline double hsum(vd a) {
+    __m256d const s4 = _mm256_add_pd(lower_pd(a), upper_pd(a));
+    __m128d const s2 = _mm_add_pd(_mm256_castpd256_pd128(s4), _mm256_extractf128_pd(s4, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s2, _mm_unpackhi_pd(s2, s2)));
+}
+
+#include "SdssShapeKernelsImpl.h"
+
+#undef MOMENTS_TARGET
+
+}  // namespace avx512
+
+#endif  // LSST_MEAS_BASE_MOMENTS_X86
+
+MomentsIsa getMomentsIsa() {
+    static MomentsIsa const isa = []() {
+#if LSST_MEAS_BASE_MOMENTS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return MomentsIsa::AVX512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return MomentsIsa::AVX2;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+            return MomentsIsa::SSE4;
+        }
+#endif
+        return MomentsIsa::SCALAR;
+    }();
+    return isa;
+}
+
+char const* getMomentsIsaName(MomentsIsa isa) {
+    switch (isa) {
+        case MomentsIsa::AVX512:
+            return "avx512";
+        case MomentsIsa::AVX2:
+            return "avx2";
+        case MomentsIsa::SSE4:
+            return "sse4";
+        case MomentsIsa::SCALAR:
+            break;
+    }
+    return "scalar";
+}
+
+template <bool instFluxOnly, bool compensated>
+void accumulateMomentsRow(MomentsIsa isa, int n, float const* tmod, float const* x, float const* x2,
+                          float const* xpos, float y, float y2, float ypos, double w11, double w12,
+                          double w22, MomentSums& sums) {
+    switch (isa) {
+#if LSST_MEAS_BASE_MOMENTS_X86
+        case MomentsIsa::AVX512:
+            avx512::accumulateMomentsRow<instFluxOnly, compensated>(n, tmod, x, x2, xpos, y, y2, ypos, w11,
+                                                                    w12, w22, sums);
+            return;
+        case MomentsIsa::AVX2:
+            avx2::accumulateMomentsRow<instFluxOnly, compensated>(n, tmod, x, x2, xpos, y, y2, ypos, w11,
+                                                                  w12, w22, sums);
+            return;
+        case MomentsIsa::SSE4:
+            sse4::accumulateMomentsRow<instFluxOnly, compensated>(n, tmod, x, x2, xpos, y, y2, ypos, w11,
+                                                                  w12, w22, sums);
+            return;
+#endif
+        default:
+            break;
+    }
+    for (int j = 0; j < n; ++j) {
+        accumulateMomentsPixel<instFluxOnly>(tmod[j], x[j], x2[j], xpos[j], y, y2, ypos, w11, w12, w22, sums);
+    }
+}
+
+template <bool instFluxOnly>
+void accumulateMomentsRowRecurrence(int n, float const* tmod, float const* x, float const* x2,
+                                    float const* xpos, double x0, float y, float y2, float ypos, double w11,
+                                    double w12, double w22, MomentSums& sums) {
+    double const step = std::exp(-w11);  // r(x + 1)/r(x)
+    double const yTerm = w22 * y * y;
+    double const xyTerm = 2 * w12 * y;
+
+    for (int start = 0; start < n; start += MOMENTS_RECURRENCE_ANCHOR) {
+        int const end = std::min(n, start + MOMENTS_RECURRENCE_ANCHOR);
+        double const xs = x0 + start;
+        double weight = std::exp(-0.5 * (w11 * xs * xs + xyTerm * xs + yTerm));
+        double ratio = std::exp(-0.5 * (w11 * (2 * xs + 1) + xyTerm));
+
+        if (weight == 0.0 || !std::isfinite(ratio)) {
+            // the weights under- or overflow within this stretch; the recurrence would generate NaNs
+            for (int j = start; j < end; ++j) {
+                accumulateMomentsPixel<instFluxOnly>(tmod[j], x[j], x2[j], xpos[j], y, y2, ypos, w11, w12,
+                                                     w22, sums);
+            }
+            continue;
+        }
+
+        for (int j = start; j < end; ++j) {
+            float const xy = x[j] * y;
+            float const expon = x2[j] * w11 + 2 * xy * w12 + y2 * w22;
+            if (expon <= MOMENTS_MAX_EXPONENT) {
+                float const ymod = tmod[j] * static_cast<float>(weight);
+                addMomentsPixel<instFluxOnly>(ymod, x2[j], xy, xpos[j], y2, ypos, expon, sums);
+            }
+            weight *= ratio;
+            ratio *= step;
+        }
+    }
+}
+
+bool computeSubpixelMomentWeights(int col, int row, float xcen, float ycen, double w11, double w12,
+                                  double w22, SubpixelMomentWeights& weights) {
+    float const x = col - xcen;
+    float const y = row - ycen;
+    float const xl = x - 0.375;
+    float const xh = x + 0.375;
+    float const yl = y - 0.375;
+    float const yh = y + 0.375;
+
+    // The exponent is a convex function of position, so its maximum over the sub-pixels is at a corner
+    float expon = xl * xl * w11 + yl * yl * w22 + 2.0 * xl * yl * w12;
+    float tmp = xh * xh * w11 + yh * yh * w22 + 2.0 * xh * yh * w12;
+    expon = (expon > tmp) ? expon : tmp;
+    tmp = xl * xl * w11 + yh * yh * w22 + 2.0 * xl * yh * w12;
+    expon = (expon > tmp) ? expon : tmp;
+    tmp = xh * xh * w11 + yl * yl * w22 + 2.0 * xh * yl * w12;
+    expon = (expon > tmp) ? expon : tmp;
+
+    if (expon > MOMENTS_MAX_INTERP_EXPONENT) {
+        return false;
+    }
+
+    SubpixelMomentWeights m;
+    for (int iy = 0; iy < 4; ++iy) {
+        float const Y = yl + 0.25f * iy;
+        double const interpY2 = Y * Y;
+        for (int ix = 0; ix < 4; ++ix) {
+            float const X = xl + 0.25f * ix;
+            double const interpX2 = X * X;
+            double const interpXy = X * Y;
+            float const subExpon = interpX2 * w11 + 2 * interpXy * w12 + interpY2 * w22;
+            float const weight = std::exp(-0.5 * subExpon);
+
+            m.w += weight;
+            m.wx += weight * (X + xcen);
+            m.wy += weight * (Y + ycen);
+            m.wxx += interpX2 * weight;
+            m.wxy += interpXy * weight;
+            m.wyy += interpY2 * weight;
+            m.ws4 += subExpon * subExpon * weight;
+        }
+    }
+    weights = m;
+    return true;
+}
+
+SubpixelMomentsTable::SubpixelMomentsTable(int ix0, int ix1, int iy0, int iy1, float xcen, float ycen,
+                                           double w11, double w12, double w22)
+        : _ix0(ix0),
+          _ix1(ix1),
+          _iy0(iy0),
+          _iy1(iy1),
+          _width(ix1 - ix0 + 1),
+          _xcen(xcen),
+          _ycen(ycen),
+          _w11(w11),
+          _w12(w12),
+          _w22(w22),
+          _pixels(static_cast<std::size_t>(_width) * (iy1 - iy0 + 1)) {
+    auto pixel = _pixels.begin();
+    for (int i = iy0; i <= iy1; ++i) {
+        for (int j = ix0; j <= ix1; ++j, ++pixel) {
+            computeSubpixelMomentWeights(j, i, xcen, ycen, w11, w12, w22, *pixel);
+        }
+    }
+}
+
+bool SubpixelMomentsTable::matches(int ix0, int ix1, int iy0, int iy1, float xcen, float ycen, double w11,
+                                   double w12, double w22) const {
+    return ix0 == _ix0 && ix1 == _ix1 && iy0 == _iy0 && iy1 == _iy1 && xcen == _xcen && ycen == _ycen &&
+           w11 == _w11 && w12 == _w12 && w22 == _w22;
+}
+
+std::shared_ptr<SubpixelMomentsTable const> getSubpixelMomentsTable(int ix0, int ix1, int iy0, int iy1,
+                                                                   float xcen, float ycen, double w11,
+                                                                   double w12, double w22) {
+    if (static_cast<long>(ix1 - ix0 + 1) * (iy1 - iy0 + 1) > MOMENTS_MAX_TABLE_PIXELS) {
+        return nullptr;
+    }
+
+    // Most recently used first, using cacheBytes of memory
+    static thread_local std::list<std::shared_ptr<SubpixelMomentsTable const>> cache;
+    static thread_local std::size_t cacheBytes = 0;
+    for (auto iter = cache.begin(); iter != cache.end(); ++iter) {
+        if ((*iter)->matches(ix0, ix1, iy0, iy1, xcen, ycen, w11, w12, w22)) {
+            cache.splice(cache.begin(), cache, iter);
+            return cache.front();
+        }
+    }
+
+    cache.push_front(
+            std::make_shared<SubpixelMomentsTable const>(ix0, ix1, iy0, iy1, xcen, ycen, w11, w12, w22));
+    cacheBytes += cache.front()->getBytes();
+    while (cacheBytes > MOMENTS_TABLE_CACHE_BYTES && cache.size() > 1) {
+        cacheBytes -= cache.back()->getBytes();
+        cache.pop_back();
+    }
+    return cache.front();
+}
+
+#define INSTANTIATE_ROW(INSTFLUXONLY, COMPENSATED)                                                       \
+    template void accumulateMomentsRow<INSTFLUXONLY, COMPENSATED>(                                        \
+            MomentsIsa, int, float const*, float const*, float const*, float const*, float, float, float, \
+            double, double, double, MomentSums&)
+
+INSTANTIATE_ROW(true, false);
+INSTANTIATE_ROW(false, false);
+INSTANTIATE_ROW(true, true);
+INSTANTIATE_ROW(false, true);
+
+template void accumulateMomentsRowRecurrence<true>(int, float const*, float const*, float const*,
+                                                   float const*, double, float, float, float, double, double,
+                                                   double, MomentSums&);
+template void accumulateMomentsRowRecurrence<false>(int, float const*, float const*, float const*,
+                                                    float const*, double, float, float, float, double, double,
+                                                    double, MomentSums&);
+
+}  // namespace detail
+}  // namespace base
+}  // namespace meas
+}  // namespace lsst
@@ -0,0 +1,315 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2019 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#ifndef LSST_MEAS_BASE_SdssShapeKernels_h_INCLUDED
+#define LSST_MEAS_BASE_SdssShapeKernels_h_INCLUDED
+
+/*
+ * Private header: pixel kernels used by SdssShape.cc to accumulate Gaussian-weighted moments.
+ *
+ * Nothing here depends on afw; the kernels work on rows of single-precision pixel values, so the
+ * caller is responsible for subtracting the background and converting the pixel type.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace lsst {
+namespace meas {
+namespace base {
+namespace detail {
+
+/// Running sums of the weighted moments of an object up to 2nd order
+struct MomentSums {
+    double sum = 0.0;    ///< sum w*I
+    double sumx = 0.0;   ///< sum x*w*I
+    double sumy = 0.0;   ///< sum y*w*I
+    double sumxx = 0.0;  ///< sum x^2*w*I
+    double sumxy = 0.0;  ///< sum xy*w*I
+    double sumyy = 0.0;  ///< sum y^2*w*I
+    double sums4 = 0.0;  ///< sum w*I*exponent^2
+};
+
+/// Instruction sets for which a vectorized moments kernel is available, worst to best.
+enum class MomentsIsa { SCALAR = 0, SSE4, AVX2, AVX512 };
+
+/// Return the best instruction set supported by both this build and the CPU we are running on.
+MomentsIsa getMomentsIsa();
+
+/// Return a human-readable name for a MomentsIsa (for logs and benchmarks).
+char const* getMomentsIsaName(MomentsIsa isa);
+
+/// Pixels with exponent larger than this are ignored by the non-interpolated kernel (weight < 1e-3).
+float const MOMENTS_MAX_EXPONENT = 14.0;
+
+/// Add a pixel of weighted intensity ymod = w*I, whose weight has exponent expon, to the moments sums.
+template <bool instFluxOnly>
+inline void addMomentsPixel(float ymod, float x2, float xy, float xpos, float y2, float ypos, float expon,
+                            MomentSums& sums) {
+    sums.sum += ymod;
+    if (!instFluxOnly) {
+        sums.sumx += ymod * xpos;
+        sums.sumy += ymod * ypos;
+        sums.sumxx += x2 * ymod;
+        sums.sumxy += xy * ymod;
+        sums.sumyy += y2 * ymod;
+        sums.sums4 += expon * expon * ymod;
+    }
+}
+
+/*
+ * Accumulate a single pixel into the moments sums.
+ *
+ * This is the scalar reference: all intermediate quantities are rounded to single precision exactly
+ * as in the original SDSS code, and only the sums are kept in double precision.
+ */
+template <bool instFluxOnly>
+inline void accumulateMomentsPixel(float tmod, float x, float x2, float xpos, float y, float y2, float ypos,
+                                   double w11, double w12, double w22, MomentSums& sums) {
+    float const xy = x * y;
+    float const expon = x2 * w11 + 2 * xy * w12 + y2 * w22;
+
+    if (expon <= MOMENTS_MAX_EXPONENT) {
+        float const weight = std::exp(-0.5 * expon);
+        addMomentsPixel<instFluxOnly>(tmod * weight, x2, xy, xpos, y2, ypos, expon, sums);
+    }
+}
+
+/// Number of pixels between recomputations of the weight in accumulateMomentsRowRecurrence.
+int const MOMENTS_RECURRENCE_ANCHOR = 16;
+
+/// Alignment of row spans that leaves the sums unchanged: a multiple of every vector width, and of
+/// MOMENTS_RECURRENCE_ANCHOR.
+int const MOMENTS_SPAN_ALIGN = 16;
+
+/**
+ *  Find the span of a row of pixels that can pass the MOMENTS_MAX_EXPONENT cutoff.
+ *
+ *  @param[in]  ix0,ix1  First and last columns of the row.
+ *  @param[in]  xcen     Column of the object's centre.
+ *  @param[in]  y        Row offset from the object's centre.
+ *  @param[in]  w11,w12,w22  Elements of the inverse covariance of the Gaussian weight.
+ *  @param[out] begin,end  First and last columns of the span, within [ix0, ix1].
+ *  @param[in]  align  The span is widened so that begin - ix0 and end + 1 - ix0 are multiples of this
+ *                     (unless end == ix1).
+ *  @returns false if no pixel of the row can pass the cutoff.
+ *
+ *  Along a row the exponent w11 x^2 + 2 w12 x y + w22 y^2 is a quadratic in x, so the pixels within
+ *  the cutoff form a single span, whose ends are found analytically.  The kernels evaluate the exponent
+ *  in single precision, so the cutoff is relaxed by a bound on that rounding error and the span widened
+ *  by a pixel at each end: every pixel outside the span is one the kernels would have ignored, so
+ *  restricting them to the span doesn't change the sums.  If the weights aren't positive definite (e.g.
+ *  they are all zero, for unweighted moments) the whole row is returned.
+ *
+ *  With align = MOMENTS_SPAN_ALIGN each pixel of the span is handled by the same vector lane (or with
+ *  the same recurrence anchor) as it would be if the whole row were passed to the kernels, so the sums
+ *  are unchanged bit for bit.
+ */
+inline bool getMomentsRowSpan(int ix0, int ix1, double xcen, float y, double w11, double w12, double w22,
+                              int& begin, int& end, int align = 1) {
+    begin = ix0;
+    end = ix1;
+    if (!(w11 > 0) || !(w11 * w22 > w12 * w12)) {
+        return ix0 <= ix1;
+    }
+    double const xmax = std::fmax(std::fabs(ix0 - xcen), std::fabs(ix1 - xcen)) + 1;
+    double const slop = 1e-5 * (w11 * xmax * xmax + 2 * std::fabs(w12 * y) * xmax + w22 * y * y) + 1e-5;
+    double const cutoff = MOMENTS_MAX_EXPONENT + slop;
+    // Solve w11 x^2 + 2 w12 y x + (w22 y^2 - cutoff) = 0
+    double const b = w12 * y;
+    double const disc = b * b - w11 * (w22 * y * y - cutoff);
+    if (disc < 0) {
+        return false;
+    }
+    double const root = std::sqrt(disc);
+    double const xlo = (-b - root) / w11 + xcen;
+    double const xhi = (-b + root) / w11 + xcen;
+    if (xlo > ix1 + 1 || xhi < ix0 - 1) {
+        return false;
+    }
+    if (xlo > ix0 + 1) {
+        begin = static_cast<int>(std::floor(xlo)) - 1;
+        begin = ix0 + (begin - ix0) / align * align;
+    }
+    if (xhi < ix1 - 1) {
+        end = static_cast<int>(std::ceil(xhi)) + 1;
+        end = std::min(ix1, ix0 + ((end - ix0) / align + 1) * align - 1);
+    }
+    return begin <= end;
+}
+
+/**
+ *  Accumulate the weighted moments of one row of pixels (non-interpolated weights).
+ *
+ *  All arrays have n elements and describe the pixels of a single row:
+ *
+ *  @param[in]  isa    Instruction set to use; must not be better than getMomentsIsa().
+ *  @param[in]  n      Number of pixels in the row.
+ *  @param[in]  tmod   Background-subtracted pixel values.
+ *  @param[in]  x      Column offsets from the object's centre, x[j] = float(col - xcen).
+ *  @param[in]  x2     x[j]*x[j], rounded to single precision.
+ *  @param[in]  xpos   Column index of each pixel.
+ *  @param[in]  y      Row offset from the object's centre.
+ *  @param[in]  y2     y*y, rounded to single precision.
+ *  @param[in]  ypos   Row index.
+ *  @param[in]  w11,w12,w22  Elements of the inverse covariance of the Gaussian weight.
+ *  @param[in,out] sums  Sums to accumulate into.
+ *
+ *  The vectorized versions evaluate the exponent and the weight in single precision (the weight with a
+ *  polynomial approximation to exp accurate to 2 ulp) and accumulate in double precision.  Compared to
+ *  the scalar kernel the sums agree to a relative precision of ~1e-6; the only larger differences come
+ *  from pixels whose exponent is within rounding error of MOMENTS_MAX_EXPONENT, whose weight is ~1e-3.
+ *
+ *  If compensated is true the vectorized versions instead accumulate each row in single precision with
+ *  Kahan compensation (saving the conversions to double), and only the row totals are added in double
+ *  precision; the sums then agree with the double-precision accumulation to ~1e-7.  The scalar version
+ *  always accumulates in double precision.
+ */
+template <bool instFluxOnly, bool compensated = false>
+void accumulateMomentsRow(MomentsIsa isa, int n, float const* tmod, float const* x, float const* x2,
+                          float const* xpos, float y, float y2, float ypos, double w11, double w12,
+                          double w22, MomentSums& sums);
+
+
+/**
+ *  Accumulate the weighted moments of one row of pixels, generating the weights by recurrence.
+ *
+ *  Along a row the exponent of the Gaussian weight is a quadratic in x, so the weight of each pixel is
+ *  that of its left neighbour times a ratio that itself changes by the constant factor exp(-w11):
+ *
+ *      w(x + 1) = w(x) r(x),   r(x + 1) = r(x) exp(-w11).
+ *
+ *  Both are evaluated directly (two calls to exp) every MOMENTS_RECURRENCE_ANCHOR pixels, and stepped
+ *  in double precision in between, so the accumulated error is a few double-precision ulp: negligible
+ *  compared to the single-precision rounding of the weights in the scalar kernel.  The exponent itself
+ *  (needed for the cutoff and for sums4) is still computed per pixel exactly as in the scalar kernel.
+ *
+ *  The arguments are as for accumulateMomentsRow, plus
+ *
+ *  @param[in]  x0     The offset from the object's centre of the first pixel, in double precision.
+ */
+template <bool instFluxOnly>
+void accumulateMomentsRowRecurrence(int n, float const* tmod, float const* x, float const* x2,
+                                    float const* xpos, double x0, float y, float y2, float ypos, double w11,
+                                    double w12, double w22, MomentSums& sums);
+
+/// Pixels whose weight exponent exceeds this at any corner are ignored by the interpolated kernel.
+float const MOMENTS_MAX_INTERP_EXPONENT = 9.0;
+
+/// Sums of the Gaussian weight (and of the weight times the moments) over a pixel's 4x4 sub-pixel grid.
+struct SubpixelMomentWeights {
+    double w = 0.0;    ///< sum w
+    double wx = 0.0;   ///< sum w*X, with X the column of the sub-pixel
+    double wy = 0.0;   ///< sum w*Y, with Y the row of the sub-pixel
+    double wxx = 0.0;  ///< sum w*dX^2, with dX = X - xcen
+    double wxy = 0.0;  ///< sum w*dX*dY
+    double wyy = 0.0;  ///< sum w*dY^2
+    double ws4 = 0.0;  ///< sum w*exponent^2
+};
+
+/**
+ *  Compute the sub-pixel weight sums of the pixel (col, row).
+ *
+ *  The sub-pixels are at offsets of -0.375, -0.125, 0.125 and 0.375 from the pixel centre.  If the
+ *  exponent of the weight exceeds MOMENTS_MAX_INTERP_EXPONENT at any of the outer sub-pixels the pixel
+ *  is ignored: false is returned and weights is left untouched.
+ */
+bool computeSubpixelMomentWeights(int col, int row, float xcen, float ycen, double w11, double w12,
+                                  double w22, SubpixelMomentWeights& weights);
+
+/// Accumulate a pixel with background-subtracted value tmod and sub-pixel weight sums m.
+template <bool instFluxOnly>
+inline void addSubpixelMomentsPixel(double tmod, SubpixelMomentWeights const& m, MomentSums& sums) {
+    sums.sum += tmod * m.w;
+    if (!instFluxOnly) {
+        sums.sumx += tmod * m.wx;
+        sums.sumy += tmod * m.wy;
+        sums.sumxx += tmod * m.wxx;
+        sums.sumxy += tmod * m.wxy;
+        sums.sumyy += tmod * m.wyy;
+        sums.sums4 += tmod * m.ws4;
+    }
+}
+
+/**
+ *  The sub-pixel weight sums of every pixel of a box, for a given weight matrix and centre.
+ *
+ *  Pixels that computeSubpixelMomentWeights ignores have all-zero sums (every pixel that it does not
+ *  ignore has w > 0).
+ */
+class SubpixelMomentsTable {
+public:
+    SubpixelMomentsTable(int ix0, int ix1, int iy0, int iy1, float xcen, float ycen, double w11, double w12,
+                         double w22);
+
+    /**
+     *  Does this table apply to the given box, centre and weights?
+     *
+     *  The weights are compared exactly, as computeSubpixelMomentWeights uses them in double precision:
+     *  a table found by a lookup is always the one that would be computed.
+     */
+    bool matches(int ix0, int ix1, int iy0, int iy1, float xcen, float ycen, double w11, double w12,
+                 double w22) const;
+
+    /// Return the sums for the pixels ix0 to ix1 of the given row (in the same coordinates as iy0, iy1)
+    SubpixelMomentWeights const* getRow(int row) const { return &_pixels[(row - _iy0) * _width]; }
+
+    /// Return the memory used by the sums, in bytes
+    std::size_t getBytes() const { return _pixels.size() * sizeof(SubpixelMomentWeights); }
+
+private:
+    int _ix0, _ix1, _iy0, _iy1, _width;
+    float _xcen, _ycen;
+    double _w11, _w12, _w22;
+    std::vector<SubpixelMomentWeights> _pixels;
+};
+
+/// Boxes with more pixels than this (a table of 896 kB) are never tabulated by getSubpixelMomentsTable.
+int const MOMENTS_MAX_TABLE_PIXELS = 1 << 14;
+
+/// The most memory used by the tables getSubpixelMomentsTable keeps for each thread, in bytes.
+std::size_t const MOMENTS_TABLE_CACHE_BYTES = 2 << 20;
+
+/**
+ *  Return the table of sub-pixel weight sums for a box, centre and weights.
+ *
+ *  The most recently used tables are kept in a small per-thread cache, so the table is only computed
+ *  once when the same weights are used repeatedly (e.g. to recompute the moments at the same centre).
+ *  The least recently used tables are dropped once those of a thread use more than
+ *  MOMENTS_TABLE_CACHE_BYTES (the cache holds at least two of the largest tables), and the memory is
+ *  held until the thread exits.  Returns a null pointer if the box has more than
+ *  MOMENTS_MAX_TABLE_PIXELS pixels; the caller should then call computeSubpixelMomentWeights for each
+ *  pixel.
+ */
+std::shared_ptr<SubpixelMomentsTable const> getSubpixelMomentsTable(int ix0, int ix1, int iy0, int iy1,
+                                                                   float xcen, float ycen, double w11,
+                                                                   double w12, double w22);
+
+}  // namespace detail
+}  // namespace base
+}  // namespace meas
+}  // namespace lsst
+
+#endif  // !LSST_MEAS_BASE_SdssShapeKernels_h_INCLUDED
@@ -0,0 +1,151 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2019 AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+
+/*
+ * Body of the vectorized moments kernel.
+ *
+ * This file is deliberately not include-guarded: SdssShapeKernels.cc includes it once per instruction
+ * set, inside a namespace that provides the following (all functions carrying MOMENTS_TARGET so that
+ * they inline into each other):
+ *
+ *   VWIDTH                          number of float lanes
+ *   vf                              a vector of VWIDTH floats
+ *   vd                              a vector of VWIDTH/2 doubles
+ *   vmask                           the result of a comparison
+ *   load(p), set1(a)                load VWIDTH floats / broadcast a scalar
+ *   add, sub, mul, maxv             arithmetic (add is also defined for vd)
+ *   floorv(a)                       round towards -infinity
+ *   pow2n(n)                        2^n for integral-valued n in [-126, 127]
+ *   lessEqual(a, b), select(m, a)   comparison, and a with the lanes where m is false zeroed
+ *   zerod(), accumulate(lo, hi, a)  add the low and high halves of a to two double vectors
+ *   hsum(a)                         horizontal sum of a double vector
+ */
+
+// Single-precision exp, after Cephes' expf; relative error < 2 ulp for -87 < x < 88
+MOMENTS_TARGET inline vf expv(vf x) {
+    x = maxv(x, set1(-87.0f));
+    vf const n = floorv(add(mul(x, set1(1.44269504088896341f)), set1(0.5f)));
+    x = sub(x, mul(n, set1(0.693359375f)));
+    x = sub(x, mul(n, set1(-2.12194440e-4f)));
+
+    vf y = set1(1.9875691500e-4f);
+    y = add(mul(y, x), set1(1.3981999507e-3f));
+    y = add(mul(y, x), set1(8.3334519073e-3f));
+    y = add(mul(y, x), set1(4.1665795894e-2f));
+    y = add(mul(y, x), set1(1.6666665459e-1f));
+    y = add(mul(y, x), set1(5.0000001201e-1f));
+    y = add(add(mul(y, mul(x, x)), x), set1(1.0f));
+
+    return mul(y, pow2n(n));
+}
+
+// Sums VWIDTH lanes of floats in double precision
+class DoubleAccumulator {
+public:
+    MOMENTS_TARGET DoubleAccumulator() : _lo(zerod()), _hi(zerod()) {}
+
+    MOMENTS_TARGET void push(vf a) { accumulate(_lo, _hi, a); }
+
+    MOMENTS_TARGET double total() const { return hsum(add(_lo, _hi)); }
+
+private:
+    vd _lo, _hi;
+};
+
+// Sums VWIDTH lanes of floats in single precision with Kahan compensation, which keeps the error of
+// each lane's sum to a couple of ulp of the sum (rather than growing with the number of terms).  This
+// relies on the compiler not reassociating floating-point arithmetic (i.e. no -ffast-math).
+class CompensatedAccumulator {
+public:
+    MOMENTS_TARGET CompensatedAccumulator() : _sum(set1(0.0f)), _error(set1(0.0f)) {}
+
+    MOMENTS_TARGET void push(vf a) {
+        vf const corrected = sub(a, _error);
+        vf const sum = add(_sum, corrected);
+        _error = sub(sub(sum, _sum), corrected);
+        _sum = sum;
+    }
+
+    MOMENTS_TARGET double total() const {
+        vd lo = zerod(), hi = zerod();
+        accumulate(lo, hi, _sum);
+        accumulate(lo, hi, sub(set1(0.0f), _error));
+        return hsum(add(lo, hi));
+    }
+
+private:
+    vf _sum, _error;
+};
+
+template <bool instFluxOnly, bool compensated>
+MOMENTS_TARGET void accumulateMomentsRow(int n, float const* tmod, float const* x, float const* x2,
+                                         float const* xpos, float y, float y2, float ypos, double w11,
+                                         double w12, double w22, MomentSums& sums) {
+    typedef typename std::conditional<compensated, CompensatedAccumulator, DoubleAccumulator>::type
+            Accumulator;
+
+    vf const vy = set1(y);
+    vf const vy2 = set1(y2);
+    vf const vypos = set1(ypos);
+    vf const vw11 = set1(w11);
+    vf const vw12x2 = set1(2.0 * w12);
+    vf const vw22y2 = mul(vy2, set1(w22));
+    vf const maxExpon = set1(MOMENTS_MAX_EXPONENT);
+    vf const minusHalf = set1(-0.5f);
+
+    Accumulator sum, sumx, sumy, sumxx, sumxy, sumyy, sums4;
+
+    int j = 0;
+    for (; j + VWIDTH <= n; j += VWIDTH) {
+        vf const vx2 = load(x2 + j);
+        vf const vxy = mul(load(x + j), vy);
+        vf const expon = add(add(mul(vx2, vw11), mul(vxy, vw12x2)), vw22y2);
+        vmask const inside = lessEqual(expon, maxExpon);
+        vf const ymod = select(inside, mul(load(tmod + j), expv(mul(minusHalf, expon))));
+
+        sum.push(ymod);
+        if (!instFluxOnly) {
+            sumx.push(mul(ymod, load(xpos + j)));
+            sumy.push(mul(ymod, vypos));
+            sumxx.push(mul(vx2, ymod));
+            sumxy.push(mul(vxy, ymod));
+            sumyy.push(mul(vy2, ymod));
+            sums4.push(mul(mul(expon, expon), ymod));
+        }
+    }
+
+    sums.sum += sum.total();
+    if (!instFluxOnly) {
+        sums.sumx += sumx.total();
+        sums.sumy += sumy.total();
+        sums.sumxx += sumxx.total();
+        sums.sumxy += sumxy.total();
+        sums.sumyy += sumyy.total();
+        sums.sums4 += sums4.total();
+    }
+
+    for (; j < n; ++j) {
+        accumulateMomentsPixel<instFluxOnly>(tmod[j], x[j], x2[j], xpos[j], y, y2, ypos, w11, w12, w22,
+                                             sums);
+    }
+}
@@ -21,12 +21,21 @@
  * see <http://www.lsstcorp.org/LegalNotices/>.
  */
 
+#include <cmath>
 #include <complex>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 
+#include <unistd.h>
+
+#include "boost/format.hpp"
 #include "boost/math/special_functions/bessel.hpp"
-#include "boost/shared_array.hpp"
 #include "fftw3.h"
 
+#include "lsst/pex/exceptions.h"
 #include "lsst/meas/base/SincCoeffs.h"
 #include "lsst/geom/Angle.h"
 #include "lsst/geom/Extent.h"
@@ -38,6 +47,171 @@ namespace meas {
 namespace base {
 namespace {
 
+// FFTW's planner is not thread-safe: all plans must be made and destroyed, and wisdom imported and
+// exported, while holding this
+std::mutex fftwPlannerMutex;
+
+// The FFTW interface in the precision of each pixel type
+template <typename PixelT>
+struct Fftw;
+
+template <>
+struct Fftw<double> {
+    typedef double Real;
+    typedef fftw_complex Complex;
+    typedef fftw_plan Plan;
+
+    static Plan planDft2d(int n, Complex* data, unsigned flags) {
+        return fftw_plan_dft_2d(n, n, data, data, FFTW_BACKWARD, flags);
+    }
+    static Plan planR2hc2d(int n, Real* data, unsigned flags) {
+        return fftw_plan_r2r_2d(n, n, data, data, FFTW_R2HC, FFTW_R2HC, flags);
+    }
+    static void executeDft(Plan plan, Complex* data) { fftw_execute_dft(plan, data, data); }
+    static void executeR2r(Plan plan, Real* data) { fftw_execute_r2r(plan, data, data); }
+    static void destroy(Plan plan) { fftw_destroy_plan(plan); }
+    static void* malloc(std::size_t size) { return fftw_malloc(size); }
+    static void free(void* data) { fftw_free(data); }
+    static int importWisdom(char const* filename) { return fftw_import_wisdom_from_filename(filename); }
+    static int exportWisdom(char const* filename) { return fftw_export_wisdom_to_filename(filename); }
+    static char const* wisdomSuffix() { return "-double"; }
+};
+
+template <>
+struct Fftw<float> {
+    typedef float Real;
+    typedef fftwf_complex Complex;
+    typedef fftwf_plan Plan;
+
+    static Plan planDft2d(int n, Complex* data, unsigned flags) {
+        return fftwf_plan_dft_2d(n, n, data, data, FFTW_BACKWARD, flags);
+    }
+    static Plan planR2hc2d(int n, Real* data, unsigned flags) {
+        return fftwf_plan_r2r_2d(n, n, data, data, FFTW_R2HC, FFTW_R2HC, flags);
+    }
+    static void executeDft(Plan plan, Complex* data) { fftwf_execute_dft(plan, data, data); }
+    static void executeR2r(Plan plan, Real* data) { fftwf_execute_r2r(plan, data, data); }
+    static void destroy(Plan plan) { fftwf_destroy_plan(plan); }
+    static void* malloc(std::size_t size) { return fftwf_malloc(size); }
+    static void free(void* data) { fftwf_free(data); }
+    static int importWisdom(char const* filename) { return fftwf_import_wisdom_from_filename(filename); }
+    static int exportWisdom(char const* filename) { return fftwf_export_wisdom_to_filename(filename); }
+    static char const* wisdomSuffix() { return "-float"; }
+};
+
+// An array allocated by FFTW (and hence aligned as FFTW's plans expect)
+template <typename PixelT, typename T>
+std::unique_ptr<T, void (*)(void*)> makeFftwArray(std::size_t size) {
+    T* data = static_cast<T*>(Fftw<PixelT>::malloc(size * sizeof(T)));
+    if (!data) {
+        throw std::bad_alloc();
+    }
+    return std::unique_ptr<T, void (*)(void*)>(data, &Fftw<PixelT>::free);
+}
+
+/*
+ * The in-place FFTW plans for each transform size, shared by all threads
+ *
+ * Plans are made once, on scratch arrays, and executed with FFTW's new-array interface, which may be
+ * used concurrently on any arrays allocated by FFTW.  They are never destroyed before the end of the
+ * process, as another thread may be executing them.
+ */
+template <typename PixelT>
+class FftwPlans {
+public:
+    typedef typename Fftw<PixelT>::Plan Plan;
+
+    static FftwPlans& getInstance() {
+        static FftwPlans instance;
+        return instance;
+    }
+
+    // Plan a backward complex transform of an n x n array
+    Plan getComplexPlan(int n) { return _getPlan(n, true); }
+
+    // Plan a real-to-halfcomplex transform of an n x n array
+    Plan getRealPlan(int n) { return _getPlan(n, false); }
+
+    // Set the planning; if `require`, throw rather than replace a different wisdom file
+    void configure(bool measure, std::string const& wisdomFile, bool require) {
+        std::lock_guard<std::mutex> lock(fftwPlannerMutex);
+        std::string const filename = wisdomFile.empty() ? "" : wisdomFile + Fftw<PixelT>::wisdomSuffix();
+        if (require && !_wisdomFile.empty() && _wisdomFile != filename) {
+            throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                              (boost::format("FFTW wisdom file %s requested, but %s is already in use") %
+                               filename % _wisdomFile)
+                                      .str());
+        }
+        _measure = measure;
+        _wisdomFile = filename;
+        // A missing or unreadable file just means we start without wisdom
+        if (!_wisdomFile.empty()) {
+            Fftw<PixelT>::importWisdom(_wisdomFile.c_str());
+        }
+    }
+
+    ~FftwPlans() {
+        for (auto const& item : _plans) {
+            Fftw<PixelT>::destroy(item.second);
+        }
+    }
+
+private:
+    FftwPlans() : _measure(false) {}
+
+    Plan _getPlan(int n, bool isComplex) {
+        std::lock_guard<std::mutex> lock(fftwPlannerMutex);
+        std::pair<int, bool> const key(n, isComplex);
+        auto iter = _plans.find(key);
+        if (iter != _plans.end()) {
+            return iter->second;
+        }
+        // FFTW_MEASURE overwrites the arrays it plans for, so plan on scratch arrays
+        unsigned const flags = _measure ? FFTW_MEASURE : FFTW_ESTIMATE;
+        Plan plan;
+        if (isComplex) {
+            auto scratch = makeFftwArray<PixelT, typename Fftw<PixelT>::Complex>(n * n);
+            plan = Fftw<PixelT>::planDft2d(n, scratch.get(), flags);
+        } else {
+            auto scratch = makeFftwArray<PixelT, typename Fftw<PixelT>::Real>(n * n);
+            plan = Fftw<PixelT>::planR2hc2d(n, scratch.get(), flags);
+        }
+        if (!plan) {
+            throw LSST_EXCEPT(pex::exceptions::RuntimeError,
+                              (boost::format("Unable to make an FFTW plan of size %d") % n).str());
+        }
+        _plans[key] = plan;
+        if (_measure && !_wisdomFile.empty()) {
+            // Replace the file atomically, as other processes may be importing it
+            std::string const tmpFilename = (boost::format("%s.tmp%d") % _wisdomFile % ::getpid()).str();
+            if (Fftw<PixelT>::exportWisdom(tmpFilename.c_str()) &&
+                std::rename(tmpFilename.c_str(), _wisdomFile.c_str()) == 0) {
+                return plan;
+            }
+            std::remove(tmpFilename.c_str());  // failing to save wisdom only costs time in future
+        }
+        return plan;
+    }
+
+    bool _measure;
+    std::string _wisdomFile;
+    std::map<std::pair<int, bool>, Plan> _plans;  // keyed by (size, isComplex)
+};
+
+// Round a value to the nearest multiple of a step, or leave it alone if the step is zero
+inline double quantize(double const value, double const step) {
+    return (step > 0.0) ? step * std::round(value / step) : value;
+}
+
+// Round a positive value to the nearest point of a logarithmic grid with the given relative spacing
+inline double quantizeLog(double const value, double const tolerance) {
+    if (tolerance <= 0.0 || value <= 0.0) {
+        return value;
+    }
+    double const step = std::log1p(tolerance);
+    return std::exp(step * std::round(std::log(value) / step));
+}
+
 // Convenient wrapper for a Bessel function
 inline double J1(double const x) { return boost::math::cyl_bessel_j(1, x); }
 
@@ -329,7 +503,6 @@ std::pair<double, double> rotate(double x, double y, double angle) {
 /*  todo
  * - try sub pixel shift if it doesn't break even symmetry
  * - put values directly in an Image
- * - precompute the plan
  */
 
 template <typename PixelT>
@@ -347,23 +520,26 @@ std::shared_ptr<afw::image::Image<PixelT>> calcImageKSpaceCplx(double const rad1
     int xcen = wid / 2, ycen = wid / 2;
     FftShifter fftshift(wid);
 
-    boost::shared_array<std::complex<double>> cimg(new std::complex<double>[wid * wid]);
-    std::complex<double>* c = cimg.get();
-    // fftplan args: nx, ny, *in, *out, direction, flags
-    // - done in-situ if *in == *out
-    fftw_plan plan = fftw_plan_dft_2d(wid, wid, reinterpret_cast<fftw_complex*>(c),
-                                      reinterpret_cast<fftw_complex*>(c), FFTW_BACKWARD, FFTW_ESTIMATE);
+    // the transform is done in-situ, in the precision of the pixels
+    typedef typename Fftw<PixelT>::Real Real;
+    typename FftwPlans<PixelT>::Plan plan = FftwPlans<PixelT>::getInstance().getComplexPlan(wid);
+    auto cimg = makeFftwArray<PixelT, typename Fftw<PixelT>::Complex>(wid * wid);
+    std::complex<Real>* c = reinterpret_cast<std::complex<Real>*>(cimg.get());
 
     // compute the k-space values and put them in the cimg array
     double const twoPiRad1 = geom::TWOPI * rad1;
     double const twoPiRad2 = geom::TWOPI * rad2;
     double const scale = (1.0 - ellipticity);
-    for (int iY = 0; iY < wid; ++iY) {
+    // k is unchanged by reflection through the center, so we only evaluate the lower half (the Bessel
+    // functions dominate the cost), and copy each value to its reflection
+    for (int iY = 0; iY <= ycen; ++iY) {
         int const fY = fftshift.shift(iY);
+        int const fYReflected = fftshift.shift(wid - 1 - iY);
         double const ky = (static_cast<double>(iY) - ycen) / wid;
 
-        for (int iX = 0; iX < wid; ++iX) {
+        for (int iX = 0; iX < ((iY < ycen) ? wid : xcen + 1); ++iX) {
             int const fX = fftshift.shift(iX);
+            int const fXReflected = fftshift.shift(wid - 1 - iX);
             double const kx = static_cast<double>(iX - xcen) / wid;
 
             // rotate
@@ -377,14 +553,14 @@ std::shared_ptr<afw::image::Image<PixelT>> calcImageKSpaceCplx(double const rad1
             double const airy2 = rad2 * J1(twoPiRad2 * k) / k;
             double const airy = airy2 - airy1;
 
-            c[fY * wid + fX] = std::complex<double>(scale * airy, 0.0);
+            c[fY * wid + fX] = std::complex<Real>(scale * airy, 0.0);
+            c[fYReflected * wid + fXReflected] = c[fY * wid + fX];
         }
     }
     c[0] = scale * geom::PI * (rad2 * rad2 - rad1 * rad1);
 
-    // perform the fft and clean up after ourselves
-    fftw_execute(plan);
-    fftw_destroy_plan(plan);
+    // perform the fft
+    Fftw<PixelT>::executeDft(plan, cimg.get());
 
     // put the coefficients into an image
     auto coeffImage = std::make_shared<afw::image::Image<PixelT>>(geom::ExtentI(wid, wid), 0.0);
@@ -423,39 +599,42 @@ std::shared_ptr<afw::image::Image<PixelT>> calcImageKSpaceReal(double const rad1
     int xcen = wid / 2, ycen = wid / 2;
     FftShifter fftshift(wid);
 
-    boost::shared_array<double> cimg(new double[wid * wid]);
-    double* c = cimg.get();
-    // fftplan args: nx, ny, *in, *out, kindx, kindy, flags
-    // - done in-situ if *in == *out
-    fftw_plan plan = fftw_plan_r2r_2d(wid, wid, c, c, FFTW_R2HC, FFTW_R2HC, FFTW_ESTIMATE);
+    // the transform is done in-situ, in the precision of the pixels
+    typename FftwPlans<PixelT>::Plan plan = FftwPlans<PixelT>::getInstance().getRealPlan(wid);
+    auto cimg = makeFftwArray<PixelT, typename Fftw<PixelT>::Real>(wid * wid);
+    typename Fftw<PixelT>::Real* c = cimg.get();
 
     // compute the k-space values and put them in the cimg array
     double const twoPiRad1 = geom::TWOPI * rad1;
     double const twoPiRad2 = geom::TWOPI * rad2;
-    for (int iY = 0; iY < wid; ++iY) {
-        int const fY = fftshift.shift(iY);
-        double const ky = (static_cast<double>(iY) - ycen) / wid;
+    // k depends only on the distance from the center, so we only evaluate the octant 0 <= dY <= dX (the
+    // Bessel functions dominate the cost), and copy each value to its seven reflections
+    auto const set = [&c, &fftshift, wid, xcen, ycen](int dX, int dY, double value) {
+        c[fftshift.shift(ycen + dY) * wid + fftshift.shift(xcen + dX)] = value;
+    };
+    for (int dY = 0; dY <= ycen; ++dY) {
+        double const ky = static_cast<double>(dY) / wid;
 
-        for (int iX = 0; iX < wid; ++iX) {
-            int const fX = fftshift.shift(iX);
-
-            // emacs indent breaks if this isn't separte
-            double const iXcen = static_cast<double>(iX - xcen);
-            double const kx = iXcen / wid;
+        for (int dX = dY; dX <= xcen; ++dX) {
+            double const kx = static_cast<double>(dX) / wid;
 
             double const k = ::sqrt(kx * kx + ky * ky);
             double const airy1 = (rad1 > 0 ? rad1 * J1(twoPiRad1 * k) : 0.0) / k;
             double const airy2 = rad2 * J1(twoPiRad2 * k) / k;
             double const airy = airy2 - airy1;
-            c[fY * wid + fX] = airy;
+            for (int sign : {-1, 1}) {
+                set(sign * dX, dY, airy);
+                set(sign * dX, -dY, airy);
+                set(sign * dY, dX, airy);
+                set(sign * dY, -dX, airy);
+            }
         }
     }
     int fxy = fftshift.shift(wid / 2);
     c[fxy * wid + fxy] = geom::PI * (rad2 * rad2 - rad1 * rad1);
 
-    // perform the fft and clean up after ourselves
-    fftw_execute(plan);
-    fftw_destroy_plan(plan);
+    // perform the fft
+    Fftw<PixelT>::executeR2r(plan, c);
 
     // put the coefficients into an image
     auto coeffImage = std::make_shared<afw::image::Image<PixelT>>(geom::ExtentI(wid, wid), 0.0);
@@ -494,34 +673,193 @@ void SincCoeffs<PixelT>::cache(float r1, float r2) {
     }
     double const innerFactor = r1 / r2;
     afw::geom::ellipses::Axes axes(r2, r2, 0.0);
-    if (!getInstance()._lookup(axes, innerFactor)) {
-        PTR(typename SincCoeffs<PixelT>::CoeffT) coeff = calculate(axes, innerFactor);
-        coeff->markPersistent();
-        getInstance()._cache[r2][innerFactor] = coeff;
+    SincCoeffs& instance = getInstance();
+    std::shared_ptr<CacheEntry> entry = instance._lookup(axes, innerFactor);
+    if (!entry) {
+        std::unique_lock<std::shared_timed_mutex> lock(instance._mutex);
+        std::shared_ptr<CacheEntry>& slot = instance._cache[r2][innerFactor];
+        if (!slot) {  // we may have lost a race to add it
+            slot = std::make_shared<CacheEntry>();
+        }
+        entry = slot;
     }
+    // Calculate the coefficients now (outside the lock), as cache() is used to prepare for measurement
+    _getCoeff(*entry, axes, innerFactor);
 }
 
 template <typename PixelT>
 CONST_PTR(typename SincCoeffs<PixelT>::CoeffT)
 SincCoeffs<PixelT>::get(afw::geom::ellipses::Axes const& axes, float const innerFactor) {
-    CONST_PTR(CoeffT) coeff = getInstance()._lookup(axes, innerFactor);
-    return coeff ? coeff : calculate(axes, innerFactor);
+    std::shared_ptr<CacheEntry> entry = getInstance()._lookup(axes, innerFactor);
+    return entry ? _getCoeff(*entry, axes, innerFactor) : calculate(axes, innerFactor);
 }
 
 template <typename PixelT>
 CONST_PTR(typename SincCoeffs<PixelT>::CoeffT)
-SincCoeffs<PixelT>::_lookup(afw::geom::ellipses::Axes const& axes, double const innerFactor) const {
+SincCoeffs<PixelT>::get(afw::geom::ellipses::Axes const& axes, float const innerFactor,
+                        double const tolerance) {
+    if (tolerance < 0.0) {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          (boost::format("Invalid tolerance = %f") % tolerance).str());
+    }
+    SincCoeffs& instance = getInstance();
+    std::shared_ptr<CacheEntry> entry = instance._lookup(axes, innerFactor);
+    if (entry) {
+        return _getCoeff(*entry, axes, innerFactor);
+    }
+
+    double const a = quantizeLog(axes.getA(), tolerance);
+    double const b = quantizeLog(axes.getB(), tolerance);
+    double theta = 0.0;
+    if (a != b) {
+        // The position angle is only defined modulo pi
+        theta = quantize(axes.getTheta() - geom::PI * std::floor(axes.getTheta() / geom::PI), tolerance);
+    }
+    double const inner = std::min(1.0, quantize(innerFactor, tolerance));
+    LruKey const key(tolerance, a, b, theta, inner);
+    bool unaccounted = false;  // whether the size of the coefficients is not yet in the statistics
+    {
+        std::lock_guard<std::mutex> lock(instance._lruMutex);
+        if (instance._lruCapacity == 0) {
+            entry = nullptr;
+        } else {
+            typename LruMap::iterator iter = instance._lru.find(key);
+            if (iter != instance._lru.end()) {
+                ++instance._lruStatistics.hits;
+                instance._lruOrder.splice(instance._lruOrder.begin(), instance._lruOrder,
+                                          iter->second.position);
+            } else {
+                ++instance._lruStatistics.misses;
+                instance._lruOrder.push_front(key);
+                LruNode node = {std::make_shared<CacheEntry>(), 0, instance._lruOrder.begin()};
+                iter = instance._lru.emplace(key, node).first;
+            }
+            entry = iter->second.entry;
+            unaccounted = (iter->second.bytes == 0);
+        }
+    }
+    afw::geom::ellipses::Axes const quantized(a, b, theta);
+    if (!entry) {
+        return calculate(quantized, inner);
+    }
+
+    // Calculate the coefficients outside the lock, so other apertures can be looked up meanwhile
+    PTR(CoeffT const) coeff = _getCoeff(*entry, quantized, inner);
+    if (unaccounted) {
+        std::lock_guard<std::mutex> lock(instance._lruMutex);
+        typename LruMap::iterator iter = instance._lru.find(key);
+        // The entry may already have been evicted, or been accounted for by another thread
+        if (iter != instance._lru.end() && iter->second.entry == entry && iter->second.bytes == 0) {
+            iter->second.bytes = sizeof(PixelT) * coeff->getWidth() * coeff->getHeight();
+            instance._lruStatistics.bytes += iter->second.bytes;
+            ++instance._lruStatistics.size;
+            instance._evictLru(&key);
+        }
+    }
+    return coeff;
+}
+
+template <typename PixelT>
+void SincCoeffs<PixelT>::setLruCapacity(std::size_t bytes) {
+    SincCoeffs& instance = getInstance();
+    std::lock_guard<std::mutex> lock(instance._lruMutex);
+    instance._lruCapacity = bytes;
+    instance._evictLru(nullptr);
+}
+
+template <typename PixelT>
+std::size_t SincCoeffs<PixelT>::getLruCapacity() {
+    SincCoeffs& instance = getInstance();
+    std::lock_guard<std::mutex> lock(instance._lruMutex);
+    return instance._lruCapacity;
+}
+
+template <typename PixelT>
+typename SincCoeffs<PixelT>::LruStatistics SincCoeffs<PixelT>::getLruStatistics() {
+    SincCoeffs& instance = getInstance();
+    std::lock_guard<std::mutex> lock(instance._lruMutex);
+    return instance._lruStatistics;
+}
+
+template <typename PixelT>
+void SincCoeffs<PixelT>::setStore(std::shared_ptr<SincCoeffsStore const> store) {
+    SincCoeffs& instance = getInstance();
+    std::unique_lock<std::shared_timed_mutex> lock(instance._mutex);
+    instance._store = store;
+}
+
+template <typename PixelT>
+void SincCoeffs<PixelT>::requireStore(std::shared_ptr<SincCoeffsStore const> store) {
+    SincCoeffs& instance = getInstance();
+    std::unique_lock<std::shared_timed_mutex> lock(instance._mutex);
+    if (instance._store && store && instance._store->getFilename() != store->getFilename()) {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          (boost::format("Sinc coefficients store %s requested, but %s is already in use") %
+                           store->getFilename() % instance._store->getFilename())
+                                  .str());
+    }
+    if (store) {
+        instance._store = store;
+    }
+}
+
+template <typename PixelT>
+std::shared_ptr<SincCoeffsStore const> SincCoeffs<PixelT>::getStore() {
+    SincCoeffs& instance = getInstance();
+    std::shared_lock<std::shared_timed_mutex> lock(instance._mutex);
+    return instance._store;
+}
+
+template <typename PixelT>
+void SincCoeffs<PixelT>::setFftwPlanning(bool measure, std::string const& wisdomFile) {
+    FftwPlans<PixelT>::getInstance().configure(measure, wisdomFile, false);
+}
+
+template <typename PixelT>
+void SincCoeffs<PixelT>::requireFftwPlanning(std::string const& wisdomFile) {
+    FftwPlans<PixelT>::getInstance().configure(true, wisdomFile, true);
+}
+
+template <typename PixelT>
+void SincCoeffs<PixelT>::_evictLru(LruKey const* keep) {
+    // Must be called with _lruMutex held
+    typename std::list<LruKey>::iterator position = _lruOrder.end();
+    while (_lruStatistics.bytes > _lruCapacity && position != _lruOrder.begin()) {
+        --position;
+        if (keep && *position == *keep) {
+            continue;
+        }
+        typename LruMap::iterator iter = _lru.find(*position);
+        if (iter->second.bytes > 0) {
+            _lruStatistics.bytes -= iter->second.bytes;
+            --_lruStatistics.size;
+            ++_lruStatistics.evictions;
+        }
+        _lru.erase(iter);
+        position = _lruOrder.erase(position);
+    }
+    if (_lruCapacity == 0) {
+        // Also forget the apertures whose coefficients are still being calculated
+        _lru.clear();
+        _lruOrder.clear();
+    }
+}
+
+template <typename PixelT>
+std::shared_ptr<typename SincCoeffs<PixelT>::CacheEntry> SincCoeffs<PixelT>::_lookup(
+        afw::geom::ellipses::Axes const& axes, double const innerFactor) const {
     if (innerFactor < 0.0 || innerFactor > 1.0) {
         throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
                           (boost::format("innerFactor = %f is not between 0 and 1") % innerFactor).str());
     }
 
-    CONST_PTR(typename SincCoeffs<PixelT>::CoeffT) const null = CONST_PTR(SincCoeffs<PixelT>::CoeffT)();
+    std::shared_ptr<CacheEntry> const null;
 
     // We only cache circular apertures
     if (!FuzzyCompare<float>().isEqual(axes.getA(), axes.getB())) {
         return null;
     }
+    std::shared_lock<std::shared_timed_mutex> lock(_mutex);
     typename CoeffMapMap::const_iterator iter1 = _cache.find(axes.getA());
     if (iter1 == _cache.end()) {
         return null;
@@ -530,6 +868,26 @@ SincCoeffs<PixelT>::_lookup(afw::geom::ellipses::Axes const& axes, double const
     return (iter2 == iter1->second.end()) ? null : iter2->second;
 }
 
+template <typename PixelT>
+CONST_PTR(typename SincCoeffs<PixelT>::CoeffT)
+SincCoeffs<PixelT>::_getCoeff(CacheEntry& entry, afw::geom::ellipses::Axes const& axes,
+                              double const innerFactor) {
+    // If calculate throws, the next thread to need the coefficients tries again
+    std::call_once(entry.calculated, [&]() {
+        if (FuzzyCompare<float>().isEqual(axes.getA(), axes.getB())) {
+            std::shared_ptr<SincCoeffsStore const> store = getStore();
+            if (store) {
+                entry.coeff = store->getCoeffs<PixelT>(axes.getA(), innerFactor);
+                if (entry.coeff) return;
+            }
+        }
+        PTR(CoeffT) coeff = calculate(axes, innerFactor);
+        coeff->markPersistent();
+        entry.coeff = coeff;
+    });
+    return entry.coeff;
+}
+
 template <typename PixelT>
 PTR(typename SincCoeffs<PixelT>::CoeffT)
 SincCoeffs<PixelT>::calculate(afw::geom::ellipses::Axes const& axes, double const innerFactor) {
@@ -0,0 +1,329 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2019  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "boost/format.hpp"
+#include "ndarray.h"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/geom/ellipses/Axes.h"
+#include "lsst/meas/base/SincCoeffs.h"
+#include "lsst/meas/base/SincCoeffsStore.h"
+
+namespace lsst {
+namespace meas {
+namespace base {
+namespace {
+
+char const MAGIC[8] = {'S', 'I', 'N', 'C', 'C', 'O', 'E', 'F'};
+std::uint32_t const BYTE_ORDER_MARK = 0x01020304;  // reads differently on a machine of other endianness
+std::size_t const ALIGNMENT = 64;                   // of the pixels of each image, from the start of the file
+
+// The layout of the file: a FileHeader, nEntries FileEntries, then the pixels of each image (rows
+// contiguous, aligned to ALIGNMENT).  The checksum covers everything after the header.
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t nEntries;
+    std::uint64_t fileSize;
+    std::uint64_t checksum;
+    char reserved[24];
+};
+
+struct FileEntry {
+    double radius;
+    double innerFactor;
+    std::uint32_t pixelType;
+    std::int32_t x0, y0, width, height;
+    std::uint32_t reserved;
+    std::uint64_t offset;
+};
+
+static_assert(sizeof(FileHeader) == 64, "FileHeader must have the same layout everywhere");
+static_assert(sizeof(FileEntry) == 48, "FileEntry must have the same layout everywhere");
+
+template <typename PixelT>
+std::uint32_t getPixelType();
+
+template <>
+std::uint32_t getPixelType<float>() {
+    return 1;
+}
+
+template <>
+std::uint32_t getPixelType<double>() {
+    return 2;
+}
+
+// 64-bit FNV-1a hash
+std::uint64_t computeChecksum(char const* data, std::size_t size) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::size_t align(std::size_t offset) { return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; }
+
+// The same comparison of radii as SincCoeffs uses for its cache
+bool isEqual(float x, float y) { return std::fabs(x - y) < std::numeric_limits<float>::epsilon(); }
+
+template <typename PixelT>
+void appendCoeffs(std::vector<FileEntry>& entries, std::vector<std::shared_ptr<void const>>& images,
+                  std::size_t& offset, double rInner, double rOuter) {
+    if (rInner < 0.0 || rOuter <= 0.0 || rOuter < rInner) {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          (boost::format("Invalid rInner,rOuter = %f,%f") % rInner % rOuter).str());
+    }
+    double const innerFactor = rInner / rOuter;
+    std::shared_ptr<afw::image::Image<PixelT>> coeff =
+            SincCoeffs<PixelT>::calculate(afw::geom::ellipses::Axes(rOuter, rOuter, 0.0), innerFactor);
+    FileEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.radius = rOuter;
+    entry.innerFactor = innerFactor;
+    entry.pixelType = getPixelType<PixelT>();
+    entry.x0 = coeff->getX0();
+    entry.y0 = coeff->getY0();
+    entry.width = coeff->getWidth();
+    entry.height = coeff->getHeight();
+    entry.offset = offset;
+    offset = align(offset + sizeof(PixelT) * entry.width * entry.height);
+    entries.push_back(entry);
+    images.push_back(coeff);
+}
+
+template <typename PixelT>
+void writePixels(std::ostream& stream, void const* image) {
+    auto const& coeff = *static_cast<afw::image::Image<PixelT> const*>(image);
+    for (int y = 0; y < coeff.getHeight(); ++y) {
+        stream.write(reinterpret_cast<char const*>(coeff.row_begin(y)), sizeof(PixelT) * coeff.getWidth());
+    }
+}
+
+// The stores in use, so that algorithms using the same file share its mapping
+std::mutex registryMutex;
+std::vector<std::weak_ptr<SincCoeffsStore const>> registry;
+
+}  // namespace
+
+int const SincCoeffsStore::VERSION;
+
+std::shared_ptr<SincCoeffsStore const> SincCoeffsStore::get(std::string const& filename) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.erase(std::remove_if(registry.begin(), registry.end(),
+                                  [](std::weak_ptr<SincCoeffsStore const> const& entry) {
+                                      return entry.expired();
+                                  }),
+                   registry.end());
+    for (auto const& entry : registry) {
+        std::shared_ptr<SincCoeffsStore const> store = entry.lock();
+        if (store && store->getFilename() == filename) {
+            return store;
+        }
+    }
+    auto store = std::make_shared<SincCoeffsStore const>(filename);
+    registry.push_back(store);
+    return store;
+}
+
+void SincCoeffsStore::write(std::string const& filename, std::vector<double> const& rInner,
+                            std::vector<double> const& rOuter) {
+    if (rInner.size() != rOuter.size()) {
+        throw LSST_EXCEPT(pex::exceptions::LengthError,
+                          (boost::format("Number of inner radii (%d) doesn't match outer radii (%d)") %
+                           rInner.size() % rOuter.size())
+                                  .str());
+    }
+    std::vector<FileEntry> entries;
+    std::vector<std::shared_ptr<void const>> images;
+    std::size_t offset = align(sizeof(FileHeader) + 2 * rOuter.size() * sizeof(FileEntry));
+    for (std::size_t i = 0; i < rOuter.size(); ++i) {
+        appendCoeffs<float>(entries, images, offset, rInner[i], rOuter[i]);
+        appendCoeffs<double>(entries, images, offset, rInner[i], rOuter[i]);
+    }
+
+    // Assemble everything after the header in memory, to compute the checksum
+    std::ostringstream body;
+    body.write(reinterpret_cast<char const*>(entries.data()), entries.size() * sizeof(FileEntry));
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        std::size_t const position = sizeof(FileHeader) + static_cast<std::size_t>(body.tellp());
+        std::string const padding(entries[i].offset - position, '\0');
+        body.write(padding.data(), padding.size());
+        if (entries[i].pixelType == getPixelType<float>()) {
+            writePixels<float>(body, images[i].get());
+        } else {
+            writePixels<double>(body, images[i].get());
+        }
+    }
+    std::string const contents = body.str();
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.nEntries = entries.size();
+    header.fileSize = sizeof(FileHeader) + contents.size();
+    header.checksum = computeChecksum(contents.data(), contents.size());
+
+    // Readers may be mapping the file as we write it, so replace it atomically
+    std::string const tmpFilename = (boost::format("%s.tmp%d") % filename % ::getpid()).str();
+    {
+        std::ofstream stream(tmpFilename, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        stream.write(contents.data(), contents.size());
+        stream.close();
+        if (!stream) {
+            std::remove(tmpFilename.c_str());
+            throw LSST_EXCEPT(pex::exceptions::IoError,
+                              (boost::format("Unable to write sinc coefficient store %s") % tmpFilename)
+                                      .str());
+        }
+    }
+    if (std::rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+        std::remove(tmpFilename.c_str());
+        throw LSST_EXCEPT(pex::exceptions::IoError,
+                          (boost::format("Unable to rename %s to %s: %s") % tmpFilename % filename %
+                           std::strerror(errno))
+                                  .str());
+    }
+}
+
+SincCoeffsStore::SincCoeffsStore(std::string const& filename) : _filename(filename) {
+    int const fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw LSST_EXCEPT(pex::exceptions::IoError,
+                          (boost::format("Unable to open sinc coefficient store %s: %s") % filename %
+                           std::strerror(errno))
+                                  .str());
+    }
+    struct stat status;
+    if (::fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+        ::close(fd);
+        throw LSST_EXCEPT(pex::exceptions::IoError,
+                          (boost::format("Sinc coefficient store %s is truncated") % filename).str());
+    }
+    std::size_t const size = status.st_size;
+    void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // the mapping remains valid
+    if (mapped == MAP_FAILED) {
+        throw LSST_EXCEPT(pex::exceptions::IoError,
+                          (boost::format("Unable to map sinc coefficient store %s: %s") % filename %
+                           std::strerror(errno))
+                                  .str());
+    }
+    _data = std::shared_ptr<char const>(static_cast<char const*>(mapped),
+                                        [size](char const* data) {
+                                            ::munmap(const_cast<char*>(data), size);
+                                        });
+
+    auto fail = [&filename](std::string const& reason) {
+        return LSST_EXCEPT(pex::exceptions::IoError,
+                           (boost::format("Sinc coefficient store %s %s") % filename % reason).str());
+    };
+    FileHeader header;
+    std::memcpy(&header, _data.get(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw fail("is not a sinc coefficient store");
+    }
+    if (header.byteOrder != BYTE_ORDER_MARK) {
+        throw fail("was written on a machine of different endianness");
+    }
+    if (header.version != static_cast<std::uint32_t>(VERSION)) {
+        throw fail((boost::format("has version %d; expected %d") % header.version % VERSION).str());
+    }
+    if (header.fileSize != size || header.nEntries > (size - sizeof(FileHeader)) / sizeof(FileEntry)) {
+        throw fail("is truncated");
+    }
+    if (computeChecksum(_data.get() + sizeof(FileHeader), size - sizeof(FileHeader)) != header.checksum) {
+        throw fail("is corrupted (checksum mismatch)");
+    }
+
+    FileEntry const* entries = reinterpret_cast<FileEntry const*>(_data.get() + sizeof(FileHeader));
+    _entries.reserve(header.nEntries);
+    for (std::size_t i = 0; i < header.nEntries; ++i) {
+        FileEntry const& entry = entries[i];
+        std::size_t const pixelSize = (entry.pixelType == getPixelType<float>()) ? sizeof(float)
+                                      : (entry.pixelType == getPixelType<double>()) ? sizeof(double)
+                                                                                     : 0;
+        if (pixelSize == 0 || entry.width < 0 || entry.height < 0 || entry.offset % ALIGNMENT != 0 ||
+            entry.offset > size || (size - entry.offset) / pixelSize / std::max(entry.width, 1) <
+                                           static_cast<std::size_t>(entry.height)) {
+            throw fail((boost::format("has an invalid entry %d") % i).str());
+        }
+        _entries.push_back({static_cast<float>(entry.radius), static_cast<float>(entry.innerFactor),
+                            static_cast<int>(entry.pixelType), entry.x0, entry.y0, entry.width,
+                            entry.height, static_cast<std::size_t>(entry.offset)});
+    }
+}
+
+template <typename PixelT>
+std::shared_ptr<afw::image::Image<PixelT> const> SincCoeffsStore::getCoeffs(double radius,
+                                                                           double innerFactor) const {
+    for (auto const& entry : _entries) {
+        if (entry.pixelType == static_cast<int>(getPixelType<PixelT>()) && isEqual(entry.radius, radius) &&
+            isEqual(entry.innerFactor, innerFactor)) {
+            // The memory is mapped read-only: the image must never be modified, hence the const result
+            PixelT* pixels = reinterpret_cast<PixelT*>(const_cast<char*>(_data.get()) + entry.offset);
+            ndarray::Array<PixelT, 2, 1> array = ndarray::external(
+                    pixels,
+                    ndarray::makeVector<std::size_t>(entry.height, entry.width),
+                    ndarray::makeVector<std::ptrdiff_t>(entry.width, 1), _data);
+            auto coeff = std::make_shared<afw::image::Image<PixelT>>(array, false,
+                                                                     geom::Point2I(entry.x0, entry.y0));
+            coeff->markPersistent();
+            return coeff;
+        }
+    }
+    return nullptr;
+}
+
+#define INSTANTIATE(T)                                                                     \
+    template std::shared_ptr<afw::image::Image<T> const> SincCoeffsStore::getCoeffs<T>(double, \
+                                                                                       double) const;
+
+INSTANTIATE(float);
+INSTANTIATE(double);
+
+}  // namespace base
+}  // namespace meas
+}  // namespace lsst
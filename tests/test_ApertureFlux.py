@@ -26,8 +26,9 @@ import numpy as np
 import lsst.geom
 import lsst.afw.geom
 import lsst.afw.image
+import lsst.afw.math
 import lsst.utils.tests
-from lsst.meas.base import ApertureFluxAlgorithm
+from lsst.meas.base import ApertureFluxAlgorithm, PrefixSumImageF, SincCoeffsF, SincCoeffsStackF
 from lsst.meas.base.tests import (AlgorithmTestCase, FluxTransformTestCase,
                                   SingleFramePluginTransformSetupHelper)
 
@@ -99,6 +100,58 @@ class ApertureFluxTestCase(lsst.utils.tests.TestCase):
         self.assertFalse(invalid.getFlag(ApertureFluxAlgorithm.SINC_COEFFS_TRUNCATED.number))
         self.assertTrue(np.isnan(invalid.instFlux))
 
+    def testNaiveFluxes(self):
+        """Test that measuring many apertures in one pass matches measuring each in turn."""
+        rng = np.random.RandomState(12345)
+        maskedImage = self.exposure.getMaskedImage()
+        maskedImage.getImage().getArray()[:, :] = rng.normal(10.0, 3.0, size=(81, 81))
+        maskedImage.getVariance().getArray()[:, :] = rng.uniform(0.5, 2.0, size=(81, 81))
+        radii = [17.0, 3.0, 45.0, 12.0, 30.0, 0.4]  # unsorted; 45 doesn't fit in the image
+        for position in (lsst.geom.Point2D(55.3, -62.7), lsst.geom.Point2D(60.5, -60.0)):
+            for image in (maskedImage, maskedImage.getImage()):
+                results = ApertureFluxAlgorithm.computeNaiveFluxes(image, position, radii)
+                self.assertEqual(len(results), len(radii))
+                for radius, result in zip(radii, results):
+                    ellipse = lsst.afw.geom.Ellipse(lsst.afw.geom.ellipses.Axes(radius, radius, 0.0),
+                                                    position)
+                    expected = ApertureFluxAlgorithm.computeNaiveFlux(image, ellipse, self.ctrl)
+                    for flag in (ApertureFluxAlgorithm.FAILURE, ApertureFluxAlgorithm.APERTURE_TRUNCATED):
+                        self.assertEqual(result.getFlag(flag.number), expected.getFlag(flag.number))
+                    self.assertEqual(result.getFlag(ApertureFluxAlgorithm.APERTURE_TRUNCATED.number),
+                                     radius == 45.0)
+                    self.assertFloatsAlmostEqual(result.instFlux, expected.instFlux, rtol=1E-12,
+                                                 ignoreNaNs=True)
+                    self.assertFloatsAlmostEqual(result.instFluxErr, expected.instFluxErr, rtol=1E-12,
+                                                 ignoreNaNs=True)
+
+    def testPrefixSums(self):
+        """Test that fluxes measured on row sums are identical to those summed over spans."""
+        rng = np.random.RandomState(54321)
+        maskedImage = self.exposure.getMaskedImage()
+        # integer values, so the sums are exact whatever their order
+        maskedImage.getImage().getArray()[:, :] = rng.randint(-50, 1000, size=(81, 81))
+        maskedImage.getVariance().getArray()[:, :] = rng.randint(1, 100, size=(81, 81))
+        apertures = [lsst.afw.geom.ellipses.Axes(radius, radius, 0.0) for radius in (3.0, 12.0, 25.0, 40.0)]
+        apertures.append(lsst.afw.geom.ellipses.Axes(20.0, 8.0, 0.7))
+        for image, sums in ((maskedImage, PrefixSumImageF(maskedImage)),
+                            (maskedImage.getImage(), PrefixSumImageF(maskedImage.getImage()))):
+            self.assertEqual(sums.getBBox(), self.bbox)
+            self.assertEqual(sums.hasVariance(), image is maskedImage)
+            for position in (lsst.geom.Point2D(60.0, -60.0), lsst.geom.Point2D(52.3, -64.6)):
+                for axes in apertures:
+                    ellipse = lsst.afw.geom.Ellipse(axes, position)
+                    expected = ApertureFluxAlgorithm.computeNaiveFlux(image, ellipse, self.ctrl)
+                    result = ApertureFluxAlgorithm.computeNaiveFlux(sums, ellipse, self.ctrl)
+                    self.assertEqual(result.getFlag(ApertureFluxAlgorithm.APERTURE_TRUNCATED.number),
+                                     expected.getFlag(ApertureFluxAlgorithm.APERTURE_TRUNCATED.number))
+                    np.testing.assert_array_equal([result.instFlux, result.instFluxErr],
+                                                  [expected.instFlux, expected.instFluxErr])
+                radii = [axes.getA() for axes in apertures[:-1]]
+                for result, expected in zip(ApertureFluxAlgorithm.computeNaiveFluxes(sums, position, radii),
+                                            ApertureFluxAlgorithm.computeNaiveFluxes(image, position, radii)):
+                    np.testing.assert_array_equal([result.instFlux, result.instFluxErr],
+                                                  [expected.instFlux, expected.instFluxErr])
+
     def testSinc(self):
         positions = [lsst.geom.Point2D(60.0, -60.0),
                      lsst.geom.Point2D(60.5, -60.0),
@@ -147,6 +200,65 @@ class ApertureFluxTestCase(lsst.utils.tests.TestCase):
         self.assertTrue(invalid2.getFlag(ApertureFluxAlgorithm.SINC_COEFFS_TRUNCATED.number))
         self.assertFalse(np.isnan(invalid2.instFlux))
 
+    def testSincFluxes(self):
+        """Test that measuring stacked sinc apertures is identical to measuring each in turn."""
+        rng = np.random.RandomState(2468)
+        maskedImage = self.exposure.getMaskedImage()
+        maskedImage.getImage().getArray()[:, :] = rng.normal(10.0, 3.0, size=(81, 81))
+        maskedImage.getVariance().getArray()[:, :] = rng.uniform(0.5, 2.0, size=(81, 81))
+        radii = [9.0, 3.0, 6.0, 4.5]
+        # the last positions truncate the coefficients of some apertures, and the apertures of others
+        positions = [lsst.geom.Point2D(60.3, -59.6), lsst.geom.Point2D(59.5, -60.5),
+                     lsst.geom.Point2D(40.2, -45.8), lsst.geom.Point2D(26.7, -60.1)]
+        for kernel in ("lanczos5", "lanczos3", "bilinear"):
+            self.ctrl.shiftKernel = kernel
+            coeffs = SincCoeffsStackF(radii, self.ctrl)
+            self.assertEqual(coeffs.getRadii(), radii)
+            for i in range(len(radii)):
+                self.assertTrue(coeffs.getBBox().contains(coeffs.getBBox(i)))
+            for position in positions:
+                for image in (maskedImage, maskedImage.getImage()):
+                    results = ApertureFluxAlgorithm.computeSincFluxes(image, position, coeffs, self.ctrl)
+                    self.assertEqual(len(results), len(radii))
+                    for radius, result in zip(radii, results):
+                        ellipse = lsst.afw.geom.Ellipse(lsst.afw.geom.ellipses.Axes(radius, radius, 0.0),
+                                                        position)
+                        expected = ApertureFluxAlgorithm.computeSincFlux(image, ellipse, self.ctrl)
+                        for flag in (ApertureFluxAlgorithm.FAILURE, ApertureFluxAlgorithm.APERTURE_TRUNCATED,
+                                     ApertureFluxAlgorithm.SINC_COEFFS_TRUNCATED):
+                            self.assertEqual(result.getFlag(flag.number), expected.getFlag(flag.number))
+                        np.testing.assert_array_equal([result.instFlux, result.instFluxErr],
+                                                      [expected.instFlux, expected.instFluxErr])
+
+    def testSincShift(self):
+        """Test that shifting the sinc coefficients on the fly matches shifting them with offsetImage.
+        """
+        rng = np.random.RandomState(5)
+        image = self.exposure.getMaskedImage()
+        image.getImage().getArray()[:, :] = rng.randn(*image.getDimensions()[::-1])
+        image.getVariance().getArray()[:, :] = rng.uniform(0.5, 1.5, image.getDimensions()[::-1])
+        axes = lsst.afw.geom.ellipses.Axes(5.0, 3.0, 0.4)
+        # the last positions clip the coefficients
+        positions = [lsst.geom.Point2D(60.0, -60.0), lsst.geom.Point2D(60.3, -59.2),
+                     lsst.geom.Point2D(59.8, -60.7), lsst.geom.Point2D(40.4, -45.6)]
+        for shiftKernel in ("lanczos5", "lanczos3", "bilinear"):
+            self.ctrl.shiftKernel = shiftKernel
+            for position in positions:
+                ellipse = lsst.afw.geom.Ellipse(axes, position)
+                result = ApertureFluxAlgorithm.computeSincFlux(image, ellipse, self.ctrl)
+                coeffs = lsst.afw.math.offsetImage(SincCoeffsF.get(axes, 0.0), position.getX(),
+                                                   position.getY(), shiftKernel)
+                bbox = coeffs.getBBox()
+                self.assertEqual(result.getFlag(ApertureFluxAlgorithm.SINC_COEFFS_TRUNCATED.number),
+                                 not image.getBBox().contains(bbox))
+                bbox.clip(image.getBBox())
+                coeffs = coeffs[bbox].getArray().astype(float)
+                subImage = image[bbox]
+                instFlux = (subImage.getImage().getArray()*coeffs).sum()
+                instFluxErr = (subImage.getVariance().getArray()*coeffs**2).sum()**0.5
+                self.assertFloatsAlmostEqual(result.instFlux, instFlux, rtol=1E-5, atol=1E-5)
+                self.assertFloatsAlmostEqual(result.instFluxErr, instFluxErr, rtol=1E-5)
+
 
 class CircularApertureFluxTestCase(AlgorithmTestCase, lsst.utils.tests.TestCase):
     """Test case for the CircularApertureFlux algorithm/plugin.
@@ -67,6 +67,46 @@ class GaussianFluxTestCase(AlgorithmTestCase, lsst.utils.tests.TestCase):
             self.assertFloatsAlmostEqual(measRecord.get("base_GaussianFlux_instFlux"),
                                          measRecord.get("truth_instFlux"), rtol=3E-3)
 
+    def testSdssShapeSums(self):
+        """Test that reusing the sums of base_SdssShape gives the same instFlux as recomputing them.
+        """
+        config = self.makeSingleFrameMeasurementConfig("base_GaussianFlux", ["base_SdssShape"])
+        config.slots.shape = "base_SdssShape"
+        config.doReplaceWithNoise = False
+        task = self.makeSingleFrameMeasurementTask(config=config)
+        exposure, catalog = self.dataset.realize(10.0, task.schema, randomSeed=0)
+        task.run(catalog, exposure)
+        for measRecord in catalog:
+            self.assertFalse(measRecord.get("base_SdssShape_flag"))
+            result = lsst.meas.base.SdssShapeAlgorithm.computeFixedMomentsFlux(
+                exposure.getMaskedImage(), measRecord.getShape(), measRecord.getCentroid())
+            self.assertFloatsAlmostEqual(measRecord.get("base_GaussianFlux_instFlux"), result.instFlux,
+                                         rtol=1E-10)
+            self.assertFloatsAlmostEqual(measRecord.get("base_GaussianFlux_instFluxErr"), result.instFluxErr,
+                                         rtol=1E-10)
+        # base_GaussianFlux used the sums of the last record, so changing the pixels can't make them stale
+        measRecord = catalog[-1]
+        exposure.getMaskedImage().getImage().getArray()[:, :] *= 2.0
+        result = lsst.meas.base.SdssShapeAlgorithm.computeFixedMomentsFlux(
+            exposure.getMaskedImage(), measRecord.getShape(), measRecord.getCentroid(), measRecord.getId())
+        self.assertFloatsAlmostEqual(result.instFlux, 2.0*measRecord.get("base_GaussianFlux_instFlux"),
+                                     rtol=1E-10)
+
+        # the sums of a record measured by base_SdssShape alone aren't used for another exposure
+        shapeTask = self.makeSingleFrameMeasurementTask("base_SdssShape")
+        exposure, catalog = self.dataset.realize(10.0, shapeTask.schema, randomSeed=0)
+        shapeTask.run(catalog, exposure)
+        measRecord = catalog[-1]
+        key = lsst.meas.base.SdssShapeResultKey(catalog.schema["base_SdssShape"])
+        shape = measRecord.get(key).getShape()
+        other = exposure.clone()
+        other.getMaskedImage().getImage().getArray()[:, :] *= 2.0
+        expected = lsst.meas.base.SdssShapeAlgorithm.computeFixedMomentsFlux(
+            other.getMaskedImage(), shape, measRecord.getCentroid())
+        result = lsst.meas.base.SdssShapeAlgorithm.computeFixedMomentsFlux(
+            other.getMaskedImage(), shape, measRecord.getCentroid(), measRecord.getId())
+        self.assertFloatsAlmostEqual(result.instFlux, expected.instFlux, rtol=1E-10)
+
     def testMonteCarlo(self):
         """Test an ideal simulation, with no noise.
 
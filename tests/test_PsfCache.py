@@ -0,0 +1,152 @@
+# This file is part of meas_base.
+#
+# Developed for the LSST Data Management System.
+# This product includes software developed by the LSST Project
+# (https://www.lsst.org).
+# See the COPYRIGHT file at the top-level directory of this distribution
+# for details of code ownership.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+import unittest
+
+import lsst.geom
+import lsst.afw.detection
+import lsst.afw.math
+import lsst.meas.base
+import lsst.utils.tests
+
+
+def makeVaryingPsf(bbox):
+    """Make a Gaussian PSF model whose width increases by 25% across the image."""
+    function = lsst.afw.math.GaussianFunction2D(1.0, 1.0, 0.0)
+    spatialFunction = lsst.afw.math.PolynomialFunction2D(1)
+    kernel = lsst.afw.math.AnalyticKernel(25, 25, function, spatialFunction)
+    slope = 0.5/bbox.getWidth()
+    kernel.setSpatialParameters([[2.0, slope, 0.0], [2.0, 0.0, slope], [0.0, 0.0, 0.0]])
+    return lsst.afw.detection.KernelPsf(kernel, lsst.geom.Box2D(bbox).getCenter())
+
+
+class PsfCacheTestCase(lsst.utils.tests.TestCase):
+
+    def setUp(self):
+        self.bbox = lsst.geom.Box2I(lsst.geom.Point2I(-20, 30), lsst.geom.Extent2I(400, 300))
+        self.positions = [lsst.geom.Point2D(x, y) for x in (-20.0, 13.7, 200.2, 379.0)
+                          for y in (30.0, 101.4, 329.0)]
+
+    def tearDown(self):
+        del self.bbox
+        del self.positions
+
+    def assertShapesAlmostEqual(self, a, b, rtol):
+        self.assertFloatsAlmostEqual(a.getIxx(), b.getIxx(), rtol=rtol)
+        self.assertFloatsAlmostEqual(a.getIyy(), b.getIyy(), rtol=rtol)
+        self.assertFloatsAlmostEqual(a.getIxy(), b.getIxy(), atol=rtol*(b.getIxx() + b.getIyy()))
+
+    def testConstantPsf(self):
+        """Test that the interpolated moments of a constant PSF model are exact."""
+        psf = lsst.afw.detection.GaussianPsf(25, 25, 2.0)
+        cache = lsst.meas.base.PsfCache(psf, self.bbox)
+        for position in self.positions:
+            self.assertShapesAlmostEqual(cache.computeShape(position, 64, 0.0), psf.computeShape(position),
+                                         rtol=1E-12)
+        self.assertShapesAlmostEqual(cache.computeShape(), psf.computeShape(), rtol=1E-12)
+
+    def testVaryingPsf(self):
+        """Test interpolation, and the fallback to exact moments, for a spatially varying PSF model."""
+        psf = makeVaryingPsf(self.bbox)
+        cache = lsst.meas.base.PsfCache(psf, self.bbox)
+        for position in self.positions:
+            exact = psf.computeShape(position)
+            # with no tolerance we must always fall back to computing the moments
+            self.assertShapesAlmostEqual(cache.computeShape(position, 32, 0.0), exact, rtol=1E-12)
+            self.assertShapesAlmostEqual(cache.computeShape(position, 0, 1.0), exact, rtol=1E-12)
+            self.assertShapesAlmostEqual(cache.computeShape(position, 32, 1.0), exact, rtol=1E-3)
+        # off the image
+        position = lsst.geom.Point2D(-100.0, 500.0)
+        self.assertShapesAlmostEqual(cache.computeShape(position, 32, 1.0), psf.computeShape(position),
+                                     rtol=1E-12)
+
+    def testImages(self):
+        """Test the cached images and kernels of constant and spatially varying PSF models."""
+        constantPsf = lsst.afw.detection.GaussianPsf(25, 25, 2.0)
+        varyingPsf = makeVaryingPsf(self.bbox)
+        # the kernel images at the corners of a cell differ by at most the tolerance (relative to their
+        # peak), which bounds the error of the nearest one for this smoothly varying model
+        for psf, spacing, tolerance, rtol in ((constantPsf, 64, 0.0, 1E-12), (varyingPsf, 16, 0.05, 0.05)):
+            cache = lsst.meas.base.PsfCache(psf, self.bbox)
+            for position in self.positions:
+                image = cache.computeImage(position, spacing, tolerance)
+                self.assertEqual(image.getBBox(), psf.computeImage(position).getBBox())
+                self.assertFloatsAlmostEqual(image.getArray(), psf.computeImage(position).getArray(),
+                                             atol=rtol*image.getArray().max())
+                kernelImage = cache.computeKernelImage(position, spacing, tolerance)
+                self.assertFloatsAlmostEqual(kernelImage.getArray(),
+                                             psf.computeKernelImage(position).getArray(),
+                                             atol=rtol*kernelImage.getArray().max())
+                kernel = cache.getLocalKernel(position, spacing, tolerance)
+                self.assertEqual(kernel.getDimensions(), psf.getLocalKernel(position).getDimensions())
+                # without a grid the PSF model is always evaluated at the position
+                self.assertFloatsAlmostEqual(cache.computeImage(position, 0, tolerance).getArray(),
+                                             psf.computeImage(position).getArray(), rtol=0.0)
+            self.assertGreater(cache.getStatistics().hits, 0)
+        # with a tolerance too small for the kernel images (but not the moments) of a cell to agree, the
+        # PSF model is evaluated at the position
+        cache = lsst.meas.base.PsfCache(varyingPsf, self.bbox)
+        position = self.positions[4]
+        cache.computeShape(position, 16, 0.014)
+        self.assertEqual(cache.getStatistics().hits, 1)
+        kernelImage = cache.computeKernelImage(position, 16, 0.014)
+        self.assertFloatsAlmostEqual(kernelImage.getArray(),
+                                     varyingPsf.computeKernelImage(position).getArray(), rtol=0.0)
+        self.assertEqual(cache.getStatistics().hits, 1)
+
+    def testStatistics(self):
+        """Test the counts of lookups served from the grid and evaluated exactly."""
+        psf = lsst.afw.detection.GaussianPsf(25, 25, 2.0)
+        cache = lsst.meas.base.PsfCache(psf, self.bbox)
+        position = lsst.geom.Point2D(100.5, 100.5)
+        cache.computeShape(position, 64, 1E-3)
+        cache.computeImage(position, 64, 1E-3)
+        cache.getLocalKernel(position, 64, 1E-3)
+        cache.computeShape(position, 0, 1E-3)
+        cache.computeShape(lsst.geom.Point2D(-100.0, 500.0), 64, 1E-3)
+        statistics = cache.getStatistics()
+        self.assertEqual(statistics.hits, 3)
+        self.assertEqual(statistics.fallbacks, 2)
+        self.assertEqual(statistics.evaluations, 4)
+
+    def testShared(self):
+        """Test that algorithms measuring the same exposure share a cache."""
+        psf = lsst.afw.detection.GaussianPsf(25, 25, 2.0)
+        cache = lsst.meas.base.PsfCache.get(psf, self.bbox)
+        self.assertIs(lsst.meas.base.PsfCache.get(psf, self.bbox), cache)
+        self.assertIsNot(lsst.meas.base.PsfCache.get(psf, lsst.geom.Box2I(self.bbox.getMin(),
+                                                                           lsst.geom.Extent2I(10, 10))),
+                         cache)
+        self.assertIsNot(lsst.meas.base.PsfCache.get(psf.clone(), self.bbox), cache)
+        self.assertEqual(cache.getBBox(), self.bbox)
+
+
+class TestMemory(lsst.utils.tests.MemoryTestCase):
+    pass
+
+
+def setup_module(module):
+    lsst.utils.tests.init()
+
+
+if __name__ == "__main__":
+    lsst.utils.tests.init()
+    unittest.main()
@@ -25,6 +25,7 @@ import numpy as np
 
 import lsst.geom
 import lsst.afw.image
+import lsst.afw.math
 import lsst.afw.table
 import lsst.utils.tests
 
@@ -150,6 +151,135 @@ class PsfFluxTestCase(AlgorithmTestCase, lsst.utils.tests.TestCase):
             self.assertFloatsAlmostEqual(instFluxErrMean, instFluxStandardDeviation, rtol=0.10)
             self.assertLess(instFluxMean - instFlux, 2.0*instFluxErrMean / nSamples**0.5)
 
+    def testMeasureN(self):
+        """Test fitting a blend family simultaneously."""
+        dataset = lsst.meas.base.tests.TestDataset(self.bbox)
+        with dataset.addBlend() as family:
+            family.addChild(instFlux=2E5, centroid=lsst.geom.Point2D(47.3, 50.2))
+            family.addChild(instFlux=1.5E5, centroid=lsst.geom.Point2D(53.1, 48.6))
+        algorithm, schema = self.makeAlgorithm()
+        # Results are RNG dependent; we choose a seed that is known to pass.
+        exposure, catalog = dataset.realize(10.0, schema, randomSeed=0)
+        children = catalog.getChildren(catalog[0].getId())
+        algorithm.measureN(children, exposure)
+        for record in children:
+            self.assertFalse(record.get("base_PsfFlux_flag"))
+            self.assertFloatsAlmostEqual(record.get("base_PsfFlux_instFlux"), record.get("truth_instFlux"),
+                                         atol=3*record.get("base_PsfFlux_instFluxErr"))
+        # fitting one source at a time, the neighbours bias the fluxes
+        for record in children:
+            algorithm.measure(record, exposure)
+            self.assertGreater(record.get("base_PsfFlux_instFlux") - record.get("truth_instFlux"),
+                               3*record.get("base_PsfFlux_instFluxErr"))
+        # a family of one is just the single-object fit
+        record = children[0]
+        algorithm.measure(record, exposure)
+        instFlux = record.get("base_PsfFlux_instFlux")
+        instFluxErr = record.get("base_PsfFlux_instFluxErr")
+        area = record.get("base_PsfFlux_area")
+        algorithm.measureN(children[:1], exposure)
+        self.assertFloatsAlmostEqual(record.get("base_PsfFlux_instFlux"), instFlux, rtol=1E-10)
+        self.assertFloatsAlmostEqual(record.get("base_PsfFlux_instFluxErr"), instFluxErr, rtol=1E-10)
+        self.assertFloatsAlmostEqual(record.get("base_PsfFlux_area"), area, rtol=1E-6)
+
+    def testMeasureNDegenerate(self):
+        """Test that measureN fails a source whose model duplicates another's."""
+        dataset = lsst.meas.base.tests.TestDataset(self.bbox)
+        with dataset.addBlend() as family:
+            family.addChild(instFlux=2E5, centroid=lsst.geom.Point2D(47.3, 50.2))
+            family.addChild(instFlux=1.5E5, centroid=lsst.geom.Point2D(47.3, 50.2))
+        algorithm, schema = self.makeAlgorithm()
+        # Results are RNG dependent; we choose a seed that is known to pass.
+        exposure, catalog = dataset.realize(10.0, schema, randomSeed=0)
+        children = catalog.getChildren(catalog[0].getId())
+        for record in children:
+            algorithm.measure(record, exposure)
+        algorithm.measureN(children, exposure)
+        failed = [record.get("base_PsfFlux_flag") for record in children]
+        self.assertEqual(sorted(failed), [False, True])
+        for record in children:
+            if record.get("base_PsfFlux_flag"):
+                self.assertTrue(np.isnan(record.get("base_PsfFlux_instFlux")))
+                self.assertTrue(np.isnan(record.get("base_PsfFlux_instFluxErr")))
+                self.assertTrue(np.isnan(record.get("base_PsfFlux_area")))
+            else:
+                self.assertFloatsAlmostEqual(record.get("base_PsfFlux_instFlux"), 3.5E5,
+                                             atol=3*record.get("base_PsfFlux_instFluxErr"))
+
+    def testMeasureNException(self):
+        """Test that measureN fails only the source that raises, and fits the rest of the family."""
+        dataset = lsst.meas.base.tests.TestDataset(self.bbox)
+        with dataset.addBlend() as family:
+            family.addChild(instFlux=2E5, centroid=lsst.geom.Point2D(47.3, 50.2))
+            family.addChild(instFlux=1.5E5, centroid=lsst.geom.Point2D(53.1, 48.6))
+            family.addChild(instFlux=1E5, centroid=lsst.geom.Point2D(20.0, 70.0))
+        algorithm, schema = self.makeAlgorithm()
+        # Results are RNG dependent; we choose a seed that is known to pass.
+        exposure, catalog = dataset.realize(10.0, schema, randomSeed=0)
+        children = catalog.getChildren(catalog[0].getId())
+        # a NaN centroid without its flag set makes the centroid extractor raise a plain RuntimeError
+        children[2].set("truth_x", np.nan)
+        algorithm.measureN(children, exposure)
+        self.assertTrue(children[2].get("base_PsfFlux_flag"))
+        self.assertTrue(np.isnan(children[2].get("base_PsfFlux_instFlux")))
+        for record in children[:2]:
+            self.assertFalse(record.get("base_PsfFlux_flag"))
+            self.assertFloatsAlmostEqual(record.get("base_PsfFlux_instFlux"), record.get("truth_instFlux"),
+                                         atol=3*record.get("base_PsfFlux_instFluxErr"))
+
+    def testComputeFluxes(self):
+        """Test batched fits of a PSF kernel, with and without a basis, against measure()."""
+        dataset = lsst.meas.base.tests.TestDataset(self.bbox)
+        positions = [lsst.geom.Point2D(50.1, 49.8), lsst.geom.Point2D(20.0, 70.0),
+                     lsst.geom.Point2D(81.7, 12.4), lsst.geom.Point2D(3.2, 95.5)]
+        for position in positions:
+            dataset.addSource(100000.0, position)
+        algorithm, schema = self.makeAlgorithm()
+        # Results are RNG dependent; we choose a seed that is known to pass.
+        exposure, catalog = dataset.realize(10.0, schema, randomSeed=2)
+        psfKernel = exposure.getPsf().getLocalKernel(positions[0])
+        kernels = [psfKernel,
+                   lsst.afw.math.LinearCombinationKernel([psfKernel, psfKernel.clone()], [0.3, 0.7])]
+        for kernel in kernels:
+            results = lsst.meas.base.PsfFluxAlgorithm.computeFluxes(exposure.getMaskedImage(), kernel,
+                                                                   positions)
+            self.assertEqual(len(results), len(positions))
+            for record, result in zip(catalog, results):
+                algorithm.measure(record, exposure)
+                self.assertFloatsAlmostEqual(result.instFlux, record.get("base_PsfFlux_instFlux"), rtol=1E-8)
+                self.assertFloatsAlmostEqual(result.instFluxErr, record.get("base_PsfFlux_instFluxErr"),
+                                             rtol=1E-8)
+                self.assertFloatsAlmostEqual(result.area, record.get("base_PsfFlux_area"), rtol=1E-6)
+                self.assertEqual(result.getFlag(lsst.meas.base.PsfFluxAlgorithm.EDGE.number),
+                                 record.get("base_PsfFlux_flag_edge"))
+
+    def testMeasureBatch(self):
+        """Test that measureBatch() gives the same results as measure()."""
+        dataset = lsst.meas.base.tests.TestDataset(self.bbox)
+        positions = [lsst.geom.Point2D(50.1, 49.8), lsst.geom.Point2D(20.0, 70.0),
+                     lsst.geom.Point2D(81.7, 12.4), lsst.geom.Point2D(3.2, 95.5)]
+        for position in positions:
+            dataset.addSource(100000.0, position)
+        ctrl = lsst.meas.base.PsfFluxControl()
+        ctrl.badMaskPlanes = ["BAD"]
+        algorithm, schema = self.makeAlgorithm(ctrl)
+        # Results are RNG dependent; we choose a seed that is known to pass.
+        exposure, catalog = dataset.realize(10.0, schema, randomSeed=3)
+        maskArray = exposure.getMaskedImage().getMask().getArray()
+        maskArray[52, 48] |= exposure.getMaskedImage().getMask().getPlaneBitMask("BAD")
+        batchCatalog = catalog.copy(deep=True)
+        for record in catalog:
+            algorithm.measure(record, exposure)
+        algorithm.measureBatch(batchCatalog, exposure)
+        self.assertTrue(catalog[3].get("base_PsfFlux_flag_edge"))
+        for record, batchRecord in zip(catalog, batchCatalog):
+            # identical unless the compiler fuses multiply-adds differently in the two loops
+            for name in ("instFlux", "instFluxErr", "area"):
+                self.assertFloatsAlmostEqual(batchRecord.get("base_PsfFlux_" + name),
+                                             record.get("base_PsfFlux_" + name), rtol=1E-14)
+            for name in ("flag", "flag_edge", "flag_noGoodPixels"):
+                self.assertEqual(batchRecord.get("base_PsfFlux_" + name), record.get("base_PsfFlux_" + name))
+
     def testSingleFramePlugin(self):
         task = self.makeSingleFrameMeasurementTask("base_PsfFlux")
         # Results are RNG dependent; we choose a seed that is known to pass.
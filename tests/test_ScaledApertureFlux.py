@@ -23,6 +23,7 @@ import unittest
 import math
 
 import lsst.geom
+import lsst.daf.base
 import lsst.afw.image
 import lsst.afw.table
 from lsst.meas.base.tests import (AlgorithmTestCase, FluxTransformTestCase,
@@ -117,6 +118,33 @@ class ScaledApertureFluxTestCase(AlgorithmTestCase, lsst.utils.tests.TestCase):
         self.assertFalse(catalog[0].get("base_ScaledApertureFlux_flag_apertureTruncated"))
         self.assertTrue(catalog[0].get("base_ScaledApertureFlux_flag_sincCoeffsTruncated"))
 
+    def testSincCache(self):
+        """Check that sharing coefficients between similar apertures changes the instFlux negligibly.
+        """
+        ctrl = lsst.meas.base.ScaledApertureFluxControl()
+        ctrl.sincCacheTolerance = -1.0
+        algorithm, schema = self.makeAlgorithm(ctrl)
+        exposure, catalog = self.dataset.realize(10.0, schema, randomSeed=0)
+        algorithm.measure(catalog[0], exposure)
+        expected = catalog[0].get("base_ScaledApertureFlux_instFlux")
+
+        ctrl.sincCacheTolerance = 1E-3
+        schema = lsst.meas.base.tests.TestDataset.makeMinimalSchema()
+        metadata = lsst.daf.base.PropertyList()
+        algorithm = lsst.meas.base.ScaledApertureFluxAlgorithm(ctrl, "base_ScaledApertureFlux", schema,
+                                                               metadata)
+        exposure, catalog = self.dataset.realize(10.0, schema, randomSeed=0)
+        for i in range(2):
+            algorithm.measure(catalog[0], exposure)
+            self.assertFloatsAlmostEqual(catalog[0].get("base_ScaledApertureFlux_instFlux"), expected,
+                                         rtol=1E-4)
+        hits = metadata.getScalar("base_ScaledApertureFlux_sincCacheHits")
+        self.assertGreater(hits, 0)
+        self.assertGreater(metadata.getScalar("base_ScaledApertureFlux_sincCacheMisses"), 0)
+        self.assertGreaterEqual(metadata.getScalar("base_ScaledApertureFlux_sincCacheEvictions"), 0)
+        algorithm.measure(catalog[0], exposure)
+        self.assertEqual(metadata.getScalar("base_ScaledApertureFlux_sincCacheHits"), hits + 1)
+
 
 class ScaledApertureFluxTransformTestCase(FluxTransformTestCase,
                                           SingleFramePluginTransformSetupHelper,
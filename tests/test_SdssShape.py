@@ -23,9 +23,11 @@ import unittest
 
 import numpy as np
 
+import lsst.daf.base
 import lsst.geom
 import lsst.afw.geom
 import lsst.meas.base
+import lsst.pex.exceptions
 import lsst.meas.base.tests
 import lsst.utils.tests
 
@@ -129,6 +131,218 @@ class SdssShapeTestCase(lsst.meas.base.tests.AlgorithmTestCase, lsst.utils.tests
             self._checkShape(result, record)
             self.assertTrue(result.getFlag(lsst.meas.base.SdssShapeAlgorithm.PSF_SHAPE_BAD.number))
 
+    def testPsfCache(self):
+        """Test that interpolated PSF moments match those computed at each source."""
+        self.config.plugins["base_SdssShape"].psfCacheSpacing = 64
+        exposure, catalog = self._runMeasurementTask()
+        key = lsst.meas.base.SdssShapeResultKey(catalog.schema["base_SdssShape"])
+        psfTruth = exposure.getPsf().computeShape()
+        for record in catalog:
+            result = record.get(key)
+            self._checkShape(result, record)
+            self._checkPsfShape(result, key.getPsfShape(record), psfTruth)
+
+    def testVectorize(self):
+        """Test that the vectorized and scalar moments kernels agree to within their documented tolerance."""
+        exposure, catalog = self._runMeasurementTask()
+        vectorCtrl = lsst.meas.base.SdssShapeControl()
+        vectorCtrl.doVectorize = True
+        compensatedCtrl = lsst.meas.base.SdssShapeControl()
+        compensatedCtrl.doVectorize = True
+        compensatedCtrl.doCompensatedSums = True
+        scalarCtrl = lsst.meas.base.SdssShapeControl()
+        for record in catalog:
+            center = lsst.geom.Point2D(record.get("truth_x"), record.get("truth_y"))
+            for image in (exposure.getMaskedImage(), exposure.getMaskedImage().getImage()):
+                scalar = lsst.meas.base.SdssShapeAlgorithm.computeAdaptiveMoments(image, center,
+                                                                                 ctrl=scalarCtrl)
+                for ctrl in (vectorCtrl, compensatedCtrl):
+                    vector = lsst.meas.base.SdssShapeAlgorithm.computeAdaptiveMoments(image, center,
+                                                                                     ctrl=ctrl)
+                    self.assertEqual(vector.getFlag(lsst.meas.base.SdssShapeAlgorithm.FAILURE.number),
+                                     scalar.getFlag(lsst.meas.base.SdssShapeAlgorithm.FAILURE.number))
+                    self.assertFloatsAlmostEqual(vector.instFlux, scalar.instFlux, rtol=1E-5)
+                    self.assertFloatsAlmostEqual(vector.x, scalar.x, rtol=1E-5)
+                    self.assertFloatsAlmostEqual(vector.y, scalar.y, rtol=1E-5)
+                    self.assertFloatsAlmostEqual(vector.xx, scalar.xx, rtol=1E-5)
+                    self.assertFloatsAlmostEqual(vector.yy, scalar.yy, rtol=1E-5)
+                    self.assertFloatsAlmostEqual(vector.xy, scalar.xy, rtol=1E-5, atol=1E-5)
+
+    def testWeightRecurrence(self):
+        """Test that generating the weights by recurrence agrees with calling exp for every pixel."""
+        exposure, catalog = self._runMeasurementTask()
+        expCtrl = lsst.meas.base.SdssShapeControl()
+        expCtrl.doVectorize = False
+        recurrenceCtrl = lsst.meas.base.SdssShapeControl()
+        recurrenceCtrl.doWeightRecurrence = True
+        image = exposure.getMaskedImage()
+        for record in catalog:
+            center = lsst.geom.Point2D(record.get("truth_x"), record.get("truth_y"))
+            expected = lsst.meas.base.SdssShapeAlgorithm.computeAdaptiveMoments(image, center, ctrl=expCtrl)
+            result = lsst.meas.base.SdssShapeAlgorithm.computeAdaptiveMoments(image, center,
+                                                                             ctrl=recurrenceCtrl)
+            self.assertFloatsAlmostEqual(result.instFlux, expected.instFlux, rtol=1E-5)
+            self.assertFloatsAlmostEqual(result.xx, expected.xx, rtol=1E-5)
+            self.assertFloatsAlmostEqual(result.yy, expected.yy, rtol=1E-5)
+            self.assertFloatsAlmostEqual(result.xy, expected.xy, rtol=1E-5, atol=1E-5)
+
+            shape = expected.getShape()
+            expectedFlux = lsst.meas.base.SdssShapeAlgorithm.computeFixedMomentsFlux(image, shape, center,
+                                                                                     ctrl=expCtrl)
+            flux = lsst.meas.base.SdssShapeAlgorithm.computeFixedMomentsFlux(image, shape, center,
+                                                                             ctrl=recurrenceCtrl)
+            self.assertFloatsAlmostEqual(flux.instFlux, expectedFlux.instFlux, rtol=1E-5)
+            self.assertFloatsAlmostEqual(flux.instFluxErr, expectedFlux.instFluxErr, rtol=1E-5)
+
+    def testInitialGuess(self):
+        """Test that starting from the PSF moments gives the same shapes in fewer iterations."""
+        results = {}
+        for initialGuess in ("default", "psf"):
+            self.config.plugins["base_SdssShape"].initialGuess = initialGuess
+            self.config.plugins["base_SdssShape"].doCompareColdStart = True
+            algMetadata = lsst.daf.base.PropertyList()
+            task = self.makeSingleFrameMeasurementTask("base_SdssShape", config=self.config,
+                                                       algMetadata=algMetadata)
+            exposure, catalog = self.dataset.realize(10.0, task.schema, randomSeed=0)
+            task.run(catalog, exposure)
+            results[initialGuess] = catalog
+            self.assertGreater(algMetadata.getScalar("base_SdssShape_nIter"), 0)
+            if initialGuess == "psf":
+                self.assertEqual(algMetadata.getScalar("base_SdssShape_nWarmStart"), len(catalog))
+                self.assertTrue(algMetadata.exists("base_SdssShape_nIterSaved"))
+            else:
+                self.assertFalse(algMetadata.exists("base_SdssShape_nWarmStart"))
+        key = lsst.meas.base.SdssShapeResultKey(results["default"].schema["base_SdssShape"])
+        for cold, warm in zip(results["default"], results["psf"]):
+            coldResult = cold.get(key)
+            warmResult = warm.get(key)
+            self._checkShape(warmResult, warm)
+            self.assertFloatsAlmostEqual(warmResult.xx, coldResult.xx, rtol=1E-3)
+            self.assertFloatsAlmostEqual(warmResult.yy, coldResult.yy, rtol=1E-3)
+            self.assertFloatsAlmostEqual(warmResult.xy, coldResult.xy, rtol=1E-3, atol=1E-3)
+
+        # An explicit starting point
+        exposure, catalog = self.dataset.realize(10.0, results["default"].schema, randomSeed=0)
+        for record in catalog:
+            center = lsst.geom.Point2D(record.get("truth_x"), record.get("truth_y"))
+            initialShape = lsst.afw.geom.Quadrupole(record.get("truth_xx"), record.get("truth_yy"),
+                                                    record.get("truth_xy"))
+            result = lsst.meas.base.SdssShapeAlgorithm.computeAdaptiveMoments(exposure.getMaskedImage(),
+                                                                             center, initialShape)
+            self._checkShape(result, record)
+
+        # A shape slot pointing at base_SdssShape itself (the usual single-frame setup) is not measured yet
+        self.config.slots.shape = "base_SdssShape"
+        self.config.plugins["base_SdssShape"].initialGuess = "shape"
+        task = self.makeSingleFrameMeasurementTask("base_SdssShape", config=self.config)
+        exposure, catalog = self.dataset.realize(10.0, task.schema, randomSeed=0)
+        with self.assertRaises(lsst.meas.base.FatalAlgorithmError):
+            task.run(catalog, exposure)
+
+        self.config.plugins["base_SdssShape"].initialGuess = "nonsense"
+        with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+            self.makeSingleFrameMeasurementTask("base_SdssShape", config=self.config)
+
+    def testIterationCounts(self):
+        """Test that the iteration count and bounding box area are recorded per source and in metadata."""
+        algMetadata = lsst.daf.base.PropertyList()
+        task = self.makeSingleFrameMeasurementTask("base_SdssShape", config=self.config,
+                                                   algMetadata=algMetadata)
+        exposure, catalog = self.dataset.realize(10.0, task.schema, randomSeed=0)
+        task.run(catalog, exposure)
+        key = lsst.meas.base.SdssShapeResultKey(catalog.schema["base_SdssShape"])
+        for record in catalog:
+            result = record.get(key)
+            self.assertGreater(record.get("base_SdssShape_nIter"), 0)
+            self.assertLess(record.get("base_SdssShape_nIter"), self.config.plugins["base_SdssShape"].maxIter)
+            self.assertGreater(record.get("base_SdssShape_bboxArea"), 0)
+            self.assertEqual(result.nIter, record.get("base_SdssShape_nIter"))
+            self.assertEqual(result.bboxArea, record.get("base_SdssShape_bboxArea"))
+        # the extended source needs a bigger box
+        self.assertGreater(catalog[1].get("base_SdssShape_bboxArea"),
+                           catalog[0].get("base_SdssShape_bboxArea"))
+        nIterHist = algMetadata.getArray("base_SdssShape_nIterHist")
+        bboxAreaHist = algMetadata.getArray("base_SdssShape_bboxAreaHist")
+        self.assertEqual(sum(nIterHist), len(catalog))
+        self.assertEqual(sum(bboxAreaHist), len(catalog))
+        self.assertEqual(sum(n*count for n, count in enumerate(nIterHist)),
+                         algMetadata.getScalar("base_SdssShape_nIter"))
+        for record in catalog:
+            self.assertGreater(bboxAreaHist[int(np.log2(record.get("base_SdssShape_bboxArea")))], 0)
+
+    def testAccelerate(self):
+        """Test that Aitken extrapolation of the weights converges to the same moments."""
+        exposure, catalog = self._runMeasurementTask()
+        ctrl = lsst.meas.base.SdssShapeControl()
+        acceleratedCtrl = lsst.meas.base.SdssShapeControl()
+        acceleratedCtrl.doAccelerate = True
+        for record in catalog:
+            center = lsst.geom.Point2D(record.get("truth_x"), record.get("truth_y"))
+            for initialShape in (lsst.afw.geom.Quadrupole(1.5, 1.5, 0.0),
+                                 lsst.afw.geom.Quadrupole(40.0, 30.0, 5.0)):
+                result = lsst.meas.base.SdssShapeAlgorithm.computeAdaptiveMoments(
+                    exposure.getMaskedImage(), center, initialShape, ctrl=ctrl)
+                accelerated = lsst.meas.base.SdssShapeAlgorithm.computeAdaptiveMoments(
+                    exposure.getMaskedImage(), center, initialShape, ctrl=acceleratedCtrl)
+                self._checkShape(accelerated, record)
+                self.assertFloatsAlmostEqual(accelerated.xx, result.xx, rtol=1E-3)
+                self.assertFloatsAlmostEqual(accelerated.yy, result.yy, rtol=1E-3)
+                self.assertFloatsAlmostEqual(accelerated.xy, result.xy, rtol=1E-3, atol=1E-3)
+
+    def testPyramid(self):
+        """Test that coarse-to-fine iteration of a large object converges to the same moments."""
+        bbox = lsst.geom.Box2I(lsst.geom.Point2I(0, 0), lsst.geom.Extent2I(400, 400))
+        dataset = lsst.meas.base.tests.TestDataset(bbox)
+        dataset.addSource(1000000.0, lsst.geom.Point2D(200.3, 199.6), lsst.afw.geom.Quadrupole(400, 300, 50))
+        task = self.makeSingleFrameMeasurementTask("base_SdssShape", config=self.config)
+        exposure, catalog = dataset.realize(10.0, task.schema, randomSeed=0)
+        record = catalog[0]
+        center = lsst.geom.Point2D(record.get("truth_x"), record.get("truth_y"))
+        ctrl = lsst.meas.base.SdssShapeControl()
+        pyramidCtrl = lsst.meas.base.SdssShapeControl()
+        pyramidCtrl.pyramidMinSigma = 10.0
+        result = lsst.meas.base.SdssShapeAlgorithm.computeAdaptiveMoments(exposure.getMaskedImage(), center,
+                                                                          ctrl=ctrl)
+        batch = lsst.meas.base.SdssShapeAlgorithm.computeAdaptiveMomentsBatch(exposure.getMaskedImage(),
+                                                                              [center], ctrl=pyramidCtrl)
+        for pyramid in (lsst.meas.base.SdssShapeAlgorithm.computeAdaptiveMoments(
+                            exposure.getMaskedImage(), center, ctrl=pyramidCtrl),
+                        batch.get(0)):
+            self._checkShape(pyramid, record)
+            self.assertFloatsAlmostEqual(pyramid.xx, result.xx, rtol=1E-3)
+            self.assertFloatsAlmostEqual(pyramid.yy, result.yy, rtol=1E-3)
+            self.assertFloatsAlmostEqual(pyramid.xy, result.xy, rtol=1E-2, atol=1E-2)
+            self.assertFloatsAlmostEqual(pyramid.instFlux, result.instFlux, rtol=1E-3)
+
+    def testBatch(self):
+        """Test that computeAdaptiveMomentsBatch matches computeAdaptiveMoments for each object."""
+        exposure, catalog = self._runMeasurementTask()
+        image = exposure.getMaskedImage()
+        positions = [lsst.geom.Point2D(record.get("truth_x"), record.get("truth_y")) for record in catalog]
+        # include a position off the image, which must fail without affecting the others
+        positions.append(lsst.geom.Point2D(-1000.0, -1000.0))
+        for nThreads in (1, 2, 0):
+            batch = lsst.meas.base.SdssShapeAlgorithm.computeAdaptiveMomentsBatch(image, positions,
+                                                                                 nThreads=nThreads)
+            self.assertEqual(len(batch), len(positions))
+            self.assertEqual(batch.flags.shape[0], len(positions))
+            for i, position in enumerate(positions):
+                expected = lsst.meas.base.SdssShapeAlgorithm.computeAdaptiveMoments(image, position)
+                for name in ("instFlux", "instFluxErr", "x", "y", "xx", "yy", "xy", "xxErr", "yyErr",
+                             "xyErr", "instFlux_xx_Cov", "instFlux_yy_Cov", "instFlux_xy_Cov"):
+                    self.assertFloatsEqual(getattr(batch, name)[i], getattr(expected, name),
+                                           ignoreNaNs=True)
+                for flag in (lsst.meas.base.SdssShapeAlgorithm.FAILURE,
+                             lsst.meas.base.SdssShapeAlgorithm.UNWEIGHTED_BAD,
+                             lsst.meas.base.SdssShapeAlgorithm.UNWEIGHTED,
+                             lsst.meas.base.SdssShapeAlgorithm.SHIFT,
+                             lsst.meas.base.SdssShapeAlgorithm.MAXITER):
+                    self.assertEqual(batch.flags[i, flag.number], expected.getFlag(flag.number))
+                    self.assertEqual(batch.get(i).getFlag(flag.number), expected.getFlag(flag.number))
+                self.assertEqual(batch.nIter[i], expected.nIter)
+                self.assertEqual(batch.bboxArea[i], expected.bboxArea)
+            self.assertTrue(batch.flags[-1, lsst.meas.base.SdssShapeAlgorithm.FAILURE.number])
+
 
 class SdssShapeTransformTestCase(lsst.meas.base.tests.FluxTransformTestCase,
                                  lsst.meas.base.tests.CentroidTransformTestCase,
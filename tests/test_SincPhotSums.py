@@ -19,7 +19,10 @@
 # You should have received a copy of the GNU General Public License
 # along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+import concurrent.futures
 import math
+import os
+import tempfile
 import unittest
 
 import numpy as np
@@ -31,7 +34,9 @@ import lsst.afw.math as afwMath
 import lsst.afw.geom as afwGeom
 import lsst.afw.geom.ellipses as afwEll
 import lsst.meas.base as measBase
+import lsst.pex.exceptions
 import lsst.utils.tests
+from lsst.meas.base.makeSincCoeffsStore import makeSincCoeffsStore
 
 try:
     display
@@ -248,6 +253,156 @@ class SincCoeffTestCase(lsst.utils.tests.TestCase):
         coeff1, coeff2 = self.getCoeffCircle(self.radius2)
         self.assertCached(coeff1, coeff2)
 
+    def testLruCache(self):
+        """Test sharing coefficients between similar apertures, and bounding the size of the cache."""
+        capacity = measBase.SincCoeffsF.getLruCapacity()
+        try:
+            coeff1 = measBase.SincCoeffsF.get(self.ellipse, self.inner, 1E-3)
+            before = measBase.SincCoeffsF.getLruStatistics()
+            # within the tolerance, and with an equivalent position angle
+            similar = afwEll.Axes(self.ellipse.getA()*(1 + 1E-5), self.ellipse.getB(),
+                                  self.ellipse.getTheta() + math.pi)
+            coeff2 = measBase.SincCoeffsF.get(similar, self.inner, 1E-3)
+            self.assertCached(coeff1, coeff2)
+            after = measBase.SincCoeffsF.getLruStatistics()
+            self.assertEqual(after.hits, before.hits + 1)
+            self.assertEqual(after.misses, before.misses)
+            self.assertGreater(after.bytes, 0)
+            # the quantized aperture is close to the requested one
+            exact = measBase.SincCoeffsF.get(self.ellipse, self.inner)
+            self.assertFloatsAlmostEqual(coeff2.getArray().sum(), exact.getArray().sum(), rtol=2E-3)
+            # a different tolerance is a different aperture
+            coeff3 = measBase.SincCoeffsF.get(self.ellipse, self.inner, 0.0)
+            self.assertNotEqual(coeff3.getId(), coeff1.getId())
+            np.testing.assert_array_equal(coeff3.getArray(), exact.getArray())
+
+            # a tiny capacity only keeps the coefficients calculated most recently
+            measBase.SincCoeffsF.setLruCapacity(1)
+            statistics = measBase.SincCoeffsF.getLruStatistics()
+            self.assertGreater(statistics.evictions, after.evictions)
+            self.assertEqual(statistics.size, 0)
+            self.assertEqual(statistics.bytes, 0)
+            coeff4 = measBase.SincCoeffsF.get(self.ellipse, self.inner, 1E-3)
+            self.assertNotCached(coeff1, coeff4)
+            self.assertEqual(measBase.SincCoeffsF.getLruStatistics().size, 1)
+
+            # a capacity of zero disables the cache
+            measBase.SincCoeffsF.setLruCapacity(0)
+            coeff5 = measBase.SincCoeffsF.get(self.ellipse, self.inner, 1E-3)
+            coeff6 = measBase.SincCoeffsF.get(self.ellipse, self.inner, 1E-3)
+            self.assertNotCached(coeff5, coeff6)
+            self.assertEqual(measBase.SincCoeffsF.getLruStatistics().size, 0)
+        finally:
+            measBase.SincCoeffsF.setLruCapacity(capacity)
+
+    def testStore(self):
+        """Test reading coefficients from a file instead of calculating them."""
+        radii = [2.5, 3.5, 20.0]  # not cached by any other test
+        with tempfile.TemporaryDirectory() as directory:
+            filename = os.path.join(directory, "sincCoeffs.bin")
+            self.assertEqual(makeSincCoeffsStore(filename, radii, maxSincRadius=10.0), radii[:2])
+            store = measBase.SincCoeffsStore.get(filename)
+            self.assertIs(measBase.SincCoeffsStore.get(filename), store)
+            self.assertEqual(len(store), 4)
+            for radius in radii[:2]:
+                circle = afwEll.Axes(radius, radius, 0.0)
+                for getStored, calculate in ((store.getCoeffsF, measBase.SincCoeffsF.get),
+                                             (store.getCoeffsD, measBase.SincCoeffsD.get)):
+                    stored = getStored(radius, 0.0)
+                    expected = calculate(circle, 0.0)
+                    self.assertEqual(stored.getBBox(), expected.getBBox())
+                    np.testing.assert_array_equal(stored.getArray(), expected.getArray())
+            self.assertIsNone(store.getCoeffsF(radii[2], 0.0))
+            self.assertIsNone(store.getCoeffsF(radii[0], 0.5))
+
+            try:
+                measBase.SincCoeffsF.setStore(store)
+                measBase.SincCoeffsF.cache(0.0, radii[0])
+                circle = afwEll.Axes(radii[0], radii[0], 0.0)
+                coeff = measBase.SincCoeffsF.get(circle, 0.0)
+                np.testing.assert_array_equal(coeff.getArray(), store.getCoeffsF(radii[0], 0.0).getArray())
+
+                # algorithms can't replace the process's store with another
+                other = os.path.join(directory, "other.bin")
+                makeSincCoeffsStore(other, radii[:1])
+                measBase.SincCoeffsF.requireStore(store)
+                measBase.SincCoeffsF.requireStore(None)
+                with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+                    measBase.SincCoeffsF.requireStore(measBase.SincCoeffsStore.get(other))
+                self.assertIs(measBase.SincCoeffsF.getStore(), store)
+            finally:
+                measBase.SincCoeffsF.setStore(None)
+
+            # corrupt the pixels (of another file: a store must never be modified in place)
+            corrupted = os.path.join(directory, "corrupted.bin")
+            makeSincCoeffsStore(corrupted, radii[:1])
+            with open(corrupted, "r+b") as stream:
+                stream.seek(-8, os.SEEK_END)
+                stream.write(b"corrupt!")
+            with self.assertRaises(lsst.pex.exceptions.IoError):
+                measBase.SincCoeffsStore(corrupted)
+        with self.assertRaises(lsst.pex.exceptions.IoError):
+            measBase.SincCoeffsStore(corrupted)
+
+    def testSymmetry(self):
+        """Test that coefficients have the symmetries used to calculate them."""
+        circle = measBase.SincCoeffsD.calculate(afwEll.Axes(self.radius2, self.radius2, 0.0), self.inner)
+        array = circle.getArray()
+        atol = 1E-12*np.abs(array).max()
+        for symmetric in (array.T, array[::-1, :], array[:, ::-1]):
+            self.assertFloatsAlmostEqual(array, symmetric, atol=atol)
+        ellipse = measBase.SincCoeffsD.calculate(self.ellipse, self.inner).getArray()
+        self.assertFloatsAlmostEqual(ellipse, ellipse[::-1, ::-1], atol=1E-12*np.abs(ellipse).max())
+
+    def testFftwPlanning(self):
+        """Test single-precision transforms, and measuring plans with FFTW wisdom."""
+        coeffF = measBase.SincCoeffsF.calculate(self.ellipse, self.inner)
+        coeffD = measBase.SincCoeffsD.calculate(self.ellipse, self.inner)
+        self.assertEqual(coeffF.getBBox(), coeffD.getBBox())
+        self.assertFloatsAlmostEqual(coeffF.getArray(), coeffD.getArray().astype(np.float32),
+                                     atol=1E-5*np.abs(coeffD.getArray()).max())
+
+        with tempfile.TemporaryDirectory() as directory:
+            wisdomFile = os.path.join(directory, "wisdom")
+            try:
+                measBase.SincCoeffsD.setFftwPlanning(True, wisdomFile)
+                # a transform size not planned by any other test
+                large = afwEll.Axes(45.0, 30.0, 0.5)
+                measured = measBase.SincCoeffsD.calculate(large, 0.0)
+                self.assertEqual(os.listdir(directory), ["wisdom-double"])
+                self.assertFloatsAlmostEqual(measured.getArray().sum(), math.pi*45.0*30.0, rtol=1E-3)
+                # algorithms can't replace the process's wisdom file with another
+                measBase.SincCoeffsD.requireFftwPlanning(wisdomFile)
+                with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+                    measBase.SincCoeffsD.requireFftwPlanning(os.path.join(directory, "other"))
+            finally:
+                measBase.SincCoeffsD.setFftwPlanning(False)
+
+    def testConcurrentCaching(self):
+        """Test that many threads calling cache() and get() at once share one set of coefficients."""
+        radii = [5.5, 6.5, 7.5, 8.5]  # not cached by any other test
+
+        def hammer(seed):
+            coeffs = {}
+            for i in range(20):
+                radius = radii[(seed + i) % len(radii)]
+                measBase.SincCoeffsF.cache(self.radius1, radius)
+                circle = afwEll.Axes(radius, radius, 0.0)
+                coeff = measBase.SincCoeffsF.get(circle, self.radius1/radius)
+                if i % 5 == 0:
+                    measBase.SincCoeffsF.get(self.ellipse, self.inner)  # uncached
+                coeffs.setdefault(radius, []).append(coeff)
+            return coeffs
+
+        with concurrent.futures.ThreadPoolExecutor(max_workers=16) as executor:
+            results = list(executor.map(hammer, range(64)))
+
+        for radius in radii:
+            coeffs = [coeff for result in results for coeff in result.get(radius, [])]
+            self.assertGreater(len(coeffs), 0)
+            for coeff in coeffs[1:]:
+                self.assertCached(coeffs[0], coeff)
+
 
 class TestMemory(lsst.utils.tests.MemoryTestCase):
     pass